@@ -0,0 +1,109 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ov
+{
+
+// The background frames of a batch job. The source is a still image, a
+// directory of images taken in name order, or anything cv::VideoCapture
+// opens (a video file or a printf-style pattern such as "img%04d.png").
+// Frames are decoded ahead of the render loop by the global thread pool
+// into a ring of RingSize frames; past the last frame the source starts
+// over. Every frame is resized to the size of the first one. A sequence
+// may start at any frame, for resumed and sharded runs; the frames before
+// it are passed over without being decoded.
+//
+// In pool mode every frame is instead a random image of a directory, drawn
+// with a seeded generator so that runs repeat. Pool images are scaled and
+// center-cropped to the frame size on the decoding threads and kept in an
+// LRU cache bounded by a memory budget, so popular images decode once.
+class OVBackgroundSequence
+{
+public:
+    static const int RingSize = 8;
+
+    OVBackgroundSequence();
+    ~OVBackgroundSequence();
+
+    // Decodes the first frame before returning and starts prefetching from
+    // startFrame; the first frame still sets the frame size
+    bool open(const std::string& path, int startFrame = 0);
+    bool openPool(const std::string& dir, unsigned int seed, size_t cacheBudget, const cv::Size& frameSize,
+                  int startFrame = 0);
+    // Stop prefetching and wait for the decodes in flight
+    void close();
+
+    // False for a still image, whose only frame is the first one
+    bool isAnimated() const { return _sourceType != SOURCE_IMAGE; }
+    const cv::Mat& getFirstFrame() const { return _firstFrame; }
+
+    // The next frame in order, starting with the start frame; waits only if
+    // it is not decoded yet
+    bool nextFrame(cv::Mat& frame);
+    const std::string& getError() const { return _err; }
+
+private:
+    enum SOURCE_TYPE
+    {
+        SOURCE_IMAGE,
+        SOURCE_FILES,
+        SOURCE_VIDEO,
+        SOURCE_POOL,
+    };
+
+    struct Slot
+    {
+        int     index;      // Frame held or being decoded
+        bool    isReady;
+        cv::Mat image;      // Empty if the frame could not be decoded
+    };
+
+    bool startPrefetch(int startFrame);
+    bool listImages(const std::string& dir);
+    int nextPick();
+    // Hand the frames up to RingSize ahead of the next one to the decoders;
+    // called with _mutex locked
+    void schedule();
+    void decodeFile(int index, int fileIndex);
+    void decodeVideo();
+    void finishFrame(int index, cv::Mat& image, const std::string& err);
+    // A pool image fitted to the frame size, from the cache if possible
+    cv::Mat loadPoolImage(const std::string& file);
+
+    typedef std::list<std::pair<std::string, cv::Mat> > CacheList;
+
+    SOURCE_TYPE              _sourceType;
+    std::string              _path;
+    std::vector<std::string> _files;
+    cv::VideoCapture         _video;    // Only read by the one video decode task
+    cv::Mat                  _firstFrame;
+
+    Slot                     _slots[RingSize];
+    int                      _nextFrame;        // Next frame to hand out
+    int                      _nextScheduled;    // First frame not given to a decoder
+    int                      _pendingTasks;
+    bool                     _isVideoDecoding;
+    bool                     _isClosing;
+    std::mutex               _mutex;
+    std::condition_variable  _condition;
+    std::string              _err;
+
+    // Pool mode
+    std::mt19937             _rng;
+    cv::Size                 _frameSize;
+    CacheList                _cache;        // Most recently used first
+    std::unordered_map<std::string, CacheList::iterator> _cacheIndex;
+    size_t                   _cacheBytes;
+    size_t                   _cacheBudget;
+};
+
+} // namespace ov
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include "OVGL.h"
+
+namespace ov
+{
+
+// The background image texture. Storage is allocated once per resolution in
+// the image's own channel layout, and each new image is written with
+// glTexSubImage2D through a streaming pixel unpack buffer, so replacing the
+// background every frame costs one copy and no reallocation.
+class OVBackgroundTexture
+{
+public:
+    OVBackgroundTexture();
+
+    // Create the texture; the context must be current
+    void init();
+    // Delete the texture and buffer; the context that created them must be current
+    void release();
+
+    GLuint getTextureId() const { return _textureId; }
+    int getWidth() const { return _width; }
+    int getHeight() const { return _height; }
+
+    // Replace the contents with a CV_8UC3 BGR image, top row first. Returns
+    // without waiting for the GPU to finish with the previous image.
+    void upload(const cv::Mat& image);
+
+private:
+    bool hasUnpackBuffer() const;
+    void allocate(int width, int height);
+
+    GLuint     _textureId;
+    int        _width;
+    int        _height;
+    GLuint     _unpackBuffer;
+    GLsizeiptr _unpackBufferSize;
+};
+
+} // namespace ov
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "OVBackgroundSequence.h"
+#include "OVBatchManifest.h"
+#include "OVCommon.h"
+#include "OVFrameAnnotator.h"
+#include "OVFrameEncoder.h"
+#include "OVFramePipeline.h"
+#include "OVFrameSink.h"
+#include "OVPoseSource.h"
+#include "OVPostProcessor.h"
+#include "OVRenderContext.h"
+#include "OVRenderer.h"
+
+namespace ov
+{
+
+// One blur and noise pair of a job, with its own output directory
+struct BatchVariant
+{
+    double       blurSigma;
+    double       noiseVariance;       // Of the noise added to every sample, in intensity levels squared
+    std::string  outputDir;
+};
+
+// One line of a batch file:
+// <model> <image> <camera> <poses> <blur> <noise> <output> [<key>=<value> ...]
+//
+// <image> is a still image, or a directory of images or a video file whose
+// frame i is the background of pose i (see OVBackgroundSequence). <poses> is
+// a text or binary poses file (see OVPoseSource), or a description of poses
+// to generate such as fibonacci:count=500,radius=400 (see OVPoseGenerator).
+// <blur> and <noise> may be lists and ranges such as 0,0.5,1 or 0:2:0.5
+// (first:last:step) of values >= 0; every frame is then rendered once and
+// post-processed for each blur and noise pair, into
+// <output>/blur<sigma>_noise<variance>/ with the values to 6 significant
+// digits, which must tell the pairs apart. The auxiliary images are written
+// once in <output>. The pairs share the noise pattern, scaled to their
+// variance.
+//
+// Options:
+//   outputs=depth,ids,normals  Auxiliary images written next to every frame
+//   background=random          Each frame's background is a random image of the
+//                              <image> directory, fitted to the camera's image size
+//   seed=<n>                   Seed of the random backgrounds and the noise (0)
+//   cache=<megabytes>          Memory for decoded random backgrounds (512)
+//   format=png|jpg|ppm|raw|qoi Image format of the frames (png)
+//   quality=<n>                PNG compression level 0-9 or JPEG quality 0-100
+//                              (OpenCV's defaults); low PNG levels, QOI, PPM and
+//                              raw favour speed, high PNG levels size; for videos,
+//                              the codec's quality 0-100 where it has one
+//   container=files|archive|video|ring
+//                              Numbered files, one frames.ovf archive (see
+//                              OVFrameArchive) or one video per output directory,
+//                              or a shared-memory ring (files)
+//   codec=ffv1|mjpg|mp4v|avc1  Video codec, ffv1 being lossless (ffv1)
+//   fps=<n>                    Video frame rate (30)
+//   ring=<name>                Shared memory name of container=ring, suffixed
+//                              _0, _1, ... by blur and noise pair (ovframes)
+//   slots=<n>                  Frames a ring holds for its consumer (8)
+//   crop=<margin>              Read back, post-process and write only the
+//                              model's projected bounding box, grown by margin
+//                              pixels; every frame and auxiliary image then
+//                              covers its own crop, listed in the manifest,
+//                              the archive or the ring slot. Not for videos.
+//   annotate=boxes             Every frame's box of the model's projected vertices
+//                              in <output>/annotations.jsonl (see OVFrameAnnotator)
+//   keypoints=<file>           Also the projected keypoints of a file of x y z
+//                              model coordinates, with their visibility against
+//                              the depth image; implies annotate=boxes and needs
+//                              a renderer with depth images. Not for rings.
+//
+// Archives resume like files; a video is written again from its first frame,
+// with the auxiliary images as files next to it. container=ring writes
+// nothing to disk: every frame, with its auxiliary images, pose and camera
+// matrix, goes to the process reading the ring (see ov_frame_ring.h), and
+// generation waits for it.
+
+struct BatchJob
+{
+    std::string  modelFile;
+    std::string  imageFile;           // Image, image directory or video
+    std::string  cameraFile;
+    std::string  posesFile;
+    std::vector<BatchVariant> variants;
+    std::string  outputDir;           // Relative to the batch file; the auxiliary images
+    int          auxOutputs;          // AUX_OUTPUT flags
+    bool         isRandomBackground;
+    unsigned int backgroundSeed;
+    int          backgroundCacheSize; // Megabytes
+    FRAME_FORMAT imageFormat;
+    int          imageQuality;        // -1 for the encoder's default
+    FRAME_CONTAINER container;
+    VideoSettings   video;
+    RingSettings    ring;
+    int          cropMargin;          // Pixels around the model's crop, -1 for whole frames
+    bool         isAnnotated;
+    std::string  keypointsFile;       // Empty for boxes alone
+};
+
+struct BatchProgress
+{
+    const BatchJob* job;
+    int             lineIndex;
+    int             frameIndex;     // Frames finished, counting resumed ones, minus one
+    int             frameCount;
+    int             resumedCount;   // Frames finished by an earlier run
+};
+
+bool
+ParseBatchLine(const std::string& line, const std::string& batchDir, BatchJob& job, std::string& err);
+
+bool
+LoadBatchFile(const std::string& batchFile, std::vector<BatchJob>& jobs, std::string& err);
+
+// Open the manifest of the output directory of one of a job's variants,
+// keeping the frames of an earlier run whose files are intact
+bool
+OpenBatchManifest(const BatchJob& job, int variantIndex, int frameCount, OVBatchManifest& manifest,
+                  std::string& err);
+
+// Renders the image sequences of a batch file with any renderer. The
+// context is NULL for renderers that do not draw through OpenGL. Rendering
+// and readback stay on the calling thread; post-processing and encoding run
+// on the stages of an OVFramePipeline, and the progress callback is called
+// on the calling thread, in frame order, as frames are written. The noise
+// of a frame depends only on the seed, the job's line and the frame index.
+// Every output directory keeps an OVBatchManifest, so rerunning a batch
+// file skips the frames an interrupted run finished. The workers of a
+// sharded run (see OVBatchCoordinator) instead render the frame ranges
+// they are given between begin and end, and leave the manifests to the
+// coordinator.
+class OVBatchGenerator
+{
+public:
+    // Return false to stop the generation
+    typedef std::function<bool(const BatchProgress& progress)> ProgressCallback;
+    typedef std::function<void(int width, int height)>         FrameSizeCallback;
+    // Called on an encoding thread once a frame's files are in place; crop
+    // is empty unless the job crops frames, and annotation unless the
+    // variant annotates the frame
+    typedef std::function<bool(int lineIndex, int variantIndex, int frameIndex, long long numBytes,
+                               const cv::Rect& crop, const std::string& annotation)> FrameWrittenCallback;
+
+    OVBatchGenerator(OVRenderer* renderer, OVRenderContext* context);
+
+    void setProgressCallback(const ProgressCallback& callback) { _progressCallback = callback; }
+    void setFrameSizeCallback(const FrameSizeCallback& callback) { _frameSizeCallback = callback; }
+    void setFrameWrittenCallback(const FrameWrittenCallback& callback) { _frameWrittenCallback = callback; }
+    // Poses rendered together when the renderer supports multi-pose passes
+    void setPosesPerPass(int posesPerPass) { _posesPerPass = posesPerPass; }
+    // Threads of the post-processing and encoding stages, 0 for a default share
+    void setPipelineWorkers(int numProcessWorkers, int numEncodeWorkers);
+    // Queue occupancy of the stages over the last run
+    const std::vector<PipelineStageStats>& getPipelineStats() const { return _pipelineStats; }
+    // Frame encoding over the last run, without the auxiliary images
+    void getEncodeStats(EncodeStats& stats) const;
+
+    bool run(const std::string& batchFile);
+    // Frames [firstFrame, endFrame) of a line of the batch file given to
+    // begin; the model and poses file stay loaded from one call to the next
+    bool begin(const std::string& batchFile);
+    bool runFrames(int lineIndex, int firstFrame, int endFrame);
+    void end();
+    const std::string& getError() const { return _err; }
+
+private:
+    // A frame from its render to its submission
+    struct RenderedFrame
+    {
+        int      frameIndex;
+        Pose     pose;
+        cv::Rect crop;          // Region of the frame read back
+        Mat34    projection;    // Model to image, for annotations
+    };
+
+    bool runJob(const BatchJob& job, int lineIndex, int firstFrame, int endFrame);
+    // Load the job's scene, with its background sequence at startFrame,
+    // and set up the annotator for it
+    bool setupScene(const BatchJob& job, int startFrame);
+    // Open the sinks of the job's variants and auxiliary images, once the
+    // frame size is known
+    bool openSinks(const BatchJob& job);
+    // Whether every variant of a frame is in its manifest
+    bool isFrameDone(int frameIndex) const;
+    // Skip the poses of finished frames, and their backgrounds
+    bool skipFinishedFrames(OVPoseSource& poses, int endFrame);
+    // Collect the oldest queued frame and submit it; false if stopped, or
+    // with isFailed set if the frame cannot be read back
+    bool writeFrame(const BatchJob& job, BatchProgress& progress, bool& isFailed);
+    // Hand a frame to the post-processing and encoding stages, once for every
+    // variant still missing it; false if stopped
+    bool saveFrame(const BatchJob& job, const RenderedFrame& rendered,
+                   BatchProgress& progress, cv::Mat& image, AuxImages* auxImages = NULL);
+    // Report the frames the pipeline has written, in order, waiting for at
+    // least one if isWaiting; false if stopped
+    bool reportProgress(BatchProgress& progress, bool isWaiting);
+    static void processImage(PipelineFrame& frame);
+    bool writeImages(const PipelineFrame& frame);
+
+    OVRenderer*       _renderer;
+    OVRenderContext*  _context;
+    ProgressCallback  _progressCallback;
+    FrameSizeCallback _frameSizeCallback;
+    FrameWrittenCallback _frameWrittenCallback;
+    std::vector<BatchJob> _jobs;
+    std::string       _modelFile;       // Loaded in the renderer
+    std::unique_ptr<OVPoseSource> _poses;
+    std::string       _posesFile;
+    // Renderer settings restored by end
+    Vec3              _offsetRotation;
+    Vec3              _offsetTranslation;
+    double            _offsetScale;
+    double            _planeNear;
+    double            _planeFar;
+    int               _posesPerPass;
+    OVBackgroundSequence _background;
+    // Auxiliary images of the frames waiting in the readback queue
+    std::deque<AuxImages> _auxQueue;
+    // The frames waiting in the readback queue
+    std::deque<RenderedFrame> _frameQueue;
+    // Frames are blurred, noised and written by worker threads, and
+    // reported to the progress callback once written
+    std::unique_ptr<OVFramePipeline> _pipeline;
+    int               _numProcessWorkers;
+    int               _numEncodeWorkers;
+    // Pipeline sequence after the last variant of each frame not reported yet
+    std::deque<int>   _frameEnds;
+    int               _numReported;
+    // One manifest and post-processor per variant of the job
+    std::vector<std::unique_ptr<OVBatchManifest> > _manifests;
+    bool              _isManifestUsed;
+    bool              _isJobManifestUsed; // Unless the job's frames leave no files
+    // Annotations of the job's frames, made by the post-processing stage
+    OVFrameAnnotator  _annotator;
+    OVAnnotationFile  _annotations;
+    std::vector<PipelineStageStats> _pipelineStats;
+    std::vector<OVPostProcessor> _postProcessors;
+    std::unique_ptr<OVFrameEncoder> _encoder;
+    // Where the variants' frames go, and the auxiliary images: the first
+    // variant's sink, or one of their own in the job's output directory
+    std::vector<std::unique_ptr<OVFrameSink> > _sinks;
+    std::unique_ptr<OVFrameSink> _auxSinkOwner;
+    OVFrameSink*      _auxSink;
+    // Updated by the encoding threads
+    std::atomic<int>       _numEncoded;
+    std::atomic<long long> _numEncodedRawBytes;
+    std::atomic<long long> _numEncodedBytes;
+    std::atomic<long long> _encodeNanoseconds;
+    std::string       _err;
+};
+
+} // namespace ov
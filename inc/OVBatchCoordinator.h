@@ -0,0 +1,94 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "OVBatch.h"
+#include "OVBatchManifest.h"
+#include "OVChildProcess.h"
+#include "OVFrameAnnotator.h"
+
+namespace ov
+{
+
+// Runs a batch file on several worker processes, each with its own
+// renderer and OpenGL context, since one context renders on one core at
+// a time. The coordinator splits the lines into shards of consecutive
+// frames and hands them out as workers ask for work, in shrinking sizes
+// (a share of the frames left), so workers that finish early take more
+// and all of them run until close to the end. Workers talk to the
+// coordinator over their standard input and output:
+//
+//   worker:      ready | error <message>
+//   coordinator: shard <line> <first frame> <end frame>
+//   worker:      frame <line> <variant> <frame> <bytes> <x> <y> <width> <height> [<annotation>] ...
+//                done | error <message>
+//
+// and exit at the end of their input. The coordinator keeps the manifests
+// and annotation files of the output directories, so a sharded run resumes
+// like any other, and merges the progress of all workers. Workers write
+// frames as files only, as archives and videos have one writer.
+class OVBatchCoordinator
+{
+public:
+    static const int MinShardSize = 16;
+    static const int MaxShardSize = 4096;
+
+    // Serve a coordinator on standard input and output, rendering the
+    // shards it sends with generator
+    static bool RunWorker(OVBatchGenerator& generator, const std::string& batchFile, std::string& err);
+
+    OVBatchCoordinator();
+
+    // Called on the threads serving the workers, one call at a time
+    void setProgressCallback(const OVBatchGenerator::ProgressCallback& callback) { _progressCallback = callback; }
+
+    // workerCommand starts a worker serving the same batch file
+    bool run(const std::string& batchFile, const std::vector<std::string>& workerCommand, int numWorkers);
+    // Frames written by the workers in the last run
+    int getWrittenCount() const { return _numWritten; }
+    const std::string& getError() const { return _err; }
+
+private:
+    struct Shard
+    {
+        int lineIndex;
+        int firstFrame;
+        int endFrame;
+    };
+
+    struct Line
+    {
+        BatchJob                         job;
+        int                              frameCount;
+        int                              nextFrame;     // First frame not handed out
+        int                              numDone;       // Including resumed frames
+        int                              numResumed;
+        // One manifest per variant, and which variants of every frame are
+        // written, frame by frame
+        std::vector<std::unique_ptr<OVBatchManifest> > manifests;
+        std::vector<char>                isVariantDone;
+        std::vector<int>                 numMissing;    // Variants of every frame not written
+        std::unique_ptr<OVAnnotationFile> annotations;  // Of an annotated job
+
+        bool isDone(int frameIndex) const { return numMissing[frameIndex] == 0; }
+    };
+
+    bool nextShard(Shard& shard);
+    void serveWorker(OVChildProcess& worker, int workerIndex);
+    bool addFrame(const std::string& message);
+    void fail(const std::string& err);
+
+    OVBatchGenerator::ProgressCallback _progressCallback;
+    std::vector<Line> _lines;
+    int               _numWorkers;
+    int               _lineCursor;      // First line with frames not handed out
+    long long         _numPending;      // Frames not handed out
+    int               _numWritten;
+    bool              _isStopped;
+    std::mutex        _mutex;
+    std::string       _err;
+};
+
+} // namespace ov
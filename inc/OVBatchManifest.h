@@ -0,0 +1,67 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ov
+{
+
+// The frames a batch job has finished in its output directory, so a run
+// cut short by a crash or a preempted node resumes where it stopped. The
+// manifest is an append-only text file:
+//
+//   ovmanifest 1
+//   params <the job's parameters>
+//   frame <index> <bytes>            One line per finished frame
+//   frame <index> <bytes> <x> <y> <width> <height>
+//                                    With the crop of a cropped frame's files
+//
+// A frame's line is appended once its files are in place, and is trusted
+// on resume only while its image still has that size. A manifest of other
+// parameters is started over, as its frames are about to be overwritten.
+class OVBatchManifest
+{
+public:
+    static const char* const FileName;
+
+    // Whether the files of a frame listed in the manifest are intact
+    typedef std::function<bool(int frameIndex, long long numBytes)> FrameValidator;
+
+    OVBatchManifest();
+    ~OVBatchManifest();
+
+    // Open or create the manifest of outputDir for a job of frameCount
+    // frames, keeping the valid frames a run with the same parameters wrote
+    bool open(const std::string& outputDir, const std::string& parameters, int frameCount,
+              const FrameValidator& isValid);
+    void close();
+
+    bool isDone(int frameIndex) const { return _isOpen && _isDone[frameIndex]; }
+    // Frames finished by earlier runs
+    int getResumedCount() const { return _numResumed; }
+    // Record a finished frame and, if not empty, the crop its files cover;
+    // safe from several threads
+    bool add(int frameIndex, long long numBytes, const cv::Rect& crop = cv::Rect());
+
+    const std::string& getError() const { return _err; }
+
+private:
+    OVBatchManifest(const OVBatchManifest&);
+    OVBatchManifest& operator=(const OVBatchManifest&);
+
+    bool create(const std::string& parameters);
+
+    std::string       _fileName;
+    FILE*             _file;
+    std::mutex        _mutex;
+    std::vector<char> _isDone;
+    int               _numResumed;
+    bool              _isOpen;
+    std::string       _err;
+};
+
+} // namespace ov
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace ov
+{
+
+// A fixed-capacity multi-producer multi-consumer queue without locks
+// (D. Vyukov's bounded MPMC queue). Each cell carries a sequence number
+// that tells producers and consumers whose turn it is, so tryPush and
+// tryPop only contend on one atomic position each. The capacity is
+// rounded up to a power of two.
+template<class T>
+class OVBoundedQueue
+{
+public:
+    explicit OVBoundedQueue(int capacity)
+        : _cells(RoundUpToPowerOfTwo(capacity))
+    {
+        for (size_t i = 0; i < _cells.size(); ++i)
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        _mask = _cells.size() - 1;
+        _pushPos.store(0, std::memory_order_relaxed);
+        _popPos.store(0, std::memory_order_relaxed);
+    }
+
+    int capacity() const { return (int)_cells.size(); }
+
+    // Approximate number of items, for statistics
+    int size() const
+    {
+        size_t push = _pushPos.load(std::memory_order_relaxed);
+        size_t pop = _popPos.load(std::memory_order_relaxed);
+        return push > pop ? (int)(push - pop) : 0;
+    }
+
+    // False if the queue is full; item is moved from only on success
+    bool tryPush(T& item)
+    {
+        size_t pos = _pushPos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell& cell = _cells[pos & _mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = (ptrdiff_t)sequence - (ptrdiff_t)pos;
+            if (diff == 0)
+            {
+                if (_pushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.item = std::move(item);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = _pushPos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // False if the queue is empty
+    bool tryPop(T& item)
+    {
+        size_t pos = _popPos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell& cell = _cells[pos & _mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = (ptrdiff_t)sequence - (ptrdiff_t)(pos + 1);
+            if (diff == 0)
+            {
+                if (_popPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    item = std::move(cell.item);
+                    cell.sequence.store(pos + _mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = _popPos.load(std::memory_order_relaxed);
+        }
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T                   item;
+    };
+
+    static size_t RoundUpToPowerOfTwo(int n)
+    {
+        size_t size = 1;
+        while ((int)size < n)
+            size *= 2;
+        return size;
+    }
+
+    OVBoundedQueue(const OVBoundedQueue&);
+    OVBoundedQueue& operator=(const OVBoundedQueue&);
+
+    std::vector<Cell>   _cells;
+    size_t              _mask;
+    // Padded apart, as producers and consumers run on different threads
+    char                _padding0[64];
+    std::atomic<size_t> _pushPos;
+    char                _padding1[64];
+    std::atomic<size_t> _popPos;
+};
+
+} // namespace ov
@@ -13,13 +13,20 @@
 
 #define wxUSE_GUI 1
 
+#include <chrono>
 #include <fstream>
 #include <queue>
 #include <unordered_map>
 #include "wx/glcanvas.h"
+#include "wx/timer.h"
 #include "ObjViewer.h"
 #include "OVCommon.h"
-#include "TinyObjLoader.h"
+#include "OVFrameScheduler.h"
+#include "OVFrameStats.h"
+#include "OVGLRenderer.h"
+#include "OVGLTimer.h"
+#include "OVRenderContext.h"
+#include "OVShaderRenderer.h"
 
 namespace ov
 {
@@ -27,8 +34,8 @@ namespace ov
 class ObjViewer;
 class PenPoseTracker;
 
-// The canvas window
-class OVCanvas : public wxGLCanvas
+// The canvas window: the interactive frontend of the render core
+class OVCanvas : public wxGLCanvas, public OVRenderContext
 {
 public:
     OVCanvas(ObjViewer *objViewer,
@@ -39,11 +46,6 @@ public:
 
     ~OVCanvas();
 
-    static int FrameWidth;
-    static int FrameHeight;
-    static double PlaneNear;
-    static double PlaneFar;
-
     void setRenderMode(int renderMode);
     bool setForegroundObject(const std::string& filename, bool isUnitization);
     bool setBackgroundImamge(const std::string& filename);
@@ -55,6 +57,18 @@ public:
     void setLightingOn(bool lightingOn);
     void setOffsetPose(const Vec3& r, const Vec3& t, const double s);
     void getOffsetPose(Vec3& r, Vec3& t, double& s);
+    const DrawListStats& getDrawListStats() const { return _renderer->getDrawListStats(); }
+    OVRenderer* getRenderer() { return _renderer; }
+    // Frame timing overlay and status bar readout
+    void setFrameStatsEnabled(bool isEnabled);
+    const OVFrameStats& getFrameStats() const { return _frameStats; }
+
+    // OVRenderContext
+    bool makeCurrent();
+    void swapBuffers();
+    bool resize(int width, int height);
+    int getWidth() const;
+    int getHeight() const;
 
 protected:
     void onMouse(wxMouseEvent& evt);
@@ -62,47 +76,56 @@ protected:
     void onIdle(wxIdleEvent& evt);
     void onPaint(wxPaintEvent& evt);
     void onSize(wxSizeEvent& evt);
+    void onFrameTimer(wxTimerEvent& evt);
 
 private:
-    // OpenGL functions
-    void oglInit();
-    void drawBackground(GLuint backgroundImageTextureId);
-    void drawForeground(const std::vector<tinyobj::shape_t>& shapes,
-                        const std::vector<tinyobj::material_t>& materials,
-                        const std::unordered_map<std::string, GLuint>& textureIds);
-    void unitize(std::vector<tinyobj::shape_t>& shapes);
+    void render();
+    void updateViewport();
+    // Schedule a frame instead of repainting at once
+    void requestRender(bool isInteractive);
+    bool setupScaledTarget(int width, int height);
+    // Report the frames whose GPU time has come back to the scheduler
+    void collectDrawTimes();
+    void drawFrameStats();
 
     // Widgets
     ObjViewer*   _objViewer;
     wxGLContext* _oglContext;
 
-    // Foreground objects
-    std::vector<tinyobj::shape_t>           _shapes;
-    std::vector<tinyobj::material_t>        _materials;
-    std::unordered_map<std::string, GLuint> _textureIds;
-
-    // Backgroubd image
-    cv::Mat _backgroundImage;
-    GLuint  _backgroundImageTextureId;
+    // Render core
+    OVGLRenderer* _renderer;
+
+    // Frame scheduling
+    OVFrameScheduler _scheduler;
+    wxTimer          _frameTimer;
+    double           _renderScale;
+    // Target of the reduced-resolution frames
+    GLuint           _scaledFramebuffer;
+    GLuint           _scaledColorbuffer;
+    GLuint           _scaledDepthbuffer;
+    int              _scaledWidth;
+    int              _scaledHeight;
+    // GPU time of the drawing, read back a few frames late instead of
+    // waiting for it; the frames in flight by frame number modulo the latency
+    struct DrawTime
+    {
+        double scale;
+        double cpuMilliseconds;
+    };
+    OVGLTimer        _drawTimer;
+    DrawTime         _drawTimes[OVGLTimer::Latency];
+    int              _drawCount;
+
+    // Frame timing
+    OVFrameStats                          _frameStats;
+    cv::Mat                               _statsOverlay;
+    std::chrono::steady_clock::time_point _lastStatusUpdate;
 
     // Selections
-    int  _renderMode;
     bool _isNewFile;
-    bool _lightingOn;
-
-    // Offset transformation coefficients
-    Vec3   _offsetRotation;
-    Vec3   _offsetTranslation;
-    double _offsetScale;
-
-    // For OpenGL rendering
-    double _modelViewMatrix[16];
-    double _projectionMatrix[16];
-    Mat3   _R;
-    Vec3   _t;
 
     // For trackball
     Vec2 _mousePos;
 };
 
-} // namespace ov
\ No newline at end of file
+} // namespace ov
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace ov
+{
+
+// A child process whose standard input and output are pipes to this
+// process, exchanging lines of text; its standard error is this process's
+class OVChildProcess
+{
+public:
+    OVChildProcess();
+    ~OVChildProcess();
+
+    // This program's executable, for starting more of it
+    static std::string GetExecutablePath(const char* argv0);
+
+    // args[0] is the executable
+    bool start(const std::vector<std::string>& args);
+    // Without the newline; false once the pipe is broken
+    bool writeLine(const std::string& line);
+    // Without the newline; false at the end of the output
+    bool readLine(std::string& line);
+    // Close the child's input and wait for it to exit; the exit code, or
+    // -1 if it did not exit normally
+    int wait();
+
+private:
+    OVChildProcess(const OVChildProcess&);
+    OVChildProcess& operator=(const OVChildProcess&);
+
+    FILE* _input;       // The child's standard input
+    FILE* _output;      // The child's standard output
+#ifdef _WIN32
+    void* _process;
+#else
+    int   _pid;
+#endif
+};
+
+} // namespace ov
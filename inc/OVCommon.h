@@ -52,4 +52,16 @@ typedef Eigen::Array<uint8_t, Eigen::Dynamic, Eigen::Dynamic> ArrayXXu8;
 typedef Eigen::Array<uint16_t, Eigen::Dynamic, Eigen::Dynamic> ArrayXXu16;
 // ArrayXXf and ArrayXXd are already defined in eigen.
 
+// The SplitMix64 output function. SplitMix64 is counter-based: its output n
+// is MixBits(seed + n * GoldenGamma), so any draw can be made directly.
+const uint64_t GoldenGamma = 0x9E3779B97F4A7C15ull;
+
+inline uint64_t
+MixBits(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
 }
\ No newline at end of file
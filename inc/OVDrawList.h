@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "TinyObjLoader.h"
+
+namespace ov
+{
+
+// A contiguous range of the merged index buffer sharing one material and texture
+struct DrawBatch
+{
+    int          materialId;    // -1 means the default material
+    unsigned int textureId;     // 0 means untextured
+    bool         isTransparent;
+    unsigned int firstIndex;
+    unsigned int indexCount;
+};
+
+struct DrawListStats
+{
+    int batchCount;
+    int stateChangeCount;           // Material and texture rebinds per frame
+    int unsortedStateChangeCount;   // Rebinds when drawing the shapes in file order
+    int triangleCount;
+    int vertexCount;
+};
+
+// Merge all shapes of a model into one vertex stream and group their faces
+// into index ranges sorted by (transparency, texture, material). Built once
+// per model load, so a frame only changes state between batches.
+class OVDrawList
+{
+public:
+    OVDrawList();
+
+    void build(const std::vector<tinyobj::shape_t>& shapes,
+               const std::vector<tinyobj::material_t>& materials,
+               const std::unordered_map<std::string, unsigned int>& textureIds);
+    void clear();
+
+    const std::vector<float>&        positions() const { return _positions; }
+    const std::vector<float>&        normals() const { return _normals; }
+    const std::vector<float>&        texcoords() const { return _texcoords; }
+    // Index of the shape every vertex comes from
+    const std::vector<unsigned int>& shapeIds() const { return _shapeIds; }
+    const std::vector<unsigned int>& indices() const { return _indices; }
+    const std::vector<DrawBatch>&    batches() const { return _batches; }
+    const DrawListStats&             stats() const { return _stats; }
+
+private:
+    // Merged vertex attributes (3, 3 and 2 floats per vertex)
+    std::vector<float>        _positions;
+    std::vector<float>        _normals;
+    std::vector<float>        _texcoords;
+    std::vector<unsigned int> _shapeIds;
+    std::vector<unsigned int> _indices;
+
+    std::vector<DrawBatch> _batches;
+    DrawListStats          _stats;
+};
+
+} // namespace ov
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+
+namespace ov
+{
+
+// Path, file and error helpers shared by the viewer and the headless
+// renderer; unlike OVUtil.h, this does not pull in wxWidgets
+
+std::string
+GetFileName(const std::string& s);
+
+std::string
+GetBaseName(const std::string& s);
+
+std::string
+GetExt(const std::string& s);
+
+std::string
+GetDir(const std::string& s);
+
+std::string
+ZeroPadNumber(int num, int width);
+
+bool
+IsDirectoryExists(std::string dirName);
+
+void
+CreateDirectorys(std::string path);
+
+// Size of a regular file, -1 if there is none
+long long
+GetFileLength(const std::string& fileName);
+
+// Rename from to to, replacing to if it exists
+bool
+RenameFile(const std::string& from, const std::string& to);
+
+// Cut a file down to length bytes
+bool
+TruncateFile(const std::string& fileName, long long length);
+
+typedef void (*ErrorHandler)(const std::string& msg);
+
+// Errors go to stderr by default; the viewer shows them in a message box
+void
+SetErrorHandler(ErrorHandler handler);
+
+void
+ReportError(const std::string& msg);
+
+} // namespace ov
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include "OVCommon.h"
+
+namespace ov
+{
+
+// 2D annotations of rendered frames, made on the post-processing threads
+// from the pose alone, without reloading the model: the tight box of the
+// model's projected vertices, and the pixel of every keypoint with its
+// visibility against the frame's depth image. A frame is one JSON line:
+//
+//   {"frame":12,"box":[x0,y0,x1,y1],"keypoints":[[x,y,v],...]}
+//
+// in pixels, the top left corner of the frame at 0, 0. The box is clipped
+// to the frame and left out while the model is out of view. v is 0 for a
+// keypoint outside the frame, 1 for one behind the model's surface and 2
+// for a visible one, as in COCO.
+class OVFrameAnnotator
+{
+public:
+    // A keypoint is on the visible surface up to this fraction of its
+    // distance behind the depth image
+    static const float DepthTolerance;
+
+    // A text file of x y z model coordinates, one keypoint per line
+    static bool LoadKeypoints(const std::string& fileName, Mat3Xf& keypoints, std::string& err);
+
+    void setScene(const Mat3Xf& vertices, const Mat3Xf& keypoints, const cv::Size& frameSize);
+    bool hasKeypoints() const { return _keypoints.cols() > 0; }
+
+    // The line of a frame. projection maps a model point to (x w, y w, w),
+    // w being its distance along the optical axis; depth covers crop of the
+    // frame, and is only read for keypoints. Safe from several threads.
+    std::string annotate(int frameIndex, const Mat34& projection, const cv::Mat& depth, const cv::Rect& crop) const;
+
+private:
+    Mat3Xf   _vertices;
+    Mat3Xf   _keypoints;
+    cv::Size _frameSize;
+};
+
+// The annotations of a job's frames, annotations.jsonl in its output
+// directory. Lines are appended as frames are written, before their
+// manifest entries; a frame written again by a resumed run is annotated
+// again, and its last whole line counts.
+class OVAnnotationFile
+{
+public:
+    static const char* const FileName;
+
+    OVAnnotationFile();
+    ~OVAnnotationFile();
+
+    // Keep the lines of an earlier run of the job, or start over
+    bool open(const std::string& outputDir, bool isResumed);
+    void close();
+    // Safe from several threads
+    bool add(const std::string& line);
+
+    bool isOpen() const { return _file != NULL; }
+    const std::string& getError() const { return _err; }
+
+private:
+    OVAnnotationFile(const OVAnnotationFile&);
+    OVAnnotationFile& operator=(const OVAnnotationFile&);
+
+    std::string _fileName;
+    FILE*       _file;
+    std::mutex  _mutex;
+    std::string _err;
+};
+
+} // namespace ov
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "OVFrameEncoder.h"
+#include "OVMappedFile.h"
+
+namespace ov
+{
+
+// What an archive entry holds: a frame's image, one of its auxiliary
+// images (EXR or 16-bit PNG, as written next to frames otherwise), or the
+// region of the frame a cropped frame's images cover
+enum ARCHIVE_ENTRY
+{
+    ENTRY_IMAGE,
+    ENTRY_DEPTH,
+    ENTRY_SHAPE_IDS,
+    ENTRY_MATERIAL_IDS,
+    ENTRY_NORMALS,
+    ENTRY_CROP,         // int x, y, width, height
+    ENTRY_COUNT,
+};
+
+// Where an entry's data lies in an archive
+struct ArchiveEntry
+{
+    int       frameIndex;
+    int       type;         // ARCHIVE_ENTRY
+    long long offset;
+    long long size;
+};
+
+// The frames of a batch output directory in one file, so millions of
+// frames do not become millions of files. The file is a header, the
+// entries one after another, each behind a record header, and an index
+// of them all at the end:
+//
+//   header   "OVFRAMES" version format width height
+//   record   "OVFR" frame type 0 size, then size bytes    In the order written
+//   index    frame type offset size                       One per entry
+//   trailer  index offset, entry count, "OVFINDEX"
+//
+// in native byte order. Entries go in the order frames finish, not by
+// frame index; a frame written again supersedes its earlier entries. A
+// file cut short before its index is read by walking the records, up to
+// the first incomplete one.
+class OVFrameArchive
+{
+public:
+    static const char* const FileName;
+    // Entries are copied into chunks of this size, written in the background
+    static const size_t ChunkSize = 8 << 20;
+    // Chunks waiting for the disk before appending waits too
+    static const int MaxPendingChunks = 4;
+
+    OVFrameArchive();
+    ~OVFrameArchive();
+
+    // Open fileName for appending frames of format and size, keeping the
+    // entries of an earlier run; an archive of another format or size is
+    // started over
+    bool open(const std::string& fileName, FRAME_FORMAT format, const cv::Size& frameSize);
+    // Write the index and close; false if any entry was lost
+    bool close();
+
+    // Add an entry; safe from several threads
+    bool append(int frameIndex, ARCHIVE_ENTRY type, const unsigned char* data, size_t size);
+
+    const std::string& getError() const { return _err; }
+
+private:
+    OVFrameArchive(const OVFrameArchive&);
+    OVFrameArchive& operator=(const OVFrameArchive&);
+
+    // The writer thread's loop
+    void writeChunks();
+
+    std::string                _fileName;
+    FILE*                      _file;
+    std::thread                _writer;
+    std::mutex                 _mutex;
+    std::condition_variable    _condition;
+    std::vector<unsigned char> _chunk;          // Filled by append
+    std::deque<std::vector<unsigned char> > _fullChunks;
+    std::vector<std::vector<unsigned char> > _freeChunks;
+    std::vector<ArchiveEntry>  _entries;
+    long long                  _size;           // Including the chunks not written yet
+    bool                       _isClosing;
+    bool                       _isFailed;
+    std::string                _err;
+};
+
+// Random access to the entries of an archive, mapped into memory. Only
+// the index is read up front.
+class OVFrameArchiveReader
+{
+public:
+    OVFrameArchiveReader();
+
+    bool open(const std::string& fileName);
+    void close();
+
+    FRAME_FORMAT getFormat() const { return _format; }
+    cv::Size getFrameSize() const { return _frameSize; }
+    // The latest entry of every frame and type, by frame and then type
+    const std::vector<ArchiveEntry>& getEntries() const { return _entries; }
+
+    // The encoded data of an entry, NULL if the archive has none
+    const unsigned char* getEntry(int frameIndex, ARCHIVE_ENTRY type, size_t& size) const;
+    // The region of the frame its images cover, the whole frame unless
+    // it was cropped
+    cv::Rect readCrop(int frameIndex) const;
+    // A frame's image as CV_8UC3 BGR; false if it is missing or corrupt
+    bool readImage(int frameIndex, cv::Mat& image) const;
+    // An auxiliary image, in the type it was rendered in
+    bool readAuxImage(int frameIndex, ARCHIVE_ENTRY type, cv::Mat& image) const;
+
+    const std::string& getError() const { return _err; }
+
+private:
+    OVMappedFile                    _file;
+    FRAME_FORMAT                    _format;
+    cv::Size                        _frameSize;
+    std::vector<ArchiveEntry>       _entries;
+    std::unique_ptr<OVFrameEncoder> _decoder;
+    std::string                     _err;
+};
+
+} // namespace ov
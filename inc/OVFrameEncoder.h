@@ -0,0 +1,67 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+namespace ov
+{
+
+enum FRAME_FORMAT
+{
+    FORMAT_PNG,
+    FORMAT_JPEG,
+    FORMAT_PPM,     // Binary P6, RGB
+    FORMAT_RAW,     // Headerless BGR rows; the size is the camera's image size
+    FORMAT_QOI,     // The "Quite OK Image" format, lossless
+    FORMAT_COUNT,
+};
+
+// Writes the rendered frames of a batch job. An encoder has no mutable
+// state, so one instance serves all encoding threads. PNG and JPEG go
+// through OpenCV; PPM, raw and QOI are written directly, trading size for
+// speed where intermediate datasets need it.
+class OVFrameEncoder
+{
+public:
+    // quality is the PNG compression level (0-9) or the JPEG quality
+    // (0-100), -1 for OpenCV's default; other formats ignore it
+    static OVFrameEncoder* Create(FRAME_FORMAT format, int quality = -1);
+    static bool ParseFormat(const std::string& name, FRAME_FORMAT& format);
+    static const char* GetFormatName(FRAME_FORMAT format);
+    // Whether quality is -1 or within the range of the format
+    static bool IsValidQuality(FRAME_FORMAT format, int quality);
+
+    virtual ~OVFrameEncoder() {}
+
+    FRAME_FORMAT getFormat() const { return _format; }
+    int getQuality() const { return _quality; }
+    // Including the dot
+    virtual const char* getExtension() const = 0;
+
+    // Encode a CV_8UC3 BGR image into buffer, replacing its contents
+    virtual bool encode(const cv::Mat& image, std::vector<unsigned char>& buffer) const = 0;
+    // Decode what encode wrote into a CV_8UC3 BGR image; raw data has no
+    // header, so it takes frameSize
+    virtual bool decode(const unsigned char* data, size_t size, const cv::Size& frameSize, cv::Mat& image) const = 0;
+    // Encode into a per-thread buffer and write imageBase + getExtension()
+    // through a temporary file renamed over it; numBytes receives the size
+    bool write(const std::string& imageBase, const cv::Mat& image, size_t* numBytes = NULL) const;
+
+protected:
+    OVFrameEncoder(FRAME_FORMAT format, int quality) : _format(format), _quality(quality) {}
+
+    FRAME_FORMAT _format;
+    int          _quality;
+};
+
+// Bytes in and out of an encoder, and the time spent in it summed over threads
+struct EncodeStats
+{
+    int       numFrames;
+    long long numRawBytes;
+    long long numBytes;
+    double    seconds;
+};
+
+} // namespace ov
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "OVBoundedQueue.h"
+#include "OVRenderer.h"
+
+namespace ov
+{
+
+struct BatchJob;
+class OVFrameAnnotator;
+class OVFrameSink;
+class OVPostProcessor;
+
+// A rendered frame on its way to disk
+struct PipelineFrame
+{
+    int                     sequence;   // Position in submission order, set by submit
+    int                     lineIndex;  // Of the job in the batch file
+    int                     variantIndex;
+    int                     frameIndex; // Within the job
+    Pose                    pose;       // As read from the poses file
+    cv::Rect                crop;       // Region of the frame the images cover
+    const BatchJob*         job;
+    const OVPostProcessor*  postProcessor;
+    OVFrameSink*            sink;
+    cv::Mat                 image;      // Shared by the variants of a frame until processed
+    OVFrameSink*            auxSink;    // Of the one variant carrying auxImages
+    AuxImages               auxImages;
+    const OVFrameAnnotator* annotator;  // Of the one variant annotating the frame
+    Mat34                   projection; // Model to image, see OVRenderer::getImageProjection
+    std::string             annotation; // Made by the post-processing stage
+};
+
+// Occupancy of a stage's input queue, sampled at every submission
+struct PipelineStageStats
+{
+    std::string name;
+    int         numWorkers;
+    int         capacity;
+    double      meanOccupancy;
+    int         maxOccupancy;
+};
+
+// Moves frames from the render thread through two worker stages,
+// post-processing and encoding, connected by bounded lock-free queues.
+// submit blocks while the first queue is full, so the render thread never
+// runs more than the queue capacities ahead, and while a stalled frame has
+// too many finished frames waiting behind it. Frames may finish in any
+// order; getCompletedCount only counts a frame once every frame submitted
+// before it has finished too.
+class OVFramePipeline
+{
+public:
+    typedef std::function<bool(PipelineFrame& frame)> StageFunction;
+
+    // 0 workers picks a share of the hardware threads
+    OVFramePipeline(int numProcessWorkers = 0, int numEncodeWorkers = 0, int queueCapacity = 16);
+    ~OVFramePipeline();
+
+    // A stage function returning false fails the pipeline; later frames
+    // pass through without being processed
+    void start(const StageFunction& process, const StageFunction& encode);
+    void submit(PipelineFrame& frame);
+    // Wait until more than count frames have completed, or all of them
+    int waitCompleted(int count);
+    int getCompletedCount() const { return _numCompleted; }
+    int getSubmittedCount() const { return _numSubmitted; }
+    // Skip the work of the frames still queued
+    void cancel() { _isCancelled = true; }
+    // Wait for the submitted frames
+    void waitAll() { waitCompleted(_numSubmitted); }
+    // Wait for the submitted frames and stop the workers
+    void finish();
+
+    bool hasFailed() const { return _hasFailed; }
+    void getStats(std::vector<PipelineStageStats>& stats) const;
+
+private:
+    struct StageSample
+    {
+        long long sum;
+        int       count;
+        int       max;
+    };
+
+    void processLoop();
+    void encodeLoop();
+    void complete(int sequence);
+    void sample(StageSample& sample, int occupancy);
+
+    OVBoundedQueue<PipelineFrame> _processQueue;
+    OVBoundedQueue<PipelineFrame> _encodeQueue;
+    StageFunction                 _process;
+    StageFunction                 _encode;
+    int                           _numProcessWorkers;
+    int                           _numEncodeWorkers;
+    std::vector<std::thread>      _workers;
+    std::atomic<bool>             _isStopping;
+    std::atomic<bool>             _isCancelled;
+    std::atomic<bool>             _hasFailed;
+    StageSample                   _processSample;
+    StageSample                   _encodeSample;
+
+    // Completion in submission order
+    int                           _numSubmitted;
+    std::atomic<int>              _numCompleted;
+    std::vector<bool>             _isDone;      // By sequence modulo its size
+    std::mutex                    _mutex;
+    std::condition_variable       _condition;
+};
+
+} // namespace ov
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "OVCommon.h"
+#include "OVRenderer.h"
+
+struct ov_ring_header;
+
+namespace ov
+{
+
+// The producer side of the shared-memory frame ring that ov_frame_ring.h
+// describes for consumers. Frames are copied into the slots in place of
+// being encoded; publish waits while the consumer holds every slot.
+class OVFrameRing
+{
+public:
+    OVFrameRing();
+    ~OVFrameRing();
+
+    // Create the ring under name, replacing one a killed run left behind.
+    // planes holds 1 << OV_RING_* flags and always includes the color plane.
+    bool create(const std::string& name, int numSlots, const cv::Size& frameSize, unsigned int planes);
+    // Mark the ring closed and remove its name; attached consumers keep
+    // the frames published so far
+    void close();
+    // Make the waits of publish give up, so a stop does not wait for a
+    // consumer that is gone
+    void cancel() { _isCancelled = true; }
+
+    // Copy a frame's OV_RING_PLANE_COUNT planes, indexed by OV_RING_* and
+    // covering crop of the frame, into the next slot; safe from several
+    // threads, which publish in the order they reserve slots
+    bool publish(int lineIndex, int frameIndex, const Pose& pose, const Mat3& cameraMatrix, const cv::Rect& crop,
+                 const cv::Mat* planes);
+
+    bool isOpen() const { return _header != NULL; }
+    const std::string& getError() const { return _err; }
+
+private:
+    OVFrameRing(const OVFrameRing&);
+    OVFrameRing& operator=(const OVFrameRing&);
+
+    std::string           _name;
+    ov_ring_header*       _header;
+    size_t                _size;
+#ifdef _WIN32
+    void*                 _mapping;
+#endif
+    std::atomic<uint64_t> _numReserved;
+    std::atomic<bool>     _isCancelled;
+    std::string           _err;
+};
+
+} // namespace ov
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+
+namespace ov
+{
+
+// Decides when the canvas draws a frame. Changes only mark the view dirty;
+// a timer ticking once per display refresh then draws at most one frame for
+// all the input that arrived in between. While the user is dragging, frames
+// that would miss the refresh interval are drawn at a reduced resolution,
+// and a full-resolution frame follows once the input settles.
+//
+// A frame's time is modeled as a fixed part, for vertices and the CPU, plus
+// a part that grows with the pixel count, fitted from frames drawn at full
+// and at reduced resolution. The resolution is only lowered as far as it
+// pays: a frame that takes as long at any scale stays at full resolution.
+class OVFrameScheduler
+{
+public:
+    // Delay after the last input before the full-quality frame
+    static const int SettleMilliseconds = 150;
+    // Smallest fraction of the window size drawn while interacting
+    static const double MinScale;
+    // Smallest fraction of the full frame time a reduced frame must save
+    static const double MinSaving;
+
+    OVFrameScheduler();
+
+    void setFrameInterval(double milliseconds) { _frameInterval = milliseconds; }
+    double getFrameInterval() const { return _frameInterval; }
+
+    // The view changed; isInteractive for mouse drags and wheel ticks
+    void invalidate(bool isInteractive);
+
+    // Called once per tick: returns true if a frame is due, and the scale of
+    // the window size to draw it at
+    bool nextFrame(double& scale);
+
+    // Time a frame drawn at scale took, possibly reported some frames late
+    void frameDone(double milliseconds, double scale);
+
+    // Nothing is pending, so the timer can stop
+    bool isIdle() const { return !_isDirty && !_needsFullFrame; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    double interactiveScale() const;
+    // Fixed and per-pixel milliseconds, a full frame costing their sum
+    void estimateCost(double& fixedCost, double& pixelCost) const;
+
+    double            _frameInterval;
+    bool              _isDirty;
+    bool              _needsFullFrame;
+    Clock::time_point _lastInput;
+    double            _fullFrameTime;       // Milliseconds at full resolution, 0 until measured
+    double            _reducedFrameTime;    // Milliseconds at reduced resolution
+    double            _reducedPixels;       // Their fraction of the full pixel count, 0 until measured
+};
+
+} // namespace ov
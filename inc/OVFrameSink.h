@@ -0,0 +1,88 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include "OVFrameArchive.h"
+#include "OVFrameEncoder.h"
+#include "OVFramePipeline.h"
+#include "OVRenderer.h"
+
+namespace ov
+{
+
+enum FRAME_CONTAINER
+{
+    CONTAINER_FILES,    // One file per frame and auxiliary image
+    CONTAINER_ARCHIVE,  // One frames.ovf per output directory (see OVFrameArchive)
+    CONTAINER_VIDEO,    // One video per output directory, auxiliary images as files
+    CONTAINER_RING,     // A shared-memory ring read by another process (see ov_frame_ring.h)
+    CONTAINER_COUNT,
+};
+
+struct VideoSettings
+{
+    std::string codec;      // ffv1 (lossless), mjpg, mp4v or avc1 (H.264)
+    double      fps;
+    int         quality;    // 0-100 where the codec has one, -1 for its default
+};
+
+struct RingSettings
+{
+    std::string name;       // Of the shared memory, without a leading slash
+    int         numSlots;   // Frames the consumer can hold before generation waits
+};
+
+// What every frame written to a sink has
+struct FrameLayout
+{
+    cv::Size size;
+    int      auxOutputs;    // AUX_OUTPUT flags
+    Mat3     cameraMatrix;  // Intrinsics of the frames, in pixels
+    bool     isCropped;     // Whether frames cover only their crop
+};
+
+// Where the frames of an output directory go. Sinks are written from the
+// encoding threads, in the order frames finish; the video sink puts them
+// back in frame order. Archives and rings keep the crops of cropped
+// frames with them; next to files, the manifest lists them, and videos
+// cannot hold them.
+class OVFrameSink
+{
+public:
+    // encoder writes the images of files and archives, and outlives the sink
+    static OVFrameSink* Create(FRAME_CONTAINER container, const OVFrameEncoder* encoder, const VideoSettings& video,
+                               const RingSettings& ring);
+    static bool ParseContainer(const std::string& name, FRAME_CONTAINER& container);
+    static const char* GetContainerName(FRAME_CONTAINER container);
+    static bool IsValidVideoCodec(const std::string& codec);
+    // The archive entries of AUX_OUTPUT flags, and the suffix of their files
+    static void GetAuxEntries(int auxOutputs, std::vector<ARCHIVE_ENTRY>& types);
+    static const char* GetAuxFileSuffix(ARCHIVE_ENTRY type);
+
+    virtual ~OVFrameSink() {}
+
+    FRAME_CONTAINER getContainer() const { return _container; }
+
+    // Frames of layout into outputDir, which ends with a separator
+    virtual bool open(const std::string& outputDir, const FrameLayout& layout) = 0;
+    // Finish writing; false if anything written was lost
+    virtual bool close() = 0;
+    // Stop waiting on a reader, after a stop
+    virtual void cancel() {}
+
+    // The frame's image; numBytes receives the size of the encoded image,
+    // 0 in a video or ring
+    virtual bool writeImage(const PipelineFrame& frame, size_t& numBytes) = 0;
+    virtual bool writeAuxImages(const PipelineFrame& frame) = 0;
+
+    const std::string& getError() const { return _err; }
+
+protected:
+    OVFrameSink(FRAME_CONTAINER container) : _container(container) {}
+
+    FRAME_CONTAINER _container;
+    std::string     _err;
+};
+
+} // namespace ov
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace ov
+{
+
+enum FRAME_PHASE
+{
+    PHASE_BACKGROUND,
+    PHASE_FOREGROUND,
+    PHASE_SWAP,
+    PHASE_COUNT,
+};
+
+struct FrameRecord
+{
+    int    frameIndex;
+    double totalMs;                 // CPU time from beginFrame to endFrame
+    double cpuMs[PHASE_COUNT];
+    double gpuMs[PHASE_COUNT];      // -1 until a timer query reports it, or if unsupported
+    int    triangleCount;
+    int    drawCallCount;
+    int    stateChangeCount;
+};
+
+// Per-frame timings of the render phases. The last WindowSize frames feed
+// the rolling percentiles; the whole session is kept for the CSV export.
+class OVFrameStats
+{
+public:
+    static const int WindowSize = 300;
+
+    OVFrameStats();
+
+    void setEnabled(bool isEnabled) { _isEnabled = isEnabled; }
+    bool isEnabled() const { return _isEnabled; }
+    void clear();
+
+    void beginFrame();
+    void beginPhase(int phase);
+    void endPhase(int phase);
+    void endFrame(int triangleCount, int drawCallCount, int stateChangeCount);
+    // GPU times arrive a few frames late
+    void setGpuTime(int frameIndex, int phase, double milliseconds);
+
+    int getFrameIndex() const { return _frameIndex; }
+    int getFrameCount() const { return (int)_records.size(); }
+    const FrameRecord* getLastFrame() const { return _records.empty() ? NULL : &_records.back(); }
+
+    // p in [0, 100] over the rolling window; phase PHASE_COUNT is the frame total
+    double getPercentile(int phase, double p, bool isGpu = false) const;
+    // One line per row: total and phases with p50/p95/p99, then the counts
+    std::vector<std::string> getSummary() const;
+    bool writeCsv(const std::string& filename) const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    static double Milliseconds(Clock::time_point start, Clock::time_point end);
+
+    bool                    _isEnabled;
+    int                     _frameIndex;
+    Clock::time_point       _frameStart;
+    Clock::time_point       _phaseStart[PHASE_COUNT];
+    FrameRecord             _current;
+    std::deque<FrameRecord> _records;
+};
+
+} // namespace ov
@@ -0,0 +1,220 @@
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <GL/gl.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Types and tokens beyond OpenGL 1.1, which is all <GL/gl.h> declares on Windows
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+#ifndef APIENTRYP
+#define APIENTRYP APIENTRY *
+#endif
+
+#ifndef GL_VERSION_1_5
+typedef ptrdiff_t GLsizeiptr;
+typedef ptrdiff_t GLintptr;
+#endif
+
+#ifndef GL_VERSION_2_0
+typedef char GLchar;
+#endif
+
+#ifndef GL_VERSION_3_2
+typedef int64_t  GLint64;
+typedef uint64_t GLuint64;
+#endif
+
+#ifndef GL_BGR
+#define GL_BGR                              0x80E0
+#endif
+#ifndef GL_BGRA
+#define GL_BGRA                             0x80E1
+#endif
+#ifndef GL_FRAMEBUFFER
+#define GL_FRAMEBUFFER                      0x8D40
+#define GL_READ_FRAMEBUFFER                 0x8CA8
+#define GL_DRAW_FRAMEBUFFER                 0x8CA9
+#define GL_RENDERBUFFER                     0x8D41
+#define GL_COLOR_ATTACHMENT0                0x8CE0
+#define GL_DEPTH_ATTACHMENT                 0x8D00
+#define GL_FRAMEBUFFER_COMPLETE             0x8CD5
+#endif
+#ifndef GL_FRAMEBUFFER_BINDING
+#define GL_FRAMEBUFFER_BINDING              0x8CA6
+#endif
+#ifndef GL_DEPTH_COMPONENT24
+#define GL_DEPTH_COMPONENT24                0x81A6
+#endif
+#ifndef GL_DEPTH_COMPONENT32F
+#define GL_DEPTH_COMPONENT32F               0x8CAC
+#endif
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER                0x88EB
+#define GL_PIXEL_UNPACK_BUFFER              0x88EC
+#endif
+#ifndef GL_TIMESTAMP
+#define GL_TIMESTAMP                        0x8E28
+#endif
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT                     0x8866
+#define GL_QUERY_RESULT_AVAILABLE           0x8867
+#endif
+#ifndef GL_VERTEX_SHADER
+#define GL_FRAGMENT_SHADER                  0x8B30
+#define GL_VERTEX_SHADER                    0x8B31
+#define GL_COMPILE_STATUS                   0x8B81
+#define GL_LINK_STATUS                      0x8B82
+#define GL_INFO_LOG_LENGTH                  0x8B84
+#endif
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER                     0x8892
+#define GL_ELEMENT_ARRAY_BUFFER             0x8893
+#define GL_STATIC_DRAW                      0x88E4
+#define GL_DYNAMIC_DRAW                     0x88E8
+#endif
+#ifndef GL_UNIFORM_BUFFER
+#define GL_UNIFORM_BUFFER                   0x8A11
+#define GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT  0x8A34
+#endif
+#ifndef GL_TEXTURE0
+#define GL_TEXTURE0                         0x84C0
+#endif
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE                    0x812F
+#endif
+#ifndef GL_TEXTURE_MAX_LEVEL
+#define GL_TEXTURE_MAX_LEVEL                0x813D
+#endif
+#ifndef GL_MAJOR_VERSION
+#define GL_MAJOR_VERSION                    0x821B
+#define GL_MINOR_VERSION                    0x821C
+#endif
+#ifndef GL_NUM_EXTENSIONS
+#define GL_NUM_EXTENSIONS                   0x821D
+#endif
+#ifndef GL_CLIP_DISTANCE0
+#define GL_CLIP_DISTANCE0                   0x3000
+#endif
+#ifndef GL_MAX_RENDERBUFFER_SIZE
+#define GL_MAX_RENDERBUFFER_SIZE            0x84E8
+#endif
+#ifndef GL_COLOR_ATTACHMENT1
+#define GL_COLOR_ATTACHMENT1                0x8CE1
+#define GL_COLOR_ATTACHMENT2                0x8CE2
+#endif
+#ifndef GL_RG16UI
+#define GL_RG16UI                           0x823A
+#define GL_RG_INTEGER                       0x8228
+#endif
+#ifndef GL_RGBA32F
+#define GL_RGBA32F                          0x8814
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ                      0x88E1
+#define GL_STREAM_DRAW                      0x88E0
+#define GL_READ_ONLY                        0x88B8
+#define GL_WRITE_ONLY                       0x88B9
+#endif
+
+namespace ov
+{
+
+// OpenGL entry points loaded at run time. A NULL pointer means the function
+// is not supported by the current context.
+#define OV_GL_FUNCTIONS(X) \
+    X(void,   GenFramebuffers,         (GLsizei n, GLuint* framebuffers)) \
+    X(void,   DeleteFramebuffers,      (GLsizei n, const GLuint* framebuffers)) \
+    X(void,   BindFramebuffer,         (GLenum target, GLuint framebuffer)) \
+    X(GLenum, CheckFramebufferStatus,  (GLenum target)) \
+    X(void,   FramebufferRenderbuffer, (GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer)) \
+    X(void,   GenRenderbuffers,        (GLsizei n, GLuint* renderbuffers)) \
+    X(void,   DeleteRenderbuffers,     (GLsizei n, const GLuint* renderbuffers)) \
+    X(void,   BindRenderbuffer,        (GLenum target, GLuint renderbuffer)) \
+    X(void,   RenderbufferStorage,     (GLenum target, GLenum internalformat, GLsizei width, GLsizei height)) \
+    X(void,   BlitFramebuffer,         (GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, \
+                                        GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, \
+                                        GLbitfield mask, GLenum filter)) \
+    X(void,   GenBuffers,              (GLsizei n, GLuint* buffers)) \
+    X(void,   DeleteBuffers,           (GLsizei n, const GLuint* buffers)) \
+    X(void,   BindBuffer,              (GLenum target, GLuint buffer)) \
+    X(void,   BufferData,              (GLenum target, GLsizeiptr size, const void* data, GLenum usage)) \
+    X(void*,  MapBuffer,               (GLenum target, GLenum access)) \
+    X(GLboolean, UnmapBuffer,          (GLenum target)) \
+    X(void,   GenQueries,              (GLsizei n, GLuint* ids)) \
+    X(void,   DeleteQueries,           (GLsizei n, const GLuint* ids)) \
+    X(void,   QueryCounter,            (GLuint id, GLenum target)) \
+    X(void,   GetQueryObjectiv,        (GLuint id, GLenum pname, GLint* params)) \
+    X(void,   GetQueryObjectui64v,     (GLuint id, GLenum pname, GLuint64* params)) \
+    X(void,   BufferSubData,           (GLenum target, GLintptr offset, GLsizeiptr size, const void* data)) \
+    X(void,   BindBufferRange,         (GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)) \
+    X(void,   GenVertexArrays,         (GLsizei n, GLuint* arrays)) \
+    X(void,   DeleteVertexArrays,      (GLsizei n, const GLuint* arrays)) \
+    X(void,   BindVertexArray,         (GLuint array)) \
+    X(void,   EnableVertexAttribArray, (GLuint index)) \
+    X(void,   VertexAttribPointer,     (GLuint index, GLint size, GLenum type, GLboolean normalized, \
+                                        GLsizei stride, const void* pointer)) \
+    X(GLuint, CreateShader,            (GLenum type)) \
+    X(void,   DeleteShader,            (GLuint shader)) \
+    X(void,   ShaderSource,            (GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length)) \
+    X(void,   CompileShader,           (GLuint shader)) \
+    X(void,   GetShaderiv,             (GLuint shader, GLenum pname, GLint* params)) \
+    X(void,   GetShaderInfoLog,        (GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog)) \
+    X(GLuint, CreateProgram,           ()) \
+    X(void,   DeleteProgram,           (GLuint program)) \
+    X(void,   AttachShader,            (GLuint program, GLuint shader)) \
+    X(void,   LinkProgram,             (GLuint program)) \
+    X(void,   GetProgramiv,            (GLuint program, GLenum pname, GLint* params)) \
+    X(void,   GetProgramInfoLog,       (GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog)) \
+    X(void,   UseProgram,              (GLuint program)) \
+    X(GLuint, GetUniformBlockIndex,    (GLuint program, const GLchar* uniformBlockName)) \
+    X(void,   UniformBlockBinding,     (GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding)) \
+    X(GLint,  GetUniformLocation,      (GLuint program, const GLchar* name)) \
+    X(void,   Uniform1i,               (GLint location, GLint v0)) \
+    X(void,   Uniform4f,               (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)) \
+    X(void,   ActiveTexture,           (GLenum texture)) \
+    X(void,   GenerateMipmap,          (GLenum target)) \
+    X(void,   DrawElementsInstanced,   (GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount)) \
+    X(void,   VertexAttribIPointer,    (GLuint index, GLint size, GLenum type, GLsizei stride, const void* pointer)) \
+    X(void,   DrawBuffers,             (GLsizei n, const GLenum* bufs)) \
+    X(void,   ClearBufferuiv,          (GLenum buffer, GLint drawbuffer, const GLuint* value)) \
+    X(void,   ClearBufferfv,           (GLenum buffer, GLint drawbuffer, const GLfloat* value)) \
+    X(const GLubyte*, GetStringi,      (GLenum name, GLuint index))
+
+namespace gl
+{
+
+#define OV_GL_DECLARE(ret, name, args) \
+    typedef ret (APIENTRYP name##Proc) args; \
+    extern name##Proc name;
+OV_GL_FUNCTIONS(OV_GL_DECLARE)
+#undef OV_GL_DECLARE
+
+// Features of the context the entry points were loaded from, by its version
+// and extension string. Some window systems return a pointer for any name,
+// so a loaded entry point alone does not mean the context supports it.
+extern bool HasPixelBuffers;    // OpenGL 2.1 or ARB_pixel_buffer_object
+extern bool HasTimerQueries;    // OpenGL 3.3 or ARB_timer_query
+
+} // namespace gl
+
+typedef void* (*GLProcAddressFn)(const char* name);
+
+// Look up an entry point of the context current on this thread through the
+// platform window system (WGL, GLX or EGL)
+void*
+GetGLProcAddress(const char* name);
+
+// Load every entry point in OV_GL_FUNCTIONS and the features of the context
+// current on this thread. Returns false if any of them is missing; the
+// available ones are loaded regardless.
+bool
+LoadGLFunctions(GLProcAddressFn getProcAddress);
+
+} // namespace ov
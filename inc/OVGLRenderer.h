@@ -0,0 +1,63 @@
+#pragma once
+
+#include "OVBackgroundTexture.h"
+#include "OVGL.h"
+#include "OVGLTimer.h"
+#include "OVRenderContext.h"
+#include "OVRenderer.h"
+
+namespace ov
+{
+
+// The fixed-function OpenGL renderer. Draws into whatever context is
+// current, so the caller makes the target context current beforehand.
+class OVGLRenderer : public OVRenderer
+{
+public:
+    OVGLRenderer(OVRenderContext* context);
+    ~OVGLRenderer();
+
+    // Pixel pack buffers cycled by the asynchronous readback
+    static const int ReadbackRingSize = 3;
+
+    bool init();
+    void release();
+    void render();
+    void readPixels(cv::Mat& image);
+    void queueReadPixels();
+    bool collectPixels(cv::Mat& image);
+    int getReadbackQueueSize() const;
+    int getQueuedReadbackCount() const;
+    // Draw a BGR image with its top left corner at (x, y) pixels of the viewport
+    virtual void drawOverlay(const cv::Mat& image, int x, int y);
+
+protected:
+    bool loadTextures(std::vector<tinyobj::material_t>& materials,
+                      std::unordered_map<std::string, unsigned int>& textureIds,
+                      const std::string& dir);
+    void releaseTextures(const std::unordered_map<std::string, unsigned int>& textureIds);
+    void uploadBackground();
+
+    void setupLights();
+    void drawBackground(GLuint backgroundImageTextureId);
+    void drawForeground(const OVDrawList& drawList,
+                        const std::vector<tinyobj::material_t>& materials);
+    bool hasPixelBuffers() const;
+
+    struct Readback
+    {
+        GLuint     buffer;
+        GLsizeiptr size;
+        int        width;
+        int        height;
+    };
+
+    OVRenderContext*    _context;
+    OVBackgroundTexture _background;
+    OVGLTimer           _gpuTimer;
+    Readback            _readbacks[ReadbackRingSize];
+    int                 _readbackHead;     // Oldest queued readback
+    int                 _readbackCount;
+};
+
+} // namespace ov
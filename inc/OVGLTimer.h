@@ -0,0 +1,50 @@
+#pragma once
+
+#include "OVFrameStats.h"
+#include "OVGL.h"
+
+namespace ov
+{
+
+// GPU time of the render phases from GL_TIMESTAMP queries. Results are read
+// Latency frames later so that the CPU never waits for the GPU.
+class OVGLTimer
+{
+public:
+    static const int Latency = 4;
+
+    OVGLTimer();
+
+    // Requires OpenGL 3.3 or ARB_timer_query
+    bool isSupported() const;
+    // Delete the queries; the context that created them must be current
+    void release();
+
+    // Mark the start of a phase; the next mark or endFrame ends it
+    void beginFrame(int frameIndex);
+    void beginPhase(int phase);
+    void endFrame();
+
+    // Hand the finished frames to stats, waiting for them if isWaiting
+    void collect(OVFrameStats& stats, bool isWaiting = false);
+    // Time of the oldest finished frame from its first mark to endFrame;
+    // false while none is finished
+    bool collectFrame(int& frameIndex, double& milliseconds);
+
+private:
+    struct Slot
+    {
+        int    frameIndex;
+        int    markCount;
+        int    phases[PHASE_COUNT];
+        GLuint queries[PHASE_COUNT + 1];
+        bool   isPending;
+    };
+
+    Slot _slots[Latency];
+    int  _current;      // Slot of the frame being recorded, -1 between frames
+    int  _next;         // Slot the next frame records into
+    bool _hasQueries;
+};
+
+} // namespace ov
@@ -0,0 +1,28 @@
+#pragma once
+
+namespace ov
+{
+
+// Batch generation from the command line, without creating any window or
+// initializing the GUI toolkit, so it also runs on machines with no display:
+//
+//   objviewer --batch <file> [--threads <n>] [--renderer gl|shader|software]
+//             [--poses-per-pass <n>] [--workers <n>]
+//   objviewer --benchmark-encoders <image>
+//   objviewer --convert-poses <file> --output <file> [--precision float64|float32]
+//
+// The OpenGL renderers draw into an offscreen context (OVOffscreenContext).
+// With --workers the batch is sharded over that many copies of the program,
+// started as "objviewer --serve-shards <file>" (see OVBatchCoordinator).
+// Progress and errors go to stderr. The encoder benchmark prints the frame
+// size and encoding speed of every output format for the given image, and
+// the conversion writes a poses file in the binary format of OVPoseSource.
+// The exit code is 0 on success, 1 if generation failed and 2 for invalid
+// arguments.
+bool
+IsHeadlessCommand(int argc, char** argv);
+
+int
+RunHeadless(int argc, char** argv);
+
+} // namespace ov
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+
+namespace ov
+{
+
+// A read-only view of a whole file through the virtual memory system, so
+// large files are paged in as they are read instead of loaded up front
+class OVMappedFile
+{
+public:
+    OVMappedFile();
+    ~OVMappedFile();
+
+    // isSequential hints that the file is read front to back
+    bool open(const std::string& fileName, bool isSequential);
+    void close();
+
+    bool isOpen() const { return _isOpen; }
+    // NULL for an empty file
+    const char* getData() const { return _data; }
+    size_t getSize() const { return _size; }
+
+private:
+    OVMappedFile(const OVMappedFile&);
+    OVMappedFile& operator=(const OVMappedFile&);
+
+    const char* _data;
+    size_t      _size;
+    bool        _isOpen;
+#ifdef _WIN32
+    void*       _file;
+    void*       _mapping;
+#endif
+};
+
+} // namespace ov
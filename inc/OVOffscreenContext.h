@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "OVRenderContext.h"
+
+namespace ov
+{
+
+enum OFFSCREEN_BACKEND
+{
+    OFFSCREEN_AUTO,
+    OFFSCREEN_OSMESA,   // Mesa software rendering into client memory
+    OFFSCREEN_EGL,      // EGL surfaceless context rendering into a framebuffer object
+};
+
+// A windowless OpenGL context for rendering without a display. Mesa selects
+// llvmpipe for both backends when no GPU is present (or with
+// LIBGL_ALWAYS_SOFTWARE=1). Backends are compiled in with OV_USE_OSMESA and
+// OV_USE_EGL.
+class OVOffscreenContext : public OVRenderContext
+{
+public:
+    OVOffscreenContext();
+    ~OVOffscreenContext();
+
+    // Request an OpenGL 3.3 core profile from the next create, for OVShaderRenderer
+    void setCoreProfile(bool isCoreProfile) { _isCoreProfile = isCoreProfile; }
+    bool create(int backend, int width, int height, std::string& err);
+    void destroy();
+    bool isValid() const { return _backend != OFFSCREEN_AUTO; }
+
+    bool makeCurrent();
+    void swapBuffers();
+    bool resize(int width, int height);
+    int getWidth() const { return _width; }
+    int getHeight() const { return _height; }
+    GLProcAddressFn getProcAddressFn() const;
+
+private:
+    bool createOSMesa(std::string& err);
+    bool createEGL(std::string& err);
+    bool createFramebuffer();
+    void destroyFramebuffer();
+
+    int  _backend;
+    bool _isCoreProfile;
+    int  _width;
+    int  _height;
+
+    // OSMesa
+    void*                _osmesaContext;
+    std::vector<GLubyte> _osmesaBuffer;
+
+    // EGL
+    void*                _eglDisplay;
+    void*                _eglContext;
+    GLuint               _framebuffer;
+    GLuint               _colorRenderbuffer;
+    GLuint               _depthRenderbuffer;
+};
+
+} // namespace ov
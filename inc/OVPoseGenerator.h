@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include "OVPoseSource.h"
+
+namespace ov
+{
+
+// Poses computed on demand from a description given in place of a poses
+// file, so dense view samplings and camera paths need no file at all:
+//
+//   <kind>:<key>=<value>,<key>=<value>...     Vectors are written x/y/z
+//
+//   fibonacci:count=<n>,radius=<r>[/<r>...]
+//       n views per radius spread evenly over the sphere by the golden angle
+//   icosphere:subdivisions=<k>,radius=<r>[/<r>...]
+//       The 10 * 4^k + 2 vertices of an icosahedron with its edges split
+//       into 2^k parts, per radius
+//   random:count=<n>,radius=<min>[/<max>],seed=<s>,jitter=<deg>,roll=<deg>
+//       Views from uniform points of the shell between the radii, turned
+//       off the target by up to jitter and about the view axis by up to roll
+//   keyframes:file=<poses file>,count=<n>,interpolation=slerp|spline
+//       n poses along the keyframes of a poses file, with linear camera
+//       centres and slerp, or Catmull-Rom centres and squad
+//
+// The view kinds look at target=x/y/z (0/0/0) from the camera frame used by
+// the renderer (x right, y down, z forward), with up=x/y/z (0/1/0) upwards
+// in the image. Pose i is computed from i alone, so seeking is direct.
+class OVPoseGenerator : public OVPoseSource
+{
+public:
+    // Whether text is a description rather than a file name
+    static bool IsDescription(const std::string& text);
+    // NULL with err set for an invalid description
+    static OVPoseGenerator* Create(const std::string& description, std::string& err);
+
+    bool seek(long long index);
+    bool next(Pose& pose);
+
+protected:
+    virtual void generate(long long index, Pose& pose) const = 0;
+};
+
+} // namespace ov
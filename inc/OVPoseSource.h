@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include "OVCommon.h"
+#include "OVRenderer.h"
+
+namespace ov
+{
+
+// Binary pose file: this header, then count poses of valuesPerPose
+// little-endian values each, in the order of a row of a text poses file
+// (R column by column, then t)
+struct PoseFileHeader
+{
+    char     magic[8];          // "OVPOSES1"
+    uint32_t valueSize;         // 8 for float64, 4 for float32
+    uint32_t valuesPerPose;     // 12
+    uint64_t count;
+    uint64_t reserved;
+};
+
+// The poses of a batch job, read as frames render instead of loaded up
+// front. Both kinds of poses file are memory-mapped: a text file, with 12
+// values per line, is parsed one line per pose; a binary file is read in
+// place, so any pose is reached directly. Only the pose count of a text
+// file needs a pass over it at open, which scans for line ends and parses
+// nothing.
+class OVPoseSource
+{
+public:
+    static const int ValuesPerPose = 12;
+
+    // Generated if fileName is an OVPoseGenerator description, binary if the
+    // file starts with PoseFileHeader's magic, text otherwise; NULL with err
+    // set if it cannot be opened
+    static OVPoseSource* Open(const std::string& fileName, std::string& err);
+    // Write the remaining poses of source to a binary file
+    static bool WriteBinary(const std::string& fileName, OVPoseSource& source, bool isSinglePrecision,
+                            std::string& err);
+
+    virtual ~OVPoseSource() {}
+
+    long long getCount() const { return _count; }
+    // Index of the pose the next call to next() returns
+    long long getPosition() const { return _position; }
+    // Binary files move there directly, text files scan lines from the
+    // current pose, or from the start when moving back
+    virtual bool seek(long long index) = 0;
+    // False past the last pose, or with getError set for a malformed one
+    virtual bool next(Pose& pose) = 0;
+
+    const std::string& getError() const { return _err; }
+
+protected:
+    OVPoseSource() : _count(0), _position(0) {}
+
+    long long   _count;
+    long long   _position;
+    std::string _err;
+};
+
+} // namespace ov
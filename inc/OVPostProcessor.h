@@ -0,0 +1,46 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+namespace ov
+{
+
+class OVThreadPool;
+
+// Gaussian blur and additive Gaussian noise of the rendered frames in one
+// pass. Bands of rows run in parallel; within a band every source row is
+// blurred horizontally once into a small ring of float rows, which the
+// vertical pass, the noise and the rounding read while it is still in
+// cache. Noise comes from a counter-based generator (SplitMix64) seeded by
+// the seed, stream and frame and counted by sample, so a frame is
+// bit-identical however many threads or bands produce it. Noise is added
+// before rounding, and only the sum is clamped to [0, 255].
+class OVPostProcessor
+{
+public:
+    OVPostProcessor();
+
+    // Sigma in pixels, 0 for none
+    void setBlur(double sigma);
+    // Standard deviation in intensity levels, 0 for none
+    void setNoise(double sigma, unsigned int seed, unsigned int stream);
+
+    bool isActive() const { return _radius > 0 || _noiseSigma > 0; }
+
+    // Blur and noise a CV_8UC3 image into dst, which must not share src's data.
+    // Safe to call from several threads at once.
+    void apply(const cv::Mat& src, cv::Mat& dst, unsigned int frameIndex, OVThreadPool& pool) const;
+
+private:
+    void applyBand(const cv::Mat& src, cv::Mat& dst, unsigned int frameIndex, int firstRow, int lastRow) const;
+    void blurRow(const unsigned char* src, int width, float* padded, float* out) const;
+    void generateNoise(unsigned int frameIndex, unsigned long long first, int count, float* out) const;
+
+    std::vector<float> _kernel;     // 2 * _radius + 1 weights
+    int                _radius;
+    float              _noiseSigma;
+    unsigned int       _key[2];
+};
+
+} // namespace ov
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "OVGL.h"
+
+namespace ov
+{
+
+// A drawable with an OpenGL context that a renderer can draw into: the
+// wxGLCanvas window or an offscreen framebuffer
+class OVRenderContext
+{
+public:
+    virtual ~OVRenderContext() {}
+
+    virtual bool makeCurrent() = 0;
+    virtual void swapBuffers() = 0;
+
+    // Make the drawable hold a frame of the given size
+    virtual bool resize(int width, int height) = 0;
+    virtual int getWidth() const = 0;
+    virtual int getHeight() const = 0;
+
+    // Entry point lookup for LoadGLFunctions
+    virtual GLProcAddressFn getProcAddressFn() const { return GetGLProcAddress; }
+};
+
+} // namespace ov
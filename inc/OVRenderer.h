@@ -0,0 +1,193 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "OVCommon.h"
+#include "OVDrawList.h"
+#include "OVFrameStats.h"
+#include "TinyObjLoader.h"
+
+namespace ov
+{
+
+enum RENDER_MODE
+{
+    RENDER_SOLID,
+    RENDER_WIREFRAME,
+};
+
+// Per-pixel outputs besides the color image
+enum AUX_OUTPUT
+{
+    AUX_DEPTH   = 1,
+    AUX_IDS     = 2,
+    AUX_NORMALS = 4,
+};
+
+// Auxiliary images of a frame, top row first like the color image
+struct AuxImages
+{
+    cv::Mat depth;          // CV_32F distance along the optical axis, 0 where empty
+    cv::Mat shapeIds;       // CV_16U shape index + 1, 0 where empty
+    cv::Mat materialIds;    // CV_16U material index + 1, 0 for the default material or where empty
+    cv::Mat normals;        // CV_32FC3 camera-space unit normals (x, y, z), 0 where empty
+};
+
+// A camera pose: x_camera = R * x_model + t
+struct Pose
+{
+    Mat3 R;
+    Vec3 t;
+};
+
+// The render core shared by the viewer window and the batch generator. It
+// owns the scene (model, background image, camera and pose) and draws it
+// without knowing whether the target is a window or an offscreen buffer.
+class OVRenderer
+{
+public:
+    OVRenderer();
+    virtual ~OVRenderer();
+
+    static int FrameWidth;
+    static int FrameHeight;
+    static double PlaneNear;
+    static double PlaneFar;
+
+    // Must be called once with the target context current
+    virtual bool init() = 0;
+    // Delete the GPU objects, with the target context still current. Called
+    // once before the renderer is destroyed.
+    virtual void release() {}
+
+    bool setForegroundObject(const std::string& filename, bool isUnitization);
+    bool setBackgroundImage(const std::string& filename);
+    bool setBackgroundImage(const cv::Mat& image);
+    bool readCameraParameters(const std::string& camParamFile);
+    // Image size a camera parameter file was calibrated for
+    static bool ReadCameraImageSize(const std::string& camParamFile, int& width, int& height);
+    void resetMatrix();
+
+    void setPose(const Mat3& R, const Vec3& t) { _R = R; _t = t; }
+    void getPose(Mat3& R, Vec3& t) const { R = _R; t = _t; }
+    void setRenderMode(int renderMode) { _renderMode = renderMode; }
+    int getRenderMode() const { return _renderMode; }
+    void setLightingOn(bool lightingOn) { _lightingOn = lightingOn; }
+    bool getLightingOn() const { return _lightingOn; }
+    void setOffsetPose(const Vec3& r, const Vec3& t, const double s);
+    void getOffsetPose(Vec3& r, Vec3& t, double& s) const;
+    const DrawListStats& getDrawListStats() const { return _drawList.stats(); }
+    // Phase timings are recorded into stats while it is enabled; NULL for none
+    void setFrameStats(OVFrameStats* stats) { _frameStats = stats; }
+    // Column-major OpenGL matrices; the model-view includes the offset pose
+    Mat4 getModelViewMatrix() const;
+    Mat4 getProjectionMatrix() const { return Eigen::Map<const Mat4>(_projectionMatrix); }
+    // Pinhole intrinsics the projection was set from, in pixels
+    const Mat3& getCameraMatrix() const { return _cameraMatrix; }
+    // Maps a model point to (x w, y w, w) through the current pose, with
+    // (x, y) its position in the viewport, top left corner at 0, 0, and w
+    // its distance along the optical axis
+    Mat34 getImageProjection() const;
+    // Vertex positions of the model's shapes, as loaded
+    const Mat3Xf& getModelVertices() const { return _modelVertices; }
+
+    // Size of the area the frame is rendered to
+    virtual void setViewport(int width, int height);
+    // Render the background and the model with the current pose
+    virtual void render() = 0;
+    // Read back the last rendered frame as a BGR image
+    virtual void readPixels(cv::Mat& image) = 0;
+
+    // Region readback: readPixels, queueReadPixels and readAuxPixels read
+    // only region of the frame, in image coordinates with the top row first;
+    // an empty region is the whole frame. Multi-pose passes read whole frames.
+    void setReadRegion(const cv::Rect& region) { _readRegion = region; }
+    // The region read back, within the viewport
+    cv::Rect getReadRegion() const;
+    // The model's bounding box projected through the current pose and the
+    // projection, grown by margin pixels and clipped to the viewport; the
+    // whole viewport when the box reaches behind the near plane or is out
+    // of view
+    cv::Rect getModelRegion(int margin) const;
+
+    // Asynchronous readback: queueReadPixels starts reading the last rendered
+    // frame, and collectPixels copies the oldest queued frame into image,
+    // waiting for it if needed. Up to getReadbackQueueSize() frames can be
+    // in flight. The default implementation reads synchronously.
+    virtual void queueReadPixels();
+    virtual bool collectPixels(cv::Mat& image);
+    virtual int getReadbackQueueSize() const { return 1; }
+    virtual int getQueuedReadbackCount() const { return (int)_readbackQueue.size(); }
+
+    // Multi-pose rendering: render every pose of the same scene and read each
+    // frame back into images. Renderers that return more than 1 from
+    // getMaxPosesPerPass draw up to that many poses in one pass; the default
+    // implementation renders them one after another. The current pose is kept.
+    virtual int getMaxPosesPerPass() const { return 1; }
+    virtual void renderPoses(const std::vector<Pose>& poses, std::vector<cv::Mat>& images);
+
+    // Auxiliary outputs: render() also produces the AUX_OUTPUT images set
+    // here, out of those in getSupportedAuxOutputs(), and readAuxPixels
+    // reads them for the last rendered frame
+    virtual int getSupportedAuxOutputs() const { return 0; }
+    void setAuxOutputs(int outputs) { _auxOutputs = outputs & getSupportedAuxOutputs(); }
+    int getAuxOutputs() const { return _auxOutputs; }
+    virtual bool readAuxPixels(AuxImages&) { return false; }
+
+protected:
+    // Create the renderer's textures for the diffuse maps of the materials
+    // and fill textureIds with handles that the draw list refers to
+    virtual bool loadTextures(std::vector<tinyobj::material_t>& materials,
+                              std::unordered_map<std::string, unsigned int>& textureIds,
+                              const std::string& dir) = 0;
+    virtual void releaseTextures(const std::unordered_map<std::string, unsigned int>& textureIds) = 0;
+    virtual void uploadBackground() = 0;
+    // Called after the draw list is rebuilt for a new model
+    virtual void drawListChanged() {}
+
+    void setProjection(double fx, double fy, double cx, double cy, double w, double h);
+    // Window depth in [0, 1] to the distance along the optical axis, 0 for the far plane
+    void linearizeDepth(cv::Mat& depth) const;
+    void unitize(std::vector<tinyobj::shape_t>& shapes);
+
+    // Foreground objects
+    std::vector<tinyobj::shape_t>                 _shapes;
+    std::vector<tinyobj::material_t>              _materials;
+    std::unordered_map<std::string, unsigned int> _textureIds;
+    OVDrawList                                    _drawList;
+    Mat3Xf                                        _modelVertices;
+    Vec3                                          _modelMin;   // Bounding box of the shapes
+    Vec3                                          _modelMax;
+
+    // Background image
+    cv::Mat _backgroundImage;
+
+    OVFrameStats* _frameStats;
+    int           _auxOutputs;
+
+    // Frames queued by the default queueReadPixels
+    std::deque<cv::Mat> _readbackQueue;
+
+    // Selections
+    int  _renderMode;
+    bool _lightingOn;
+
+    // Offset transformation coefficients
+    Vec3   _offsetRotation;
+    Vec3   _offsetTranslation;
+    double _offsetScale;
+
+    // For rendering
+    double _projectionMatrix[16];
+    Mat3   _cameraMatrix;
+    Mat3   _R;
+    Vec3   _t;
+    int    _viewportWidth;
+    int    _viewportHeight;
+    cv::Rect _readRegion;
+};
+
+} // namespace ov
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <string>
+#include "OVGLRenderer.h"
+
+namespace ov
+{
+
+// An OpenGL 3.3 core-profile version of OVGLRenderer. The fixed-function
+// lighting runs per vertex in GLSL; the frame state and the materials live
+// in uniform buffers, so a material switch only rebinds a range of the
+// material buffer. Lit, unlit and textured variants are compiled from one
+// source with preprocessor defines. Readback and timing are inherited.
+//
+// Several poses can be drawn in one pass: the frames are laid out as tiles
+// of an offscreen atlas, and one instanced draw per batch places every
+// instance in its tile with its own model-view matrix and clips it with
+// user clip planes. The atlas is read back once and split into frames.
+//
+// Depth, shape and material indices and normals are written in the same
+// pass as the color, into extra render targets of an offscreen framebuffer.
+class OVShaderRenderer : public OVGLRenderer
+{
+public:
+    // Bounded by the minimum uniform block size of OpenGL 3.3
+    static const int MaxPosesPerPass = 64;
+
+    OVShaderRenderer(OVRenderContext* context);
+    ~OVShaderRenderer();
+
+    // True if the current context runs OpenGL 3.3 with every entry point loaded
+    static bool IsSupported();
+
+    bool init();
+    void release();
+    void render();
+    void drawOverlay(const cv::Mat& image, int x, int y);
+    int getMaxPosesPerPass() const { return MaxPosesPerPass; }
+    void renderPoses(const std::vector<Pose>& poses, std::vector<cv::Mat>& images);
+    int getSupportedAuxOutputs() const { return AUX_DEPTH | AUX_IDS | AUX_NORMALS; }
+    bool readAuxPixels(AuxImages& images);
+    const std::string& getError() const { return _err; }
+
+protected:
+    bool loadTextures(std::vector<tinyobj::material_t>& materials,
+                      std::unordered_map<std::string, unsigned int>& textureIds,
+                      const std::string& dir);
+    void drawListChanged();
+
+    GLuint buildProgram(const char* vertexSource, const char* fragmentSource, const std::string& defines);
+    GLuint compileShader(GLenum type, const char* source, const std::string& defines);
+    // Draw count poses from the pose block into a cols x rows grid of
+    // frames, gutter pixels apart
+    void drawFrames(int count, int cols, int rows, int gutter);
+    void updateFrameBlock(int cols, int rows, int gutter);
+    void updatePoseBlock(const std::vector<Pose>& poses, int first, int count);
+    bool setupAtlas(int width, int height);
+    bool setupAuxTarget(int width, int height);
+    // Draw a texture into a rectangle given in normalized device coordinates
+    void drawQuad(GLuint textureId, float x0, float y0, float x1, float y1);
+
+    // Programs by [atlas][lighting][textured]
+    GLuint _programs[2][2][2];
+    GLuint _quadProgram;
+    GLint  _quadRectLocation;
+
+    // Geometry of the draw list
+    GLuint _vertexArray;
+    GLuint _vertexBuffer;
+    GLuint _indexBuffer;
+    GLuint _emptyVertexArray;
+
+    // Uniform blocks: the frame block, the matrices of the poses, and one
+    // material block per material plus the default material, each at a
+    // multiple of the offset alignment
+    GLuint _frameBuffer;
+    GLuint _poseBuffer;
+    GLuint _materialBuffer;
+    int    _materialStride;
+
+    // Target of the multi-pose passes
+    GLuint _atlasFramebuffer;
+    GLuint _atlasColorbuffer;
+    GLuint _atlasDepthbuffer;
+    int    _atlasWidth;
+    int    _atlasHeight;
+
+    // Target of the frames with auxiliary outputs
+    GLuint _auxFramebuffer;
+    GLuint _auxRenderbuffers[4];
+    int    _auxWidth;
+    int    _auxHeight;
+    bool   _isAuxPass;
+
+    GLuint      _overlayTextureId;
+    std::string _err;
+};
+
+} // namespace ov
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <unordered_map>
+#include <vector>
+#include "OVRenderer.h"
+#include "OVThreadPool.h"
+
+namespace ov
+{
+
+// A CPU renderer reproducing the fixed-function path of OVGLRenderer (four
+// point lights with Gouraud shading, GL_MODULATE texturing, alpha blending
+// and the background quad) without an OpenGL context. Triangles are binned
+// into screen tiles that are rasterized in parallel, with SIMD edge
+// functions, perspective-correct interpolation and a depth buffer. Shape
+// and material indices and normals are kept per pixel on request.
+class OVSoftRenderer : public OVRenderer
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    static const int TileSize = 64;
+
+    // 0 threads means the OVThreadPool default
+    explicit OVSoftRenderer(int numThreads = 0);
+    ~OVSoftRenderer();
+
+    bool init();
+    void render();
+    void readPixels(cv::Mat& image);
+    int getSupportedAuxOutputs() const { return AUX_DEPTH | AUX_IDS | AUX_NORMALS; }
+    bool readAuxPixels(AuxImages& images);
+
+protected:
+    bool loadTextures(std::vector<tinyobj::material_t>& materials,
+                      std::unordered_map<std::string, unsigned int>& textureIds,
+                      const std::string& dir);
+    void releaseTextures(const std::unordered_map<std::string, unsigned int>& textureIds);
+    void uploadBackground();
+
+    // A vertex after lighting, in clip space
+    struct ClipVertex
+    {
+        float x, y, z, w;
+        float r, g, b, a;
+        float u, v;
+        float nx, ny, nz;   // Eye-space normal
+    };
+
+    // A clipped triangle in window coordinates with attributes divided by w
+    struct Triangle
+    {
+        float          sx[3], sy[3], sz[3];
+        float          invW[3];
+        float          attr[3][9];  // r, g, b, a, u, v, nx, ny, nz times 1/w
+        const cv::Mat* texture;
+        unsigned short shapeId;     // Shape index + 1
+        unsigned short materialId;  // Material index + 1, 0 for the default material
+        int            edgeFlags;   // Edges drawn in wireframe mode (bit i: vertex i to i + 1)
+        int            minTileX, minTileY, maxTileX, maxTileY;
+    };
+
+    struct BatchMaterial
+    {
+        float          ambient[4];
+        float          diffuse[4];
+        float          specular[4];
+        float          shininess;
+        const cv::Mat* texture;
+        unsigned short id;          // Material index + 1, 0 for the default material
+    };
+
+    void renderForeground();
+    void transformVertices(int first, int last, const Eigen::Matrix4f& modelView);
+    void setupTriangles(int chunk, const std::vector<BatchMaterial>& materials);
+    void shadeVertex(int index, const BatchMaterial& material, const Eigen::Matrix4f& projection, ClipVertex& out) const;
+    void emitTriangle(const ClipVertex* v, int edgeFlags, const BatchMaterial& material, unsigned short shapeId,
+                      std::vector<Triangle>& out) const;
+    void rasterizeTile(int tile);
+    void fillTriangle(const Triangle& tri, int x0, int y0, int x1, int y1);
+    void drawTriangleEdges(const Triangle& tri, int x0, int y0, int x1, int y1);
+    void shadeFragment(const Triangle& tri, int x, int y, float b0, float b1, float b2);
+
+    OVThreadPool* _threadPool;
+    bool          _ownsThreadPool;
+
+    // Textures by the handles stored in the draw list
+    std::unordered_map<unsigned int, cv::Mat> _textures;
+    unsigned int                              _nextTextureId;
+
+    // Frame buffers
+    cv::Mat            _colorBuffer;
+    std::vector<float> _depthBuffer;
+    cv::Mat            _shapeIdBuffer;      // Auxiliary outputs, allocated when enabled
+    cv::Mat            _materialIdBuffer;
+    cv::Mat            _normalBuffer;
+    int                _tilesX;
+    int                _tilesY;
+
+    // Per-frame work
+    std::vector<Eigen::Vector3f>         _eyePositions;
+    std::vector<Eigen::Vector3f>         _eyeNormals;
+    std::vector<std::vector<Triangle> >  _chunkTriangles;
+    std::vector<std::vector<const Triangle*> > _tileBins;
+    Eigen::Matrix4f                      _projection;
+};
+
+} // namespace ov
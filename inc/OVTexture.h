@@ -1,6 +1,6 @@
 #pragma once
 
-#include <GL/gl.h>
+#include "OVGL.h"
 #include <opencv2/opencv.hpp>
 #include <string>
 #include <unordered_map>
@@ -14,6 +14,12 @@ LoadTextures(std::vector<tinyobj::material_t>& materials,
              std::unordered_map<std::string, GLuint>& textureIds,
              const std::string& dir);
 
+// Load the diffuse maps of the materials, flipped to OpenGL row order
+bool
+LoadTextureImages(std::vector<tinyobj::material_t>& materials,
+                  std::unordered_map<std::string, cv::Mat>& textures,
+                  const std::string& dir);
+
 bool
 LoadTexture(cv::Mat& texture, const std::string& filename);
 
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace ov
+{
+
+// A fixed set of worker threads shared by the software renderer and the
+// batch pipeline
+class OVThreadPool
+{
+public:
+    // 0 threads means DefaultThreadCount, or the number of hardware threads if that is 0
+    explicit OVThreadPool(int numThreads = 0);
+    ~OVThreadPool();
+
+    // Set from the command line (--threads)
+    static int DefaultThreadCount;
+
+    // The process-wide pool sized by DefaultThreadCount
+    static OVThreadPool& Global();
+
+    int getThreadCount() const { return (int)_workers.size(); }
+
+    std::future<void> enqueue(const std::function<void()>& task);
+
+    // Run body(i) for every i in [0, count) on the workers and the calling
+    // thread, and return once all of them are done
+    void parallelFor(int count, const std::function<void(int)>& body);
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread>                 _workers;
+    std::queue<std::packaged_task<void()> >  _tasks;
+    std::mutex                               _mutex;
+    std::condition_variable                  _condition;
+    bool                                     _isStopping;
+};
+
+} // namespace ov
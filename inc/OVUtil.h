@@ -5,9 +5,13 @@
 #include <opencv2/opencv.hpp>
 #include <vector>
 #include <cmath>
+#include <string>
+#ifdef _WIN32
 #include <AtlBase.h>
+#endif
 #include "ObjViewer.h"
 #include "OVCommon.h"
+#include "OVFileUtil.h"
 
 namespace ov
 {
@@ -22,18 +26,6 @@ namespace ov
 #define GL_BGRA GL_BGRA_EXT
 #endif
 
-std::string
-GetFileName(const std::string& s);
-
-std::string
-GetBaseName(const std::string& s);
-
-std::string
-GetExt(const std::string& s);
-
-std::string
-GetDir(const std::string& s);
-
 Mat3
 Trackball(const Vec2& prePos, const Vec2& curPos);
 
@@ -55,13 +47,8 @@ CreateCheckBoxAndAddToSizer(wxWindow* parent,
 Mat
 LoadMatrix(std::string fileName);
 
-std::string
-ZeroPadNumber(int num, int width);
-
-bool
-IsDirectoryExists(std::string dirName);
-
+// Error handler of the viewer, installed with SetErrorHandler at start-up
 void
-CreateDirectorys(std::string path);
+ShowErrorMessageBox(const std::string& msg);
 
 } // namespace ov
@@ -18,6 +18,7 @@
 #include <vector>
 #include <opencv2/opencv.hpp>
 #include <wx/tglbtn.h>
+#include "OVBatch.h"
 #include "OVCanvas.h"
 
 
@@ -25,12 +26,6 @@ namespace ov
 {
 
 
-enum RENDER_MODE
-{
-    RENDER_SOLID,
-    RENDER_WIREFRAME,
-};
-
 enum WINDOW_ID
 {
     ID_ANY = -1,
@@ -38,12 +33,16 @@ enum WINDOW_ID
     ID_MENU_OPEN_BACKGROUND_IMAGE,
     ID_MENU_SAVE_IMAGE,
     ID_MENU_GEN_SEQ,
+    ID_MENU_GEN_SEQ_SOFTWARE,
+    ID_MENU_GEN_SEQ_MULTI_POSE,
+    ID_MENU_EXPORT_FRAME_STATS,
     ID_MENU_EXIT,
     ID_MENU_HELP,
     ID_CANVAS,
     ID_RENDER_MODE_RADIO,
     ID_RESET,
     ID_LIGHTING,
+    ID_FRAME_STATS,
 };
 
 
@@ -60,15 +59,20 @@ class ObjViewer : public wxFrame
     void onMenuFileOpenBackgroundImage(wxCommandEvent& evt);
     void onMenuFileSaveImage(wxCommandEvent& evt);
     void onMenuGenerateSequence(wxCommandEvent& evt);
+    void onMenuGenerateSequenceSoftware(wxCommandEvent& evt);
+    void onMenuGenerateSequenceMultiPose(wxCommandEvent& evt);
+    void onMenuExportFrameStats(wxCommandEvent& evt);
     void onMenuFileExit(wxCommandEvent& evt);
     void onMenuHelpAbout(wxCommandEvent& evt);
     void onRenderModeRadio(wxCommandEvent& evt);
     void onLightingCheck(wxCommandEvent& evt);
+    void onFrameStatsCheck(wxCommandEvent& evt);
     void onReset(wxCommandEvent& evt);
     void onMouse(wxMouseEvent& evt);
 
   private:  
     void reLayout();
+    void generateSequences(bool isSoftware, bool isMultiPose);
 
     wxBoxSizer*           _mainSizer;
 
@@ -80,6 +84,7 @@ class ObjViewer : public wxFrame
     wxRadioBox*           _renderModeRadioBox;
     wxButton*             _resetButton;
     wxCheckBox*           _lightingCheckBox;
+    wxCheckBox*           _frameStatsCheckBox;
 
     // Some options
     int  _renderMode;
@@ -0,0 +1,326 @@
+/*
+ * The shared-memory frame ring of the batch generator (container=ring), for
+ * consumer processes that take rendered frames straight from memory. Plain
+ * C, header only; the generator writes the ring through the same layout.
+ *
+ * The ring is a header and slot_count slots. The producer publishes frames
+ * in the order it reserves them, the consumer takes them in that order:
+ *
+ *   producer, frame p:  wait until p - read_count < slot_count
+ *                       fill slot p % slot_count, then store sequence = p + 1
+ *   consumer, frame p:  wait until slot p % slot_count has sequence p + 1
+ *                       read it in place, then store read_count = p + 1
+ *
+ * with acquire loads and release stores, and no locks. There is one
+ * consumer; the producer waits for it, so generation runs at its pace and
+ * stalls until one attaches. The producer sets closed after its last frame
+ * and starts a new ring under the same name for the next batch line.
+ *
+ *   ov_ring ring;
+ *   const ov_ring_slot* slot;
+ *   if (ov_ring_attach(&ring, "ovframes") == OV_RING_OK)
+ *   {
+ *       while (ov_ring_acquire(&ring, -1, &slot) == OV_RING_OK)
+ *       {
+ *           const uint8_t* bgr = (const uint8_t*)ov_ring_plane(&ring, slot, OV_RING_COLOR);
+ *           ...
+ *           ov_ring_release(&ring);
+ *       }
+ *       ov_ring_detach(&ring);
+ *   }
+ */
+#ifndef OV_FRAME_RING_H
+#define OV_FRAME_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef _MSC_VER
+#define OV_RING_INLINE static __inline
+#else
+#define OV_RING_INLINE static inline
+#endif
+
+#define OV_RING_VERSION 2
+
+/* Planes of a frame, crop_width x crop_height samples with rows packed */
+enum
+{
+    OV_RING_COLOR,          /* uint8 B, G, R */
+    OV_RING_DEPTH,          /* float distance along the optical axis, 0 where empty */
+    OV_RING_SHAPE_IDS,      /* uint16 shape index + 1, 0 where empty */
+    OV_RING_MATERIAL_IDS,   /* uint16 material index + 1, 0 for the default material or where empty */
+    OV_RING_NORMALS,        /* float x, y, z camera-space unit normals, 0 where empty */
+    OV_RING_PLANE_COUNT
+};
+
+enum
+{
+    OV_RING_OK,
+    OV_RING_TIMEOUT,
+    OV_RING_CLOSED,         /* Every frame of the ring is consumed */
+    OV_RING_ERROR
+};
+
+typedef struct ov_ring_header
+{
+    char     magic[8];                              /* "OVRING" */
+    uint32_t version;                               /* Stored last by the producer */
+    uint32_t slot_count;
+    uint64_t slot_size;                             /* Bytes from one slot to the next */
+    uint64_t slots_offset;                          /* Of the first slot from the header */
+    int32_t  width;
+    int32_t  height;
+    uint32_t planes;                                /* 1 << OV_RING_* of the planes every frame has */
+    uint32_t reserved;
+    uint64_t plane_offsets[OV_RING_PLANE_COUNT];    /* From the start of a slot */
+    uint64_t closed;
+    uint8_t  padding0[32];
+    uint64_t read_count;                            /* Written by the consumer, on a cache line of its own */
+    uint8_t  padding1[56];
+} ov_ring_header;
+
+typedef struct ov_ring_slot
+{
+    uint64_t sequence;
+    int32_t  line_index;                            /* Of the batch file */
+    int32_t  frame_index;                           /* Pose index within the line */
+    int32_t  crop_x;                                /* Region of the width x height frame the */
+    int32_t  crop_y;                                /* planes cover, all of it unless the line */
+    int32_t  crop_width;                            /* crops frames to the model */
+    int32_t  crop_height;
+    double   rotation[9];                           /* Row-major R of x_camera = R * x_model + t */
+    double   translation[3];
+    double   camera_matrix[9];                      /* Row-major intrinsics */
+} ov_ring_slot;
+
+typedef struct ov_ring
+{
+    ov_ring_header* header;
+    size_t          size;
+#ifdef _WIN32
+    HANDLE          mapping;
+#endif
+} ov_ring;
+
+/* Acquire loads and release stores of the shared counters */
+#ifdef _MSC_VER
+OV_RING_INLINE uint64_t
+ov_ring_load(const uint64_t* value)
+{
+    return (uint64_t)InterlockedCompareExchange64((volatile LONG64*)value, 0, 0);
+}
+
+OV_RING_INLINE void
+ov_ring_store(uint64_t* value, uint64_t newValue)
+{
+    InterlockedExchange64((volatile LONG64*)value, (LONG64)newValue);
+}
+
+OV_RING_INLINE uint32_t
+ov_ring_load32(const uint32_t* value)
+{
+    return (uint32_t)InterlockedCompareExchange((volatile LONG*)value, 0, 0);
+}
+
+OV_RING_INLINE void
+ov_ring_store32(uint32_t* value, uint32_t newValue)
+{
+    InterlockedExchange((volatile LONG*)value, (LONG)newValue);
+}
+#else
+OV_RING_INLINE uint64_t
+ov_ring_load(const uint64_t* value)
+{
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+OV_RING_INLINE void
+ov_ring_store(uint64_t* value, uint64_t newValue)
+{
+    __atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+}
+
+OV_RING_INLINE uint32_t
+ov_ring_load32(const uint32_t* value)
+{
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+OV_RING_INLINE void
+ov_ring_store32(uint32_t* value, uint32_t newValue)
+{
+    __atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+}
+#endif
+
+/* Bytes of a plane of a width x height frame */
+OV_RING_INLINE uint64_t
+ov_ring_plane_size(int plane, int32_t width, int32_t height)
+{
+    static const uint64_t sampleSizes[OV_RING_PLANE_COUNT] = { 3, 4, 2, 2, 12 };
+    return (uint64_t)width * (uint64_t)height * sampleSizes[plane];
+}
+
+/* A short pause between polls */
+OV_RING_INLINE void
+ov_ring_pause(void)
+{
+#ifdef _WIN32
+    Sleep(0);
+#else
+    struct timespec pause = { 0, 50000 };
+    nanosleep(&pause, NULL);
+#endif
+}
+
+OV_RING_INLINE uint64_t
+ov_ring_milliseconds(void)
+{
+#ifdef _WIN32
+    return (uint64_t)GetTickCount64();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+#endif
+}
+
+OV_RING_INLINE void
+ov_ring_detach(ov_ring* ring)
+{
+#ifdef _WIN32
+    if (ring->header)
+        UnmapViewOfFile(ring->header);
+    if (ring->mapping)
+        CloseHandle(ring->mapping);
+    ring->mapping = NULL;
+#else
+    if (ring->header)
+        munmap(ring->header, ring->size);
+#endif
+    ring->header = NULL;
+    ring->size = 0;
+}
+
+/* Map the ring the generator published under name; OV_RING_ERROR while
+   there is none or it is not ready yet */
+OV_RING_INLINE int
+ov_ring_attach(ov_ring* ring, const char* name)
+{
+    char path[256];
+    ov_ring_header* header;
+    memset(ring, 0, sizeof(*ring));
+#ifdef _WIN32
+    {
+        MEMORY_BASIC_INFORMATION info;
+        if (strlen(name) + 7 >= sizeof(path))
+            return OV_RING_ERROR;
+        strcpy(path, "Local\\");
+        strcat(path, name);
+        ring->mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, path);
+        if (!ring->mapping)
+            return OV_RING_ERROR;
+        ring->header = (ov_ring_header*)MapViewOfFile(ring->mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+        if (!ring->header || !VirtualQuery(ring->header, &info, sizeof(info)))
+        {
+            ov_ring_detach(ring);
+            return OV_RING_ERROR;
+        }
+        ring->size = info.RegionSize;
+    }
+#else
+    {
+        struct stat info;
+        int file;
+        void* data;
+        if (strlen(name) + 2 >= sizeof(path))
+            return OV_RING_ERROR;
+        path[0] = '/';
+        strcpy(path + 1, name);
+        file = shm_open(path, O_RDWR, 0);
+        if (file < 0)
+            return OV_RING_ERROR;
+        data = (fstat(file, &info) == 0 && info.st_size >= (off_t)sizeof(ov_ring_header))
+               ? mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0) : MAP_FAILED;
+        close(file);
+        if (data == MAP_FAILED)
+            return OV_RING_ERROR;
+        ring->header = (ov_ring_header*)data;
+        ring->size = (size_t)info.st_size;
+    }
+#endif
+
+    header = ring->header;
+    if (ring->size < sizeof(ov_ring_header) || memcmp(header->magic, "OVRING", 6) != 0 ||
+        ov_ring_load32(&header->version) != OV_RING_VERSION || header->slot_count == 0 ||
+        header->slots_offset + (uint64_t)header->slot_count * header->slot_size > ring->size)
+    {
+        ov_ring_detach(ring);
+        return OV_RING_ERROR;
+    }
+    return OV_RING_OK;
+}
+
+/* Wait up to timeout milliseconds, or forever if negative, for the next
+   frame; its slot stays valid until ov_ring_release */
+OV_RING_INLINE int
+ov_ring_acquire(ov_ring* ring, int timeout, const ov_ring_slot** slot)
+{
+    ov_ring_header* header = ring->header;
+    uint64_t position = ov_ring_load(&header->read_count);
+    ov_ring_slot* next = (ov_ring_slot*)((char*)header + header->slots_offset +
+                                         (position % header->slot_count) * header->slot_size);
+    uint64_t start = ov_ring_milliseconds();
+    while (1)
+    {
+        /* Frames published before the ring closed are still taken */
+        int isClosed = ov_ring_load(&header->closed) != 0;
+        if (ov_ring_load(&next->sequence) == position + 1)
+        {
+            *slot = next;
+            return OV_RING_OK;
+        }
+        if (isClosed)
+            return OV_RING_CLOSED;
+        if (timeout >= 0 && ov_ring_milliseconds() - start >= (uint64_t)timeout)
+            return OV_RING_TIMEOUT;
+        ov_ring_pause();
+    }
+}
+
+/* A plane of an acquired frame, NULL if the ring has none */
+OV_RING_INLINE const void*
+ov_ring_plane(const ov_ring* ring, const ov_ring_slot* slot, int plane)
+{
+    if (plane < 0 || plane >= OV_RING_PLANE_COUNT || !(ring->header->planes & (1u << plane)))
+        return NULL;
+    return (const char*)slot + ring->header->plane_offsets[plane];
+}
+
+/* Hand the acquired frame's slot back to the producer */
+OV_RING_INLINE void
+ov_ring_release(ov_ring* ring)
+{
+    ov_ring_store(&ring->header->read_count, ov_ring_load(&ring->header->read_count) + 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OV_FRAME_RING_H */
@@ -0,0 +1,382 @@
+#include <algorithm>
+#include <cmath>
+#include "OVBackgroundSequence.h"
+#include "OVFileUtil.h"
+#include "OVThreadPool.h"
+
+namespace ov
+{
+
+namespace
+{
+
+bool
+IsImageExt(std::string ext)
+{
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == "png" || ext == "jpg" || ext == "jpeg" || ext == "bmp" || ext == "tif"
+        || ext == "tiff" || ext == "ppm" || ext == "pgm" || ext == "exr";
+}
+
+bool
+IsVideoPath(const std::string& path)
+{
+    if (path.find('%') != std::string::npos)
+        return true;
+
+    std::string ext = GetExt(path);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == "avi" || ext == "mp4" || ext == "mov" || ext == "mkv" || ext == "webm"
+        || ext == "mpg" || ext == "mpeg" || ext == "wmv" || ext == "m4v";
+}
+
+// Scale the image to cover size, keeping its aspect ratio, and crop the center
+cv::Mat
+FitImage(const cv::Mat& image, const cv::Size& size)
+{
+    if (image.size() == size)
+        return image;
+
+    double scale = std::max((double)size.width / image.cols, (double)size.height / image.rows);
+    int w = std::max(size.width, (int)std::ceil(image.cols * scale - 1e-6));
+    int h = std::max(size.height, (int)std::ceil(image.rows * scale - 1e-6));
+    cv::Mat scaled;
+    cv::resize(image, scaled, cv::Size(w, h), 0, 0, scale < 1 ? cv::INTER_AREA : cv::INTER_LINEAR);
+    return scaled(cv::Rect((w - size.width) / 2, (h - size.height) / 2, size.width, size.height)).clone();
+}
+
+} // namespace
+
+OVBackgroundSequence::OVBackgroundSequence()
+{
+    _sourceType = SOURCE_IMAGE;
+    _nextFrame = 0;
+    _nextScheduled = 0;
+    _pendingTasks = 0;
+    _isVideoDecoding = false;
+    _isClosing = false;
+    _cacheBytes = 0;
+    _cacheBudget = 0;
+}
+
+OVBackgroundSequence::~OVBackgroundSequence()
+{
+    close();
+}
+
+bool
+OVBackgroundSequence::open(const std::string& path, int startFrame)
+{
+    close();
+    _path = path;
+    _err.clear();
+
+    if (IsDirectoryExists(path))
+    {
+        if (!listImages(path))
+            return false;
+        _sourceType = SOURCE_FILES;
+        _firstFrame = cv::imread(_files[0], CV_LOAD_IMAGE_COLOR);
+    }
+    else if (IsVideoPath(path))
+    {
+        _sourceType = SOURCE_VIDEO;
+        if (_video.open(path))
+            _video.read(_firstFrame);
+    }
+    else
+    {
+        _sourceType = SOURCE_IMAGE;
+        _firstFrame = cv::imread(path, CV_LOAD_IMAGE_COLOR);
+    }
+    if (_firstFrame.empty() || _firstFrame.type() != CV_8UC3)
+    {
+        _err = "Cannot open \"" + path + "\"";
+        _firstFrame.release();
+        return false;
+    }
+
+    return startPrefetch(startFrame);
+}
+
+bool
+OVBackgroundSequence::openPool(const std::string& dir, unsigned int seed, size_t cacheBudget, const cv::Size& frameSize,
+                               int startFrame)
+{
+    close();
+    _path = dir;
+    _err.clear();
+
+    if (!IsDirectoryExists(dir))
+    {
+        _err = "\"" + dir + "\" is not a directory";
+        return false;
+    }
+    if (!listImages(dir))
+        return false;
+    _sourceType = SOURCE_POOL;
+    _rng.seed(seed);
+
+    // Cached images stay valid for later jobs drawing from the same pool at the same size
+    if (frameSize != _frameSize)
+    {
+        _cache.clear();
+        _cacheIndex.clear();
+        _cacheBytes = 0;
+    }
+    _frameSize = frameSize;
+    _cacheBudget = cacheBudget;
+
+    const std::string& file = _files[nextPick()];
+    _firstFrame = loadPoolImage(file);
+    if (_firstFrame.empty())
+    {
+        _err = "Cannot open \"" + file + "\"";
+        return false;
+    }
+
+    return startPrefetch(startFrame);
+}
+
+void
+OVBackgroundSequence::close()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _isClosing = true;
+        _condition.wait(lock, [this]() { return _pendingTasks == 0; });
+        _isClosing = false;
+        for (int i = 0; i < RingSize; ++i)
+        {
+            _slots[i].index = -1;
+            _slots[i].isReady = false;
+            _slots[i].image.release();
+        }
+    }
+    _video.release();
+    _files.clear();
+    _firstFrame.release();
+    _sourceType = SOURCE_IMAGE;
+}
+
+bool
+OVBackgroundSequence::nextFrame(cv::Mat& frame)
+{
+    if (!isAnimated())
+    {
+        frame = _firstFrame;
+        return !frame.empty();
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    int index = _nextFrame;
+    Slot& slot = _slots[index % RingSize];
+    _condition.wait(lock, [&slot, index]() { return slot.index == index && slot.isReady; });
+    frame = slot.image;
+    slot.image.release();
+    slot.isReady = false;
+    ++_nextFrame;
+    schedule();
+
+    return !frame.empty();
+}
+
+bool
+OVBackgroundSequence::startPrefetch(int startFrame)
+{
+    // Frame 0 is already decoded; the video decoder goes on from frame 1
+    if (startFrame > 1 && _sourceType == SOURCE_POOL)
+        _rng.discard(startFrame - 1);
+    if (startFrame > 1 && _sourceType == SOURCE_VIDEO)
+    {
+        // Frames are grabbed without decoding them; a video starts over
+        // at its end, so whole passes over it are left out
+        long long numSkipped = startFrame - 1;
+        double length = _video.get(cv::CAP_PROP_FRAME_COUNT);
+        if (length >= 1)
+            numSkipped %= (long long)length;
+        for (long long i = 0; i < numSkipped; ++i)
+        {
+            if (!_video.grab() && !(_video.open(_path) && _video.grab()))
+            {
+                _err = "Cannot seek to frame " + std::to_string(startFrame) + " of \"" + _path + "\"";
+                return false;
+            }
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (startFrame == 0)
+    {
+        _slots[0].index = 0;
+        _slots[0].isReady = true;
+        _slots[0].image = _firstFrame;
+    }
+    _nextFrame = startFrame;
+    _nextScheduled = std::max(startFrame, 1);
+    if (isAnimated())
+        schedule();
+    return true;
+}
+
+bool
+OVBackgroundSequence::listImages(const std::string& dir)
+{
+    std::vector<cv::String> files;
+    cv::glob(dir, files, false);
+    for (int i = 0; i < files.size(); ++i)
+    {
+        if (IsImageExt(GetExt(files[i])))
+            _files.push_back(files[i]);
+    }
+    if (_files.empty())
+    {
+        _err = "No images in \"" + dir + "\"";
+        return false;
+    }
+    return true;
+}
+
+int
+OVBackgroundSequence::nextPick()
+{
+    // Not std::uniform_int_distribution, whose output differs between
+    // standard libraries; the modulo bias is negligible for pool sizes
+    return (int)(_rng() % _files.size());
+}
+
+void
+OVBackgroundSequence::schedule()
+{
+    int end = _nextFrame + RingSize;
+    if (_sourceType == SOURCE_FILES || _sourceType == SOURCE_POOL)
+    {
+        // Files decode independently, so the pool works on several at once.
+        // Random picks are drawn here, in frame order, to keep them seeded.
+        for (; _nextScheduled < end; ++_nextScheduled)
+        {
+            Slot& slot = _slots[_nextScheduled % RingSize];
+            slot.index = _nextScheduled;
+            slot.isReady = false;
+            ++_pendingTasks;
+            int index = _nextScheduled;
+            int fileIndex = (_sourceType == SOURCE_POOL) ? nextPick() : index % (int)_files.size();
+            OVThreadPool::Global().enqueue([this, index, fileIndex]() { decodeFile(index, fileIndex); });
+        }
+    }
+    else if (_sourceType == SOURCE_VIDEO && !_isVideoDecoding && _nextScheduled < end)
+    {
+        // A video decodes in order, so one task runs until the ring is full
+        _isVideoDecoding = true;
+        ++_pendingTasks;
+        OVThreadPool::Global().enqueue([this]() { decodeVideo(); });
+    }
+}
+
+void
+OVBackgroundSequence::decodeFile(int index, int fileIndex)
+{
+    bool isClosing;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        isClosing = _isClosing;
+    }
+    if (!isClosing)
+    {
+        const std::string& file = _files[fileIndex];
+        cv::Mat image;
+        if (_sourceType == SOURCE_POOL)
+            image = loadPoolImage(file);
+        else
+            image = cv::imread(file, CV_LOAD_IMAGE_COLOR);
+        finishFrame(index, image, "Cannot open \"" + file + "\"");
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    --_pendingTasks;
+    _condition.notify_all();
+}
+
+void
+OVBackgroundSequence::decodeVideo()
+{
+    while (true)
+    {
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (_isClosing || _nextScheduled >= _nextFrame + RingSize)
+            {
+                _isVideoDecoding = false;
+                --_pendingTasks;
+                _condition.notify_all();
+                return;
+            }
+            index = _nextScheduled++;
+            Slot& slot = _slots[index % RingSize];
+            slot.index = index;
+            slot.isReady = false;
+        }
+
+        // At the end of the video start over from its first frame
+        cv::Mat image;
+        if (!_video.read(image) && _video.open(_path))
+            _video.read(image);
+        finishFrame(index, image, "Cannot read frame " + std::to_string(index) + " of \"" + _path + "\"");
+    }
+}
+
+void
+OVBackgroundSequence::finishFrame(int index, cv::Mat& image, const std::string& err)
+{
+    if (!image.empty() && image.size() != _firstFrame.size())
+        cv::resize(image, image, _firstFrame.size(), 0, 0, cv::INTER_LINEAR);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (image.empty() && _err.empty())
+        _err = err;
+    Slot& slot = _slots[index % RingSize];
+    slot.image = image;
+    slot.isReady = true;
+    _condition.notify_all();
+}
+
+cv::Mat
+OVBackgroundSequence::loadPoolImage(const std::string& file)
+{
+    cv::Mat image;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto it = _cacheIndex.find(file);
+        if (it != _cacheIndex.end())
+        {
+            _cache.splice(_cache.begin(), _cache, it->second);
+            return it->second->second;
+        }
+    }
+
+    image = cv::imread(file, CV_LOAD_IMAGE_COLOR);
+    if (image.empty())
+        return image;
+    image = FitImage(image, _frameSize);
+
+    // Another decoder may have cached the same file meanwhile
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_cacheIndex.find(file) == _cacheIndex.end())
+    {
+        _cache.push_front(std::make_pair(file, image));
+        _cacheIndex[file] = _cache.begin();
+        _cacheBytes += image.total() * image.elemSize();
+        while (_cacheBytes > _cacheBudget && _cache.size() > 1)
+        {
+            const cv::Mat& oldest = _cache.back().second;
+            _cacheBytes -= oldest.total() * oldest.elemSize();
+            _cacheIndex.erase(_cache.back().first);
+            _cache.pop_back();
+        }
+    }
+
+    return image;
+}
+
+} // namespace ov
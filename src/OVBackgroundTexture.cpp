@@ -0,0 +1,102 @@
+#include <cstring>
+#include "OVBackgroundTexture.h"
+
+namespace ov
+{
+
+OVBackgroundTexture::OVBackgroundTexture()
+{
+    _textureId = 0;
+    _width = 0;
+    _height = 0;
+    _unpackBuffer = 0;
+    _unpackBufferSize = 0;
+}
+
+void
+OVBackgroundTexture::init()
+{
+    if (_textureId == 0)
+        glGenTextures(1, &_textureId);
+}
+
+void
+OVBackgroundTexture::release()
+{
+    if (_unpackBuffer != 0)
+        gl::DeleteBuffers(1, &_unpackBuffer);
+    if (_textureId != 0)
+        glDeleteTextures(1, &_textureId);
+    _textureId = 0;
+    _width = 0;
+    _height = 0;
+    _unpackBuffer = 0;
+    _unpackBufferSize = 0;
+}
+
+void
+OVBackgroundTexture::upload(const cv::Mat& image)
+{
+    if (_textureId == 0 || image.empty() || image.type() != CV_8UC3)
+        return;
+
+    int w = image.cols;
+    int h = image.rows;
+    size_t rowSize = (size_t)w * 3;
+    glBindTexture(GL_TEXTURE_2D, _textureId);
+    if (w != _width || h != _height)
+        allocate(w, h);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if (hasUnpackBuffer())
+    {
+        if (_unpackBuffer == 0)
+            gl::GenBuffers(1, &_unpackBuffer);
+        gl::BindBuffer(GL_PIXEL_UNPACK_BUFFER, _unpackBuffer);
+
+        // Orphan the buffer, so that a transfer still reading the previous
+        // image keeps its own storage instead of stalling the map
+        _unpackBufferSize = (GLsizeiptr)(rowSize * h);
+        gl::BufferData(GL_PIXEL_UNPACK_BUFFER, _unpackBufferSize, NULL, GL_STREAM_DRAW);
+        uchar* pixels = (uchar*)gl::MapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+        if (pixels)
+        {
+            for (int y = 0; y < h; ++y)
+                memcpy(pixels + rowSize * y, image.ptr<uchar>(y), rowSize);
+            gl::UnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+            // Returns at once; the texture is filled from the buffer
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_BGR, GL_UNSIGNED_BYTE, 0);
+            gl::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return;
+        }
+        gl::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    // Direct upload from client memory
+    cv::Mat pixels = image.isContinuous() ? image : image.clone();
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_BGR, GL_UNSIGNED_BYTE, pixels.data);
+}
+
+bool
+OVBackgroundTexture::hasUnpackBuffer() const
+{
+    return gl::HasPixelBuffers;
+}
+
+void
+OVBackgroundTexture::allocate(int width, int height)
+{
+    // Three-channel storage like the BGR source, so the upload only swaps
+    // channel order; no mipmaps, as the quad is drawn at about its own size
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, NULL);
+    _width = width;
+    _height = height;
+}
+
+} // namespace ov
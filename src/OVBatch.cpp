@@ -0,0 +1,1059 @@
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include "OVBatch.h"
+#include "OVFileUtil.h"
+#include "OVPoseSource.h"
+#include "OVThreadPool.h"
+
+namespace ov
+{
+
+namespace
+{
+
+const int MaxVariants = 1024;
+
+// What decides a variant's frames, so a manifest is only resumed by the same job
+std::string
+GetJobParameters(const BatchJob& job, const BatchVariant& variant, int frameCount)
+{
+    char numbers[128];
+    snprintf(numbers, sizeof(numbers), " blur=%.17g noise=%.17g outputs=%d background=%s seed=%u count=%d",
+             variant.blurSigma, variant.noiseVariance, job.auxOutputs, job.isRandomBackground ? "random" : "sequence",
+             job.backgroundSeed, frameCount);
+    std::string parameters = "model=" + job.modelFile + " image=" + job.imageFile + " camera=" + job.cameraFile +
+                             " poses=" + job.posesFile + numbers + " format=" +
+                             OVFrameEncoder::GetFormatName(job.imageFormat) + " quality=" +
+                             std::to_string(job.imageQuality);
+    // Left out for files, so the manifests of earlier runs still match
+    if (job.container == CONTAINER_ARCHIVE)
+        parameters += " container=archive";
+    else if (job.container == CONTAINER_VIDEO)
+    {
+        snprintf(numbers, sizeof(numbers), " fps=%.17g video_quality=%d", job.video.fps, job.video.quality);
+        parameters += " container=video codec=" + job.video.codec + numbers;
+    }
+    if (job.cropMargin >= 0)
+        parameters += " crop=" + std::to_string(job.cropMargin);
+    if (job.isAnnotated)
+        parameters += " annotate=boxes";
+    if (!job.keypointsFile.empty())
+        parameters += " keypoints=" + job.keypointsFile;
+    return parameters;
+}
+
+// Keypoints are hidden behind the depth image, rendered for them alone if
+// the job writes none
+int
+GetRenderedAuxOutputs(const BatchJob& job)
+{
+    return job.auxOutputs | (job.keypointsFile.empty() ? 0 : AUX_DEPTH);
+}
+
+// Comma-separated numbers and first:last:step ranges, such as 0,0.5:2:0.5
+bool
+ParseSweep(const std::string& text, std::vector<double>& values)
+{
+    values.clear();
+    std::stringstream textStream(text);
+    std::string item;
+    while (std::getline(textStream, item, ','))
+    {
+        double range[3];
+        int numParts = 0;
+        std::stringstream itemStream(item);
+        std::string part;
+        while (numParts < 3 && std::getline(itemStream, part, ':'))
+        {
+            size_t end;
+            try
+            {
+                range[numParts++] = std::stod(part, &end);
+            }
+            catch (const std::exception&)
+            {
+                return false;
+            }
+            // stod also takes inf and nan
+            if (end != part.size() || !std::isfinite(range[numParts - 1]) || range[numParts - 1] < 0)
+                return false;
+        }
+        if (numParts == 1 && itemStream.eof())
+            values.push_back(range[0]);
+        else if (numParts == 3 && itemStream.eof() && range[2] > 0 && range[1] >= range[0])
+        {
+            // Steps counted rather than accumulated, with the last value kept
+            // despite rounding
+            double numSteps = std::floor((range[1] - range[0]) / range[2] + 1e-9);
+            if (values.size() + numSteps >= MaxVariants)
+                return false;
+            for (int i = 0; i <= (int)numSteps; ++i)
+                values.push_back(range[0] + i * range[2]);
+        }
+        else
+            return false;
+        if (values.size() > MaxVariants)
+            return false;
+    }
+    return !values.empty();
+}
+
+} // namespace
+
+bool
+ParseBatchLine(const std::string& line, const std::string& batchDir, BatchJob& job, std::string& err)
+{
+    std::stringstream lineStream(line);
+    std::string blur, noise, output;
+    lineStream >> job.modelFile >> job.imageFile >> job.cameraFile >> job.posesFile >> blur >> noise >> output;
+    if (lineStream.fail())
+    {
+        err = "Expected <model> <image> <camera> <poses> <blur> <noise> <output> in \"" + line + "\"";
+        return false;
+    }
+
+    std::vector<double> blurSigmas, noiseVariances;
+    if (!ParseSweep(blur, blurSigmas) || !ParseSweep(noise, noiseVariances) ||
+        blurSigmas.size() * noiseVariances.size() > MaxVariants)
+    {
+        err = "Invalid blur or noise values in \"" + line + "\"";
+        return false;
+    }
+    job.outputDir = batchDir + output;
+
+    // A sweep writes every pair to a directory of its own, so values must
+    // differ in the digits of its name
+    job.variants.clear();
+    std::set<std::string> variantDirs;
+    for (int i = 0; i < blurSigmas.size(); ++i)
+    {
+        for (int j = 0; j < noiseVariances.size(); ++j)
+        {
+            BatchVariant variant;
+            variant.blurSigma = blurSigmas[i];
+            variant.noiseVariance = noiseVariances[j];
+            variant.outputDir = job.outputDir;
+            if (blurSigmas.size() * noiseVariances.size() > 1)
+            {
+                char name[64];
+                snprintf(name, sizeof(name), "blur%g_noise%g/", variant.blurSigma, variant.noiseVariance);
+                variant.outputDir += name;
+                if (!variantDirs.insert(name).second)
+                {
+                    err = "Repeated blur or noise values in \"" + line + "\"";
+                    return false;
+                }
+            }
+            job.variants.push_back(variant);
+        }
+    }
+
+    // Optional key=value settings
+    job.auxOutputs = 0;
+    job.isRandomBackground = false;
+    job.backgroundSeed = 0;
+    job.backgroundCacheSize = 512;
+    job.imageFormat = FORMAT_PNG;
+    job.imageQuality = -1;
+    job.container = CONTAINER_FILES;
+    job.video.codec = "ffv1";
+    job.video.fps = 30;
+    job.video.quality = -1;
+    job.ring.name = "ovframes";
+    job.ring.numSlots = 8;
+    job.cropMargin = -1;
+    job.isAnnotated = false;
+    job.keypointsFile.clear();
+    std::string option;
+    while (lineStream >> option)
+    {
+        size_t separator = option.find('=');
+        std::string key = option.substr(0, separator);
+        std::string value = (separator == std::string::npos) ? "" : option.substr(separator + 1);
+        if (key == "outputs")
+        {
+            std::stringstream valueStream(value);
+            std::string output;
+            while (std::getline(valueStream, output, ','))
+            {
+                if (output == "depth")
+                    job.auxOutputs |= AUX_DEPTH;
+                else if (output == "ids")
+                    job.auxOutputs |= AUX_IDS;
+                else if (output == "normals")
+                    job.auxOutputs |= AUX_NORMALS;
+                else
+                {
+                    err = "Unknown output \"" + output + "\" in \"" + line + "\"";
+                    return false;
+                }
+            }
+        }
+        else if (key == "background" && (value == "random" || value == "sequence"))
+            job.isRandomBackground = (value == "random");
+        else if (key == "annotate" && value == "boxes")
+            job.isAnnotated = true;
+        else if (key == "keypoints" && !value.empty())
+        {
+            job.isAnnotated = true;
+            job.keypointsFile = value;
+        }
+        else if (key == "format")
+        {
+            if (!OVFrameEncoder::ParseFormat(value, job.imageFormat))
+            {
+                err = "Unknown image format \"" + value + "\" in \"" + line + "\"";
+                return false;
+            }
+        }
+        else if (key == "container")
+        {
+            if (!OVFrameSink::ParseContainer(value, job.container))
+            {
+                err = "Unknown container \"" + value + "\" in \"" + line + "\"";
+                return false;
+            }
+        }
+        else if (key == "codec")
+        {
+            if (!OVFrameSink::IsValidVideoCodec(value))
+            {
+                err = "Unknown video codec \"" + value + "\" in \"" + line + "\"";
+                return false;
+            }
+            job.video.codec = value;
+        }
+        else if (key == "fps")
+        {
+            size_t end = 0;
+            try
+            {
+                job.video.fps = std::stod(value, &end);
+            }
+            catch (const std::exception&)
+            {
+                end = 0;
+            }
+            if (end == 0 || end != value.size() || !(job.video.fps > 0 && job.video.fps <= 1000))
+            {
+                err = "Invalid value of \"fps\" in \"" + line + "\"";
+                return false;
+            }
+        }
+        else if (key == "ring")
+        {
+            // A portable shared memory name
+            if (value.empty() || value.size() > 200 ||
+                value.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_.-") !=
+                std::string::npos)
+            {
+                err = "Invalid ring name \"" + value + "\" in \"" + line + "\"";
+                return false;
+            }
+            job.ring.name = value;
+        }
+        else if (key == "seed" || key == "cache" || key == "quality" || key == "slots" || key == "crop")
+        {
+            try
+            {
+                size_t end;
+                unsigned long number = std::stoul(value, &end);
+                if (end != value.size())
+                    throw std::invalid_argument(value);
+                if (key == "seed")
+                    job.backgroundSeed = (unsigned int)number;
+                else if (key == "cache")
+                    job.backgroundCacheSize = (int)number;
+                else if (key == "slots")
+                {
+                    if (number < 1 || number > 1024)
+                        throw std::out_of_range(value);
+                    job.ring.numSlots = (int)number;
+                }
+                else if (key == "crop")
+                    job.cropMargin = (int)std::min(number, 100000ul);
+                else
+                    job.imageQuality = (int)std::min(number, 1000ul);
+            }
+            catch (const std::exception&)
+            {
+                err = "Invalid value of \"" + key + "\" in \"" + line + "\"";
+                return false;
+            }
+        }
+        else
+        {
+            err = "Unknown option \"" + option + "\" in \"" + line + "\"";
+            return false;
+        }
+    }
+    // A video's quality is its codec's, which leaves the format unused
+    if (job.container == CONTAINER_VIDEO)
+    {
+        job.video.quality = job.imageQuality;
+        job.imageQuality = -1;
+        if (job.video.quality > 100)
+        {
+            err = "Invalid video quality in \"" + line + "\"";
+            return false;
+        }
+    }
+    if (job.container == CONTAINER_VIDEO && job.cropMargin >= 0)
+    {
+        err = "Video frames cannot be cropped in \"" + line + "\"";
+        return false;
+    }
+    // The ring's consumer has the poses and intrinsics to project with
+    if (job.container == CONTAINER_RING && job.isAnnotated)
+    {
+        err = "Ring frames cannot be annotated in \"" + line + "\"";
+        return false;
+    }
+    if (!OVFrameEncoder::IsValidQuality(job.imageFormat, job.imageQuality))
+    {
+        err = "Invalid quality for the " + std::string(OVFrameEncoder::GetFormatName(job.imageFormat)) +
+              " format in \"" + line + "\"";
+        return false;
+    }
+
+    return true;
+}
+
+bool
+LoadBatchFile(const std::string& batchFile, std::vector<BatchJob>& jobs, std::string& err)
+{
+    std::ifstream genIStream(batchFile);
+    if (!genIStream.is_open())
+    {
+        err = "Cannot open \"" + batchFile + "\"";
+        return false;
+    }
+
+    std::string batchDir = GetDir(batchFile);
+    std::string line;
+    jobs.clear();
+    while (std::getline(genIStream, line))
+    {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        BatchJob job;
+        if (!ParseBatchLine(line, batchDir, job, err))
+            return false;
+        jobs.push_back(job);
+    }
+
+    return true;
+}
+
+bool
+OpenBatchManifest(const BatchJob& job, int variantIndex, int frameCount, OVBatchManifest& manifest,
+                  std::string& err)
+{
+    // Frames count while their image has the listed size and their
+    // auxiliary images exist, as files or in the archives
+    const BatchVariant& variant = job.variants[variantIndex];
+    std::unique_ptr<OVFrameEncoder> encoder(OVFrameEncoder::Create(job.imageFormat, job.imageQuality));
+    std::string extension = encoder->getExtension();
+    std::vector<ARCHIVE_ENTRY> auxTypes;
+    OVFrameSink::GetAuxEntries(job.auxOutputs, auxTypes);
+    if (!IsDirectoryExists(variant.outputDir))
+        CreateDirectorys(variant.outputDir);
+    OVFrameArchiveReader archive, auxArchive;
+    bool isArchive = (job.container == CONTAINER_ARCHIVE);
+    if (isArchive)
+    {
+        archive.open(variant.outputDir + OVFrameArchive::FileName);
+        if (!auxTypes.empty() && job.variants.size() > 1)
+            auxArchive.open(job.outputDir + OVFrameArchive::FileName);
+    }
+    const OVFrameArchiveReader& auxSource = (job.variants.size() > 1) ? auxArchive : archive;
+    bool isOpen = manifest.open(variant.outputDir, GetJobParameters(job, variant, frameCount), frameCount,
+                                [&](int frameIndex, long long numBytes)
+    {
+        size_t size;
+        std::string frameName = ZeroPadNumber(frameIndex, 6);
+        // A video is not resumed
+        if (job.container == CONTAINER_VIDEO)
+            return false;
+        if (isArchive ? !archive.getEntry(frameIndex, ENTRY_IMAGE, size) || (long long)size != numBytes
+                      : GetFileLength(variant.outputDir + frameName + extension) != numBytes)
+            return false;
+        for (int i = 0; i < auxTypes.size(); ++i)
+        {
+            if (isArchive ? !auxSource.getEntry(frameIndex, auxTypes[i], size)
+                          : GetFileLength(job.outputDir + frameName + OVFrameSink::GetAuxFileSuffix(auxTypes[i])) < 0)
+                return false;
+        }
+        return true;
+    });
+    if (!isOpen)
+        err = manifest.getError();
+    return isOpen;
+}
+
+OVBatchGenerator::OVBatchGenerator(OVRenderer* renderer, OVRenderContext* context)
+{
+    _renderer = renderer;
+    _context = context;
+    _posesPerPass = 1;
+    _numProcessWorkers = 0;
+    _numEncodeWorkers = 0;
+    _numReported = 0;
+    _isManifestUsed = false;
+    _isJobManifestUsed = false;
+    _auxSink = NULL;
+    _offsetScale = 1;
+    _planeNear = OVRenderer::PlaneNear;
+    _planeFar = OVRenderer::PlaneFar;
+    _numEncoded = 0;
+    _numEncodedRawBytes = 0;
+    _numEncodedBytes = 0;
+    _encodeNanoseconds = 0;
+}
+
+void
+OVBatchGenerator::setPipelineWorkers(int numProcessWorkers, int numEncodeWorkers)
+{
+    _numProcessWorkers = numProcessWorkers;
+    _numEncodeWorkers = numEncodeWorkers;
+}
+
+void
+OVBatchGenerator::getEncodeStats(EncodeStats& stats) const
+{
+    stats.numFrames = _numEncoded;
+    stats.numRawBytes = _numEncodedRawBytes;
+    stats.numBytes = _numEncodedBytes;
+    stats.seconds = _encodeNanoseconds * 1e-9;
+}
+
+bool
+OVBatchGenerator::run(const std::string& batchFile)
+{
+    if (!begin(batchFile))
+        return false;
+    _isManifestUsed = true;
+
+    bool isOk = true;
+    for (int i = 0; i < _jobs.size() && isOk; ++i)
+        isOk = runJob(_jobs[i], i, 0, INT_MAX);
+    end();
+    return isOk;
+}
+
+bool
+OVBatchGenerator::begin(const std::string& batchFile)
+{
+    if (!LoadBatchFile(batchFile, _jobs, _err))
+        return false;
+    _isManifestUsed = false;
+    _modelFile.clear();
+
+    // Poses are given in the camera frame
+    _renderer->getOffsetPose(_offsetRotation, _offsetTranslation, _offsetScale);
+    _renderer->setOffsetPose(Vec3(0, 0, 0), Vec3(0, 0, 0), 1);
+    _planeNear = OVRenderer::PlaneNear;
+    _planeFar = OVRenderer::PlaneFar;
+    OVRenderer::PlaneNear = 1;
+    OVRenderer::PlaneFar = 10000;
+
+    _numEncoded = 0;
+    _numEncodedRawBytes = 0;
+    _numEncodedBytes = 0;
+    _encodeNanoseconds = 0;
+    _pipeline.reset(new OVFramePipeline(_numProcessWorkers, _numEncodeWorkers));
+    _pipeline->start([](PipelineFrame& frame)
+    {
+        processImage(frame);
+        return true;
+    },
+    [this](PipelineFrame& frame)
+    {
+        return writeImages(frame);
+    });
+    return true;
+}
+
+bool
+OVBatchGenerator::runFrames(int lineIndex, int firstFrame, int endFrame)
+{
+    if (lineIndex < 0 || lineIndex >= _jobs.size())
+    {
+        _err = "No line " + std::to_string(lineIndex + 1) + " in the batch file";
+        return false;
+    }
+    return runJob(_jobs[lineIndex], lineIndex, firstFrame, endFrame);
+}
+
+void
+OVBatchGenerator::end()
+{
+    _renderer->setAuxOutputs(0);
+    _renderer->setReadRegion(cv::Rect());
+    _pipeline->finish();
+    _pipeline->getStats(_pipelineStats);
+    _pipeline.reset();
+    _sinks.clear();
+    _auxSinkOwner.reset();
+    _auxSink = NULL;
+    _encoder.reset();
+    _poses.reset();
+
+    _renderer->setOffsetPose(_offsetRotation, _offsetTranslation, _offsetScale);
+    OVRenderer::PlaneNear = _planeNear;
+    OVRenderer::PlaneFar = _planeFar;
+}
+
+bool
+OVBatchGenerator::runJob(const BatchJob& job, int lineIndex, int firstFrame, int endFrame)
+{
+    // Poses are parsed or read from the mapped file as frames render; the
+    // shards of a worker mostly move forward through the same file
+    if (!_poses || _posesFile != job.posesFile)
+    {
+        _poses.reset(OVPoseSource::Open(job.posesFile, _err));
+        _posesFile = _poses ? job.posesFile : "";
+        if (!_poses)
+            return false;
+    }
+    OVPoseSource* poses = _poses.get();
+
+    // Frames of an interrupted run count while their files are whole, in
+    // every variant's directory; a ring leaves neither
+    bool isWrittenToDisk = (job.container != CONTAINER_RING);
+    if (isWrittenToDisk && !IsDirectoryExists(job.outputDir))
+        CreateDirectorys(job.outputDir);
+    _isJobManifestUsed = _isManifestUsed && isWrittenToDisk;
+    int num = (int)poses->getCount();
+    int numVariants = (int)job.variants.size();
+    _manifests.resize(numVariants);
+    for (int i = 0; i < numVariants; ++i)
+    {
+        if (!_manifests[i])
+            _manifests[i].reset(new OVBatchManifest());
+        _manifests[i]->close();
+        if (_isJobManifestUsed && !OpenBatchManifest(job, i, num, *_manifests[i], _err))
+            return false;
+        if (!_isJobManifestUsed && isWrittenToDisk && !IsDirectoryExists(job.variants[i].outputDir))
+            CreateDirectorys(job.variants[i].outputDir);
+    }
+    // The annotations of an earlier run stay while its frames do
+    _annotations.close();
+    if (_isJobManifestUsed && job.isAnnotated)
+    {
+        bool isResumed = false;
+        for (int i = 0; i < numVariants; ++i)
+            isResumed = isResumed || _manifests[i]->getResumedCount() > 0;
+        if (!_annotations.open(job.outputDir, isResumed))
+        {
+            _err = _annotations.getError();
+            return false;
+        }
+    }
+
+    // The scene is set up for the first frame left to render
+    endFrame = std::min(endFrame, num);
+    firstFrame = std::max(std::min(firstFrame, endFrame), 0);
+    int startFrame = firstFrame;
+    while (startFrame < endFrame && isFrameDone(startFrame))
+        ++startFrame;
+    if (!setupScene(job, startFrame))
+        return false;
+    if (!poses->seek(startFrame))
+    {
+        _err = "Cannot skip to pose " + std::to_string(startFrame + 1) + " of \"" + job.posesFile + "\"";
+        return false;
+    }
+
+    int auxOutputs = GetRenderedAuxOutputs(job);
+    if ((_renderer->getSupportedAuxOutputs() & auxOutputs) != auxOutputs)
+    {
+        _err = "The renderer cannot write the depth, ID or normal images of \"" + job.posesFile + "\"";
+        return false;
+    }
+    _renderer->setAuxOutputs(auxOutputs);
+    _auxQueue.clear();
+    _frameQueue.clear();
+    _renderer->setReadRegion(cv::Rect());
+    // Frames of the previous job are all written, so its settings can go.
+    // Variants draw the same noise stream, scaled to their variance
+    _postProcessors.resize(numVariants);
+    for (int i = 0; i < numVariants; ++i)
+    {
+        _postProcessors[i].setBlur(job.variants[i].blurSigma);
+        _postProcessors[i].setNoise(std::sqrt(std::max(job.variants[i].noiseVariance, 0.0)), job.backgroundSeed,
+                                    lineIndex);
+    }
+    _encoder.reset(OVFrameEncoder::Create(job.imageFormat, job.imageQuality));
+    if (!openSinks(job))
+        return false;
+
+    BatchProgress progress;
+    progress.job = &job;
+    progress.lineIndex = lineIndex;
+    progress.frameCount = num;
+    progress.resumedCount = 0;
+    for (int i = 0; i < num && _isJobManifestUsed; ++i)
+        progress.resumedCount += isFrameDone(i);
+
+    bool isStopped = false;
+    bool isFailed = false;
+    _frameEnds.clear();
+    _numReported = 0;
+
+    // Several poses per pass, read back together; passes have no auxiliary
+    // outputs, share one background and read whole frames
+    int posesPerPass = std::min(_posesPerPass, _renderer->getMaxPosesPerPass());
+    if (auxOutputs || _background.isAnimated() || job.cropMargin >= 0)
+        posesPerPass = 1;
+    cv::Rect frameRect(0, 0, OVRenderer::FrameWidth, OVRenderer::FrameHeight);
+    std::vector<Pose> passPoses;
+    std::vector<cv::Mat> images;
+    std::vector<int> passFrames;
+    while (!isStopped && !isFailed && posesPerPass > 1)
+    {
+        passPoses.clear();
+        passFrames.clear();
+        Pose pose;
+        while (passPoses.size() < posesPerPass && !isFailed)
+        {
+            isFailed = !skipFinishedFrames(*poses, endFrame);
+            int frameIndex = (int)poses->getPosition();
+            if (isFailed || frameIndex >= endFrame)
+                break;
+            isFailed = !poses->next(pose);
+            if (isFailed)
+            {
+                _err = poses->getError();
+                break;
+            }
+            passPoses.push_back(pose);
+            passFrames.push_back(frameIndex);
+        }
+        if (isFailed || passPoses.empty())
+            break;
+        // renderPoses keeps the pose, so the projections can come first
+        std::vector<Mat34> projections(passPoses.size());
+        for (int i = 0; i < passPoses.size() && job.isAnnotated; ++i)
+        {
+            _renderer->setPose(passPoses[i].R, passPoses[i].t);
+            projections[i] = _renderer->getImageProjection();
+        }
+        _renderer->renderPoses(passPoses, images);
+        for (int i = 0; i < passPoses.size() && !isStopped; ++i)
+        {
+            RenderedFrame rendered = { passFrames[i], passPoses[i], frameRect, projections[i] };
+            isStopped = !saveFrame(job, rendered, progress, images[i]);
+        }
+    }
+
+    // Otherwise frame i is read back while the following frames render, so
+    // frames are written out up to getReadbackQueueSize() - 1 frames behind
+    cv::Mat background;
+    while (!isStopped && !isFailed && posesPerPass <= 1)
+    {
+        if (!skipFinishedFrames(*poses, endFrame))
+        {
+            isFailed = true;
+            break;
+        }
+        int frameIndex = (int)poses->getPosition();
+        if (frameIndex >= endFrame)
+            break;
+
+        // The next background frame is normally decoded already
+        if (_background.isAnimated())
+        {
+            if (!_background.nextFrame(background))
+            {
+                _err = _background.getError();
+                isFailed = true;
+                break;
+            }
+            _renderer->setBackgroundImage(background);
+        }
+
+        Pose pose;
+        if (!poses->next(pose))
+        {
+            _err = poses->getError();
+            isFailed = true;
+            break;
+        }
+        // Only the model's part of a cropped frame is read back
+        _renderer->setPose(pose.R, pose.t);
+        RenderedFrame rendered = { frameIndex, pose, frameRect, _renderer->getImageProjection() };
+        if (job.cropMargin >= 0)
+            rendered.crop = _renderer->getModelRegion(job.cropMargin);
+        _renderer->setReadRegion(rendered.crop);
+        _renderer->render();
+        _renderer->queueReadPixels();
+        _frameQueue.push_back(rendered);
+        if (auxOutputs)
+        {
+            _auxQueue.push_back(AuxImages());
+            _renderer->readAuxPixels(_auxQueue.back());
+        }
+        if (_context)
+            _context->swapBuffers();
+
+        if (_renderer->getQueuedReadbackCount() >= _renderer->getReadbackQueueSize())
+            isStopped = !writeFrame(job, progress, isFailed);
+    }
+    while (_renderer->getQueuedReadbackCount() > 0)
+    {
+        if (isStopped)
+        {
+            cv::Mat image;
+            _renderer->collectPixels(image);
+            _auxQueue.clear();
+            _frameQueue.clear();
+        }
+        else
+            isStopped = !writeFrame(job, progress, isFailed);
+    }
+
+    // Wait for the frames still in the pipeline; after a stop they are dropped
+    while (!isStopped && !_frameEnds.empty())
+        isStopped = !reportProgress(progress, true);
+    if (isStopped)
+    {
+        _pipeline->cancel();
+        for (int i = 0; i < numVariants; ++i)
+            _sinks[i]->cancel();
+    }
+    _pipeline->waitAll();
+    _frameEnds.clear();
+
+    // Archives write their index and videos their last frames on close
+    _renderer->setReadRegion(cv::Rect());
+    _background.close();
+    std::string writeErr = _annotations.getError();
+    _annotations.close();
+    for (int i = 0; i < numVariants; ++i)
+    {
+        _manifests[i]->close();
+        if (writeErr.empty())
+            writeErr = _manifests[i]->getError();
+    }
+    bool isClosed = true;
+    for (int i = 0; i < numVariants; ++i)
+    {
+        isClosed = _sinks[i]->close() && isClosed;
+        if (writeErr.empty())
+            writeErr = _sinks[i]->getError();
+    }
+    if (_auxSinkOwner)
+    {
+        isClosed = _auxSinkOwner->close() && isClosed;
+        if (writeErr.empty())
+            writeErr = _auxSinkOwner->getError();
+    }
+
+    if (_pipeline->hasFailed() || !isClosed)
+    {
+        _err = writeErr.empty() ? "Cannot write the frames of \"" + job.posesFile + "\" to \"" + job.outputDir + "\""
+                                : writeErr;
+        return false;
+    }
+
+    if (isFailed)
+        return false;
+    if (isStopped)
+    {
+        _err = "Stopped";
+        return false;
+    }
+
+    return true;
+}
+
+bool
+OVBatchGenerator::openSinks(const BatchJob& job)
+{
+    FrameLayout layout;
+    layout.size = cv::Size(OVRenderer::FrameWidth, OVRenderer::FrameHeight);
+    layout.auxOutputs = job.auxOutputs;
+    layout.cameraMatrix = _renderer->getCameraMatrix();
+    layout.isCropped = (job.cropMargin >= 0);
+    _sinks.clear();
+    for (int i = 0; i < job.variants.size(); ++i)
+    {
+        RingSettings ring = job.ring;
+        if (job.variants.size() > 1)
+            ring.name += "_" + std::to_string(i);
+        _sinks.push_back(std::unique_ptr<OVFrameSink>(OVFrameSink::Create(job.container, _encoder.get(), job.video,
+                                                                          ring)));
+        if (!_sinks.back()->open(job.variants[i].outputDir, layout))
+        {
+            _err = _sinks.back()->getError();
+            return false;
+        }
+    }
+
+    // Next to the frames of a single variant; videos leave them as files,
+    // and every ring has them with its frames
+    _auxSinkOwner.reset();
+    _auxSink = _sinks[0].get();
+    if (job.auxOutputs && job.variants.size() > 1 && job.container != CONTAINER_RING)
+    {
+        FRAME_CONTAINER container = (job.container == CONTAINER_ARCHIVE) ? CONTAINER_ARCHIVE : CONTAINER_FILES;
+        _auxSinkOwner.reset(OVFrameSink::Create(container, _encoder.get(), job.video, job.ring));
+        _auxSink = _auxSinkOwner.get();
+        if (!_auxSink->open(job.outputDir, layout))
+        {
+            _err = _auxSink->getError();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+OVBatchGenerator::isFrameDone(int frameIndex) const
+{
+    if (!_isJobManifestUsed)
+        return false;
+    for (int i = 0; i < _manifests.size(); ++i)
+    {
+        if (!_manifests[i]->isDone(frameIndex))
+            return false;
+    }
+    return true;
+}
+
+bool
+OVBatchGenerator::skipFinishedFrames(OVPoseSource& poses, int endFrame)
+{
+    long long index = poses.getPosition();
+    for (; index < endFrame && isFrameDone((int)index); ++index)
+    {
+        // Backgrounds follow the frames, and random picks their order, so
+        // the skipped frames' backgrounds are still drawn
+        cv::Mat background;
+        if (_background.isAnimated() && !_background.nextFrame(background))
+        {
+            _err = _background.getError();
+            return false;
+        }
+    }
+    if (index != poses.getPosition() && !poses.seek(index))
+    {
+        _err = "Cannot skip to pose " + std::to_string(index + 1);
+        return false;
+    }
+    return true;
+}
+
+bool
+OVBatchGenerator::writeFrame(const BatchJob& job, BatchProgress& progress, bool& isFailed)
+{
+    // A new image each time, as the previous ones may still be in the pipeline
+    cv::Mat image;
+    bool isRead = _renderer->collectPixels(image);
+    RenderedFrame rendered = _frameQueue.front();
+    _frameQueue.pop_front();
+    if (!isRead)
+    {
+        _err = "Cannot read back frame " + std::to_string(rendered.frameIndex + 1);
+        isFailed = true;
+        return false;
+    }
+    if (_auxQueue.empty())
+        return saveFrame(job, rendered, progress, image);
+
+    AuxImages auxImages = _auxQueue.front();
+    _auxQueue.pop_front();
+    return saveFrame(job, rendered, progress, image, &auxImages);
+}
+
+bool
+OVBatchGenerator::saveFrame(const BatchJob& job, const RenderedFrame& rendered,
+                            BatchProgress& progress, cv::Mat& image, AuxImages* auxImages)
+{
+    int frameIndex = rendered.frameIndex;
+    // The variants share the rendered image, which post-processing reads
+    // without changing; the auxiliary images go with the first of them, or
+    // with every ring's frame
+    bool isRing = (job.container == CONTAINER_RING);
+    bool isAuxPending = (auxImages != NULL);
+    bool isAnnotationPending = job.isAnnotated;
+    for (int i = 0; i < job.variants.size(); ++i)
+    {
+        if (_isJobManifestUsed && _manifests[i]->isDone(frameIndex))
+            continue;
+        PipelineFrame frame;
+        frame.lineIndex = progress.lineIndex;
+        frame.variantIndex = i;
+        frame.frameIndex = frameIndex;
+        frame.pose = rendered.pose;
+        frame.crop = rendered.crop;
+        frame.job = &job;
+        frame.postProcessor = &_postProcessors[i];
+        frame.sink = _sinks[i].get();
+        frame.image = image;
+        frame.auxSink = NULL;
+        if (isAuxPending)
+        {
+            frame.auxSink = isRing ? frame.sink : _auxSink;
+            frame.auxImages = *auxImages;
+            isAuxPending = isRing;
+        }
+        frame.annotator = isAnnotationPending ? &_annotator : NULL;
+        frame.projection = rendered.projection;
+        isAnnotationPending = false;
+        _pipeline->submit(frame);
+    }
+    image.release();
+    _frameEnds.push_back(_pipeline->getSubmittedCount());
+
+    return reportProgress(progress, false);
+}
+
+bool
+OVBatchGenerator::reportProgress(BatchProgress& progress, bool isWaiting)
+{
+    if (_frameEnds.empty())
+        return true;
+    int numCompleted = isWaiting ? _pipeline->waitCompleted(_frameEnds.front() - 1)
+                                 : _pipeline->getCompletedCount();
+    while (!_frameEnds.empty() && _frameEnds.front() <= numCompleted)
+    {
+        _frameEnds.pop_front();
+        progress.frameIndex = progress.resumedCount + _numReported++;
+        if (_progressCallback && !_progressCallback(progress))
+            return false;
+    }
+    return true;
+}
+
+bool
+OVBatchGenerator::setupScene(const BatchJob& job, int startFrame)
+{
+    if (_context && !_context->makeCurrent())
+    {
+        _err = "Cannot make the OpenGL context current";
+        return false;
+    }
+
+    // 1. .OBJ model file, kept while jobs or shards share it
+    if (job.modelFile != _modelFile)
+    {
+        _modelFile.clear();
+        if (!_renderer->setForegroundObject(job.modelFile, false))
+        {
+            _err = "Cannot load \"" + job.modelFile + "\"";
+            return false;
+        }
+        _modelFile = job.modelFile;
+    }
+
+    // 2. Background image, image directory or video, of which the first
+    // frame sets the frame size; random backgrounds take the camera's size
+    bool isOpen;
+    if (job.isRandomBackground)
+    {
+        int w, h;
+        if (!OVRenderer::ReadCameraImageSize(job.cameraFile, w, h))
+        {
+            _err = "Cannot read the image size from \"" + job.cameraFile + "\"";
+            return false;
+        }
+        isOpen = _background.openPool(job.imageFile, job.backgroundSeed,
+                                      (size_t)job.backgroundCacheSize << 20, cv::Size(w, h), startFrame);
+    }
+    else
+        isOpen = _background.open(job.imageFile, startFrame);
+    if (!isOpen)
+    {
+        _err = _background.getError();
+        return false;
+    }
+    _renderer->setBackgroundImage(_background.getFirstFrame());
+
+    // 3. Camera parameter file
+    if (!_renderer->readCameraParameters(job.cameraFile))
+    {
+        _err = "Cannot read \"" + job.cameraFile + "\"";
+        return false;
+    }
+
+    int w = OVRenderer::FrameWidth;
+    int h = OVRenderer::FrameHeight;
+    if (_context && !_context->resize(w, h))
+    {
+        _err = "Cannot resize the drawable to " + std::to_string(w) + "x" + std::to_string(h);
+        return false;
+    }
+    _renderer->setViewport(w, h);
+    if (_frameSizeCallback)
+        _frameSizeCallback(w, h);
+
+    // 4. Keypoints file, in the model's coordinates
+    if (job.isAnnotated)
+    {
+        Mat3Xf keypoints;
+        if (!job.keypointsFile.empty() && !OVFrameAnnotator::LoadKeypoints(job.keypointsFile, keypoints, _err))
+            return false;
+        _annotator.setScene(_renderer->getModelVertices(), keypoints, cv::Size(w, h));
+    }
+
+    return true;
+}
+
+void
+OVBatchGenerator::processImage(PipelineFrame& frame)
+{
+    // A depth image rendered for the keypoints alone is not written
+    if (frame.annotator)
+    {
+        frame.annotation = frame.annotator->annotate(frame.frameIndex, frame.projection, frame.auxImages.depth,
+                                                     frame.crop);
+        if (!(frame.job->auxOutputs & AUX_DEPTH))
+            frame.auxImages.depth.release();
+        if (!frame.job->auxOutputs)
+            frame.auxSink = NULL;
+    }
+    if (!frame.postProcessor->isActive())
+        return;
+
+    // Bands of the frame run on the shared pool alongside the other frames
+    cv::Mat image;
+    frame.postProcessor->apply(frame.image, image, frame.frameIndex, OVThreadPool::Global());
+    frame.image = image;
+}
+
+bool
+OVBatchGenerator::writeImages(const PipelineFrame& frame)
+{
+    auto startTime = std::chrono::steady_clock::now();
+    size_t numBytes;
+    if (!frame.sink->writeImage(frame, numBytes))
+        return false;
+    auto duration = std::chrono::steady_clock::now() - startTime;
+    ++_numEncoded;
+    _numEncodedRawBytes += (long long)frame.image.total() * frame.image.elemSize();
+    _numEncodedBytes += numBytes;
+    _encodeNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+
+    // All before the frame is listed in the manifest
+    bool isOk = !frame.auxSink || frame.auxSink->writeAuxImages(frame);
+    if (isOk && _annotations.isOpen() && !frame.annotation.empty())
+        isOk = _annotations.add(frame.annotation);
+    cv::Rect crop = (frame.job->cropMargin >= 0) ? frame.crop : cv::Rect();
+    if (!isOk ||
+        (_isJobManifestUsed && !_manifests[frame.variantIndex]->add(frame.frameIndex, (long long)numBytes, crop)))
+        return false;
+    return !_frameWrittenCallback ||
+           _frameWrittenCallback(frame.lineIndex, frame.variantIndex, frame.frameIndex, (long long)numBytes, crop,
+                                 frame.annotation);
+}
+
+} // namespace ov
@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include "OVBatchCoordinator.h"
+#include "OVFileUtil.h"
+#include "OVPoseSource.h"
+
+namespace ov
+{
+
+bool
+OVBatchCoordinator::RunWorker(OVBatchGenerator& generator, const std::string& batchFile, std::string& err)
+{
+    // Written frames are reported from the encoding threads; standard
+    // output carries nothing but messages
+    std::mutex outputMutex;
+    generator.setFrameWrittenCallback([&outputMutex](int lineIndex, int variantIndex, int frameIndex,
+                                                     long long numBytes, const cv::Rect& crop,
+                                                     const std::string& annotation)
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        return printf("frame %d %d %d %lld %d %d %d %d%s%s\n", lineIndex, variantIndex, frameIndex, numBytes, crop.x,
+                      crop.y, crop.width, crop.height, annotation.empty() ? "" : " ", annotation.c_str()) > 0 &&
+               fflush(stdout) == 0;
+    });
+    if (!generator.begin(batchFile))
+    {
+        err = generator.getError();
+        printf("error %s\n", err.c_str());
+        fflush(stdout);
+        return false;
+    }
+    printf("ready\n");
+    fflush(stdout);
+
+    bool isOk = true;
+    char command[256];
+    while (isOk && fgets(command, sizeof(command), stdin))
+    {
+        Shard shard;
+        if (sscanf(command, "shard %d %d %d", &shard.lineIndex, &shard.firstFrame, &shard.endFrame) != 3)
+        {
+            err = "Unknown command \"" + std::string(command) + "\"";
+            isOk = false;
+        }
+        else
+            isOk = generator.runFrames(shard.lineIndex, shard.firstFrame, shard.endFrame);
+        if (!isOk && err.empty())
+            err = generator.getError();
+
+        std::lock_guard<std::mutex> lock(outputMutex);
+        if (isOk)
+            printf("done\n");
+        else
+            printf("error %s\n", err.c_str());
+        fflush(stdout);
+    }
+    generator.end();
+    return isOk;
+}
+
+OVBatchCoordinator::OVBatchCoordinator()
+{
+    _numWorkers = 0;
+    _lineCursor = 0;
+    _numPending = 0;
+    _numWritten = 0;
+    _isStopped = false;
+}
+
+bool
+OVBatchCoordinator::run(const std::string& batchFile, const std::vector<std::string>& workerCommand, int numWorkers)
+{
+    std::vector<BatchJob> jobs;
+    if (!LoadBatchFile(batchFile, jobs, _err))
+        return false;
+
+    // Frames left in every line, after those of earlier runs
+    _lines.clear();
+    _lines.resize(jobs.size());
+    _lineCursor = 0;
+    _numPending = 0;
+    _numWritten = 0;
+    _isStopped = false;
+    for (int i = 0; i < jobs.size(); ++i)
+    {
+        // Workers cannot append to one archive or video, or share a ring
+        if (jobs[i].container != CONTAINER_FILES)
+        {
+            _err = "Line " + std::to_string(i + 1) + " writes " +
+                   OVFrameSink::GetContainerName(jobs[i].container) + " output, which workers cannot share";
+            return false;
+        }
+        Line& line = _lines[i];
+        std::unique_ptr<OVPoseSource> poses(OVPoseSource::Open(jobs[i].posesFile, _err));
+        if (!poses)
+            return false;
+        line.job = jobs[i];
+        line.frameCount = (int)poses->getCount();
+        line.nextFrame = 0;
+        if (!IsDirectoryExists(line.job.outputDir))
+            CreateDirectorys(line.job.outputDir);
+        int numVariants = (int)line.job.variants.size();
+        line.isVariantDone.assign((size_t)line.frameCount * numVariants, 0);
+        line.numMissing.assign(line.frameCount, numVariants);
+        for (int j = 0; j < numVariants; ++j)
+        {
+            line.manifests.push_back(std::unique_ptr<OVBatchManifest>(new OVBatchManifest()));
+            if (!OpenBatchManifest(line.job, j, line.frameCount, *line.manifests[j], _err))
+                return false;
+            for (int k = 0; k < line.frameCount; ++k)
+            {
+                line.isVariantDone[(size_t)k * numVariants + j] = line.manifests[j]->isDone(k);
+                line.numMissing[k] -= line.manifests[j]->isDone(k);
+            }
+        }
+        line.numResumed = (int)std::count(line.numMissing.begin(), line.numMissing.end(), 0);
+        if (line.job.isAnnotated)
+        {
+            bool isResumed = false;
+            for (int j = 0; j < numVariants; ++j)
+                isResumed = isResumed || line.manifests[j]->getResumedCount() > 0;
+            line.annotations.reset(new OVAnnotationFile());
+            if (!line.annotations->open(line.job.outputDir, isResumed))
+            {
+                _err = line.annotations->getError();
+                return false;
+            }
+        }
+        line.numDone = line.numResumed;
+        _numPending += line.frameCount - line.numResumed;
+    }
+    if (_numPending == 0)
+        return true;
+
+    // No more workers than the smallest shards keep busy
+    _numWorkers = (int)std::max(std::min((long long)numWorkers, (_numPending + MinShardSize - 1) / MinShardSize), 1LL);
+    std::vector<std::unique_ptr<OVChildProcess> > workers;
+    for (int i = 0; i < _numWorkers; ++i)
+    {
+        workers.push_back(std::unique_ptr<OVChildProcess>(new OVChildProcess()));
+        if (!workers.back()->start(workerCommand))
+        {
+            _err = "Cannot start \"" + workerCommand[0] + "\"";
+            return false;
+        }
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < _numWorkers; ++i)
+        threads.push_back(std::thread(&OVBatchCoordinator::serveWorker, this, std::ref(*workers[i]), i));
+    for (int i = 0; i < _numWorkers; ++i)
+        threads[i].join();
+    for (int i = 0; i < _numWorkers; ++i)
+    {
+        int exitCode = workers[i]->wait();
+        if (exitCode != 0 && _err.empty())
+            _err = "Worker " + std::to_string(i + 1) + " exited with code " + std::to_string(exitCode);
+    }
+    for (int i = 0; i < _lines.size(); ++i)
+    {
+        for (int j = 0; j < _lines[i].manifests.size(); ++j)
+            _lines[i].manifests[j]->close();
+        if (_lines[i].annotations)
+            _lines[i].annotations->close();
+    }
+
+    return _err.empty() && !_isStopped;
+}
+
+bool
+OVBatchCoordinator::nextShard(Shard& shard)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    while (!_isStopped && _lineCursor < _lines.size())
+    {
+        Line& line = _lines[_lineCursor];
+        while (line.nextFrame < line.frameCount && line.isDone(line.nextFrame))
+            ++line.nextFrame;
+        if (line.nextFrame >= line.frameCount)
+        {
+            ++_lineCursor;
+            continue;
+        }
+
+        // Up to the next finished frame, which the worker would skip anyway
+        long long size = std::min(std::max(_numPending / (2 * _numWorkers), (long long)MinShardSize),
+                                  (long long)MaxShardSize);
+        shard.lineIndex = _lineCursor;
+        shard.firstFrame = line.nextFrame;
+        shard.endFrame = (int)std::min((long long)line.frameCount, shard.firstFrame + size);
+        for (int i = shard.firstFrame + 1; i < shard.endFrame; ++i)
+        {
+            if (line.isDone(i))
+            {
+                shard.endFrame = i;
+                break;
+            }
+        }
+        line.nextFrame = shard.endFrame;
+        _numPending -= shard.endFrame - shard.firstFrame;
+        return true;
+    }
+    return false;
+}
+
+void
+OVBatchCoordinator::serveWorker(OVChildProcess& worker, int workerIndex)
+{
+    std::string workerName = "Worker " + std::to_string(workerIndex + 1);
+    std::string message;
+    if (!worker.readLine(message) || message != "ready")
+    {
+        fail(message.compare(0, 6, "error ") == 0 ? message.substr(6) : workerName + " did not start");
+        return;
+    }
+
+    Shard shard;
+    while (nextShard(shard))
+    {
+        char command[64];
+        snprintf(command, sizeof(command), "shard %d %d %d", shard.lineIndex, shard.firstFrame, shard.endFrame);
+        if (!worker.writeLine(command))
+        {
+            fail(workerName + " exited");
+            return;
+        }
+
+        // The frames of the shard as they are written, then its end
+        while (true)
+        {
+            if (!worker.readLine(message))
+            {
+                fail(workerName + " exited");
+                return;
+            }
+            if (message == "done")
+                break;
+            if (message.compare(0, 6, "error ") == 0)
+            {
+                fail(message.substr(6));
+                return;
+            }
+            if (!addFrame(message))
+                return;
+        }
+    }
+}
+
+bool
+OVBatchCoordinator::addFrame(const std::string& message)
+{
+    int lineIndex, variantIndex, frameIndex;
+    long long numBytes;
+    cv::Rect crop;
+    int annotationStart = 0;
+    if (sscanf(message.c_str(), "frame %d %d %d %lld %d %d %d %d %n", &lineIndex, &variantIndex, &frameIndex,
+               &numBytes, &crop.x, &crop.y, &crop.width, &crop.height, &annotationStart) != 8 ||
+        lineIndex < 0 || lineIndex >= _lines.size() || variantIndex < 0 ||
+        variantIndex >= _lines[lineIndex].manifests.size() || frameIndex < 0 ||
+        frameIndex >= _lines[lineIndex].frameCount)
+    {
+        fail("Unexpected message \"" + message + "\" from a worker");
+        return false;
+    }
+
+    // The annotation before the manifest entry, as the generator writes them
+    Line& line = _lines[lineIndex];
+    if (annotationStart > 0 && annotationStart < message.size() && line.annotations &&
+        !line.annotations->add(message.substr(annotationStart)))
+    {
+        fail(line.annotations->getError());
+        return false;
+    }
+    OVBatchManifest& manifest = *line.manifests[variantIndex];
+    if (!manifest.add(frameIndex, numBytes, crop))
+    {
+        fail(manifest.getError());
+        return false;
+    }
+
+    // A frame counts once all its variants are written; workers rewrite
+    // the variants a resumed frame already had
+    std::lock_guard<std::mutex> lock(_mutex);
+    char& isVariantDone = line.isVariantDone[(size_t)frameIndex * line.manifests.size() + variantIndex];
+    if (isVariantDone)
+        return true;
+    isVariantDone = 1;
+    if (--line.numMissing[frameIndex] > 0)
+        return true;
+    ++_numWritten;
+    BatchProgress progress;
+    progress.job = &line.job;
+    progress.lineIndex = lineIndex;
+    progress.frameIndex = line.numDone++;
+    progress.frameCount = line.frameCount;
+    progress.resumedCount = line.numResumed;
+    // Stopping lets the workers finish their shards
+    if (_progressCallback && !_progressCallback(progress) && _err.empty())
+    {
+        _err = "Stopped";
+        _isStopped = true;
+    }
+    return true;
+}
+
+void
+OVBatchCoordinator::fail(const std::string& err)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_err.empty())
+        _err = err;
+    _isStopped = true;
+}
+
+} // namespace ov
@@ -0,0 +1,133 @@
+#include <cstdlib>
+#include <cstring>
+#include "OVBatchManifest.h"
+#include "OVMappedFile.h"
+
+namespace ov
+{
+
+const char* const OVBatchManifest::FileName = "manifest.txt";
+
+namespace
+{
+
+const char ManifestHeader[] = "ovmanifest 1\n";
+
+} // namespace
+
+OVBatchManifest::OVBatchManifest()
+{
+    _file = NULL;
+    _numResumed = 0;
+    _isOpen = false;
+}
+
+OVBatchManifest::~OVBatchManifest()
+{
+    close();
+}
+
+bool
+OVBatchManifest::open(const std::string& outputDir, const std::string& parameters, int frameCount,
+                      const FrameValidator& isValid)
+{
+    close();
+    _fileName = outputDir + FileName;
+    _err.clear();
+    _isDone.assign(frameCount, 0);
+    _numResumed = 0;
+
+    // The size of every frame's last entry; lines cut short by a crash are ignored
+    OVMappedFile previous;
+    std::string paramsLine = "params " + parameters + "\n";
+    size_t headerSize = strlen(ManifestHeader) + paramsLine.size();
+    bool isSameJob = previous.open(_fileName, true) && previous.getSize() >= headerSize &&
+                     memcmp(previous.getData(), ManifestHeader, strlen(ManifestHeader)) == 0 &&
+                     memcmp(previous.getData() + strlen(ManifestHeader), paramsLine.data(), paramsLine.size()) == 0;
+    if (!isSameJob)
+    {
+        previous.close();
+        return create(parameters);
+    }
+
+    std::vector<long long> frameBytes(frameCount, -1);
+    const char* end = previous.getData() + previous.getSize();
+    bool isLastLineComplete = true;
+    for (const char* p = previous.getData() + headerSize; p < end; )
+    {
+        const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+        if (!lineEnd)
+        {
+            isLastLineComplete = false;
+            break;
+        }
+        int frameIndex;
+        long long numBytes;
+        std::string line(p, lineEnd);
+        if (sscanf(line.c_str(), "frame %d %lld", &frameIndex, &numBytes) == 2 && frameIndex >= 0 &&
+            frameIndex < frameCount)
+            frameBytes[frameIndex] = numBytes;
+        p = lineEnd + 1;
+    }
+    previous.close();
+
+    for (int i = 0; i < frameCount; ++i)
+    {
+        _isDone[i] = (frameBytes[i] >= 0 && isValid(i, frameBytes[i]));
+        _numResumed += _isDone[i];
+    }
+
+    _file = fopen(_fileName.c_str(), "ab");
+    if (!_file)
+    {
+        _err = "Cannot open \"" + _fileName + "\"";
+        return false;
+    }
+    // Finish a torn last line, so it does not swallow the next entry
+    if (!isLastLineComplete)
+        fputc('\n', _file);
+    _isOpen = true;
+    return true;
+}
+
+bool
+OVBatchManifest::create(const std::string& parameters)
+{
+    _file = fopen(_fileName.c_str(), "wb");
+    if (!_file || fprintf(_file, "%sparams %s\n", ManifestHeader, parameters.c_str()) < 0 || fflush(_file) != 0)
+    {
+        _err = "Cannot create \"" + _fileName + "\"";
+        close();
+        return false;
+    }
+    _isOpen = true;
+    return true;
+}
+
+void
+OVBatchManifest::close()
+{
+    if (_file)
+        fclose(_file);
+    _file = NULL;
+    _isOpen = false;
+}
+
+bool
+OVBatchManifest::add(int frameIndex, long long numBytes, const cv::Rect& crop)
+{
+    char cropText[64] = "";
+    if (!crop.empty())
+        snprintf(cropText, sizeof(cropText), " %d %d %d %d", crop.x, crop.y, crop.width, crop.height);
+
+    // Flushed line by line, so the entries of a killed process survive it
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_file || fprintf(_file, "frame %d %lld%s\n", frameIndex, numBytes, cropText) < 0 || fflush(_file) != 0)
+    {
+        _err = "Cannot write \"" + _fileName + "\"";
+        return false;
+    }
+    return true;
+}
+
+} // namespace ov
@@ -0,0 +1,228 @@
+#ifdef _WIN32
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include "OVChildProcess.h"
+
+namespace ov
+{
+
+namespace
+{
+
+#ifdef _WIN32
+// Quoted as CommandLineToArgvW splits it
+std::string
+QuoteArgument(const std::string& arg)
+{
+    if (!arg.empty() && arg.find_first_of(" \t\"") == std::string::npos)
+        return arg;
+    std::string quoted = "\"";
+    int numBackslashes = 0;
+    for (size_t i = 0; i < arg.size(); ++i)
+    {
+        if (arg[i] == '\\')
+        {
+            ++numBackslashes;
+            continue;
+        }
+        // Backslashes before a quote escape, others are literal
+        quoted.append(arg[i] == '"' ? numBackslashes * 2 + 1 : numBackslashes, '\\');
+        quoted += arg[i];
+        numBackslashes = 0;
+    }
+    quoted.append(numBackslashes * 2, '\\');
+    return quoted + "\"";
+}
+#endif
+
+} // namespace
+
+OVChildProcess::OVChildProcess()
+{
+    _input = NULL;
+    _output = NULL;
+#ifdef _WIN32
+    _process = NULL;
+#else
+    _pid = -1;
+#endif
+}
+
+OVChildProcess::~OVChildProcess()
+{
+    wait();
+}
+
+std::string
+OVChildProcess::GetExecutablePath(const char* argv0)
+{
+#ifdef _WIN32
+    char path[MAX_PATH];
+    DWORD length = GetModuleFileNameA(NULL, path, MAX_PATH);
+    if (length > 0 && length < MAX_PATH)
+        return std::string(path, length);
+#else
+    char path[4096];
+    ssize_t length = readlink("/proc/self/exe", path, sizeof(path));
+    if (length > 0 && length < (ssize_t)sizeof(path))
+        return std::string(path, length);
+#endif
+    return argv0;
+}
+
+bool
+OVChildProcess::start(const std::vector<std::string>& args)
+{
+    wait();
+
+#ifdef _WIN32
+    // Inheritable pipe ends for the child, private ones for this process
+    SECURITY_ATTRIBUTES security = { sizeof(security), NULL, TRUE };
+    HANDLE childInput, parentInput, parentOutput, childOutput;
+    if (!CreatePipe(&childInput, &parentInput, &security, 0))
+        return false;
+    if (!CreatePipe(&parentOutput, &childOutput, &security, 0))
+    {
+        CloseHandle(childInput);
+        CloseHandle(parentInput);
+        return false;
+    }
+    SetHandleInformation(parentInput, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(parentOutput, HANDLE_FLAG_INHERIT, 0);
+
+    std::string commandLine;
+    for (size_t i = 0; i < args.size(); ++i)
+        commandLine += (i > 0 ? " " : "") + QuoteArgument(args[i]);
+    STARTUPINFOA startup = {};
+    startup.cb = sizeof(startup);
+    startup.dwFlags = STARTF_USESTDHANDLES;
+    startup.hStdInput = childInput;
+    startup.hStdOutput = childOutput;
+    startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    PROCESS_INFORMATION info;
+    BOOL isStarted = CreateProcessA(args[0].c_str(), &commandLine[0], NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL,
+                                    NULL, &startup, &info);
+    CloseHandle(childInput);
+    CloseHandle(childOutput);
+    if (!isStarted)
+    {
+        CloseHandle(parentInput);
+        CloseHandle(parentOutput);
+        return false;
+    }
+    CloseHandle(info.hThread);
+    _process = info.hProcess;
+    _input = _fdopen(_open_osfhandle((intptr_t)parentInput, 0), "wb");
+    _output = _fdopen(_open_osfhandle((intptr_t)parentOutput, _O_RDONLY), "rb");
+#else
+    // A child that exits early must fail writeLine, not kill this process
+    signal(SIGPIPE, SIG_IGN);
+
+    int inputPipe[2], outputPipe[2];
+    if (pipe(inputPipe) != 0)
+        return false;
+    if (pipe(outputPipe) != 0)
+    {
+        close(inputPipe[0]);
+        close(inputPipe[1]);
+        return false;
+    }
+
+    // This process's ends must not leak into later children, which would
+    // keep a pipe open after this child's end of it is closed
+    fcntl(inputPipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl(outputPipe[0], F_SETFD, FD_CLOEXEC);
+
+    std::vector<char*> argv;
+    for (size_t i = 0; i < args.size(); ++i)
+        argv.push_back((char*)args[i].c_str());
+    argv.push_back(NULL);
+
+    _pid = fork();
+    if (_pid == 0)
+    {
+        dup2(inputPipe[0], STDIN_FILENO);
+        dup2(outputPipe[1], STDOUT_FILENO);
+        close(inputPipe[0]);
+        close(inputPipe[1]);
+        close(outputPipe[0]);
+        close(outputPipe[1]);
+        execv(argv[0], &argv[0]);
+        _exit(127);
+    }
+    close(inputPipe[0]);
+    close(outputPipe[1]);
+    if (_pid < 0)
+    {
+        close(inputPipe[1]);
+        close(outputPipe[0]);
+        return false;
+    }
+    _input = fdopen(inputPipe[1], "w");
+    _output = fdopen(outputPipe[0], "r");
+#endif
+    return _input && _output;
+}
+
+bool
+OVChildProcess::writeLine(const std::string& line)
+{
+    return _input && fprintf(_input, "%s\n", line.c_str()) >= 0 && fflush(_input) == 0;
+}
+
+bool
+OVChildProcess::readLine(std::string& line)
+{
+    line.clear();
+    if (!_output)
+        return false;
+    int c;
+    while ((c = fgetc(_output)) != EOF && c != '\n')
+        line += (char)c;
+    if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+    return c != EOF || !line.empty();
+}
+
+int
+OVChildProcess::wait()
+{
+    // A child reading commands exits at the end of its input
+    if (_input)
+        fclose(_input);
+    _input = NULL;
+    if (_output)
+        fclose(_output);
+    _output = NULL;
+
+    int exitCode = -1;
+#ifdef _WIN32
+    if (_process)
+    {
+        DWORD code;
+        WaitForSingleObject(_process, INFINITE);
+        if (GetExitCodeProcess(_process, &code))
+            exitCode = (int)code;
+        CloseHandle(_process);
+    }
+    _process = NULL;
+#else
+    if (_pid > 0)
+    {
+        int status;
+        if (waitpid(_pid, &status, 0) == _pid && WIFEXITED(status))
+            exitCode = WEXITSTATUS(status);
+    }
+    _pid = -1;
+#endif
+    return exitCode;
+}
+
+} // namespace ov
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include "OVDrawList.h"
+
+namespace ov
+{
+
+namespace
+{
+
+struct FaceKey
+{
+    bool         isTransparent;
+    unsigned int textureId;
+    int          materialId;
+    unsigned int firstIndex;    // First merged index of the face
+};
+
+bool
+operator<(const FaceKey& a, const FaceKey& b)
+{
+    // Opaque faces first, then the texture (the expensive rebind), then the material
+    if (a.isTransparent != b.isTransparent)
+        return !a.isTransparent;
+    if (a.textureId != b.textureId)
+        return a.textureId < b.textureId;
+    return a.materialId < b.materialId;
+}
+
+} // namespace
+
+OVDrawList::OVDrawList()
+{
+    clear();
+}
+
+void
+OVDrawList::clear()
+{
+    _positions.clear();
+    _normals.clear();
+    _texcoords.clear();
+    _shapeIds.clear();
+    _indices.clear();
+    _batches.clear();
+    _stats.batchCount = 0;
+    _stats.stateChangeCount = 0;
+    _stats.unsortedStateChangeCount = 0;
+    _stats.triangleCount = 0;
+    _stats.vertexCount = 0;
+}
+
+void
+OVDrawList::build(const std::vector<tinyobj::shape_t>& shapes,
+                  const std::vector<tinyobj::material_t>& materials,
+                  const std::unordered_map<std::string, unsigned int>& textureIds)
+{
+    clear();
+
+    size_t numVertices = 0, numIndices = 0;
+    for (int i = 0; i < shapes.size(); ++i)
+    {
+        numVertices += shapes[i].mesh.positions.size() / 3;
+        numIndices += shapes[i].mesh.indices.size();
+    }
+    _positions.reserve(3 * numVertices);
+    _normals.reserve(3 * numVertices);
+    _texcoords.reserve(2 * numVertices);
+    _shapeIds.reserve(numVertices);
+
+    // Append the vertices of every shape and collect its faces with merged indices
+    std::vector<unsigned int> mergedIndices;
+    std::vector<FaceKey> faces;
+    mergedIndices.reserve(numIndices);
+    faces.reserve(numIndices / 3);
+    int preMaterialId = -2;
+    unsigned int preTextureId = 0;
+    for (int i = 0; i < shapes.size(); ++i)
+    {
+        const tinyobj::mesh_t& mesh = shapes[i].mesh;
+        unsigned int base = (unsigned int)(_positions.size() / 3);
+        size_t n = mesh.positions.size() / 3;
+
+        _positions.insert(_positions.end(), mesh.positions.begin(), mesh.positions.end());
+        if (mesh.normals.size() == 3 * n)
+            _normals.insert(_normals.end(), mesh.normals.begin(), mesh.normals.end());
+        else
+            _normals.resize(_normals.size() + 3 * n, 0.0f);
+        if (mesh.texcoords.size() == 2 * n)
+            _texcoords.insert(_texcoords.end(), mesh.texcoords.begin(), mesh.texcoords.end());
+        else
+            _texcoords.resize(_texcoords.size() + 2 * n, 0.0f);
+        _shapeIds.resize(_shapeIds.size() + n, (unsigned int)i);
+
+        for (int f = 0; f < mesh.indices.size() / 3; ++f)
+        {
+            FaceKey key;
+            key.materialId = (f < mesh.material_ids.size()) ? mesh.material_ids[f] : -1;
+            if (key.materialId < 0 || key.materialId >= materials.size())
+                key.materialId = -1;
+            key.textureId = 0;
+            key.isTransparent = false;
+            if (key.materialId >= 0)
+            {
+                auto got = textureIds.find(materials[key.materialId].diffuse_texname);
+                if (got != textureIds.end())
+                    key.textureId = got->second;
+                key.isTransparent = materials[key.materialId].dissolve < 1.0f;
+            }
+            key.firstIndex = (unsigned int)mergedIndices.size();
+            for (int j = 0; j < 3; ++j)
+                mergedIndices.push_back(base + mesh.indices[3 * f + j]);
+            faces.push_back(key);
+
+            // What drawing the faces in file order would cost
+            if (key.materialId != preMaterialId)
+            {
+                ++_stats.unsortedStateChangeCount;
+                if (key.textureId != preTextureId)
+                    ++_stats.unsortedStateChangeCount;
+                preMaterialId = key.materialId;
+                preTextureId = key.textureId;
+            }
+        }
+    }
+
+    // Keep the file order inside a batch
+    std::stable_sort(faces.begin(), faces.end());
+
+    _indices.reserve(mergedIndices.size());
+    for (int k = 0; k < faces.size(); ++k)
+    {
+        const FaceKey& face = faces[k];
+        if (_batches.empty()
+            || _batches.back().materialId != face.materialId
+            || _batches.back().textureId != face.textureId
+            || _batches.back().isTransparent != face.isTransparent)
+        {
+            DrawBatch batch;
+            batch.materialId = face.materialId;
+            batch.textureId = face.textureId;
+            batch.isTransparent = face.isTransparent;
+            batch.firstIndex = (unsigned int)_indices.size();
+            batch.indexCount = 0;
+
+            ++_stats.stateChangeCount;
+            if (_batches.empty() ? batch.textureId != 0 : batch.textureId != _batches.back().textureId)
+                ++_stats.stateChangeCount;
+            _batches.push_back(batch);
+        }
+        _indices.push_back(mergedIndices[face.firstIndex + 0]);
+        _indices.push_back(mergedIndices[face.firstIndex + 1]);
+        _indices.push_back(mergedIndices[face.firstIndex + 2]);
+        _batches.back().indexCount += 3;
+    }
+
+    _stats.batchCount = (int)_batches.size();
+    _stats.triangleCount = (int)(_indices.size() / 3);
+    _stats.vertexCount = (int)(_positions.size() / 3);
+}
+
+} // namespace ov
@@ -0,0 +1,187 @@
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <stack>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "OVFileUtil.h"
+
+namespace ov
+{
+
+std::string
+GetFileName(const std::string& s)
+{
+    char sep1 = '/', sep2 = '\\';
+
+    size_t i = s.rfind(sep1, s.length());
+    size_t j = s.rfind(sep2, s.length());
+
+    if (i != std::string::npos)
+        return(s.substr(i + 1, s.length() - i));
+    else if (j != std::string::npos)
+        return(s.substr(j + 1, s.length() - j));
+    else
+        return("");
+}
+
+std::string
+GetBaseName(const std::string& s)
+{
+    char sep = '.';
+    size_t i = s.rfind(sep, s.length());
+
+    if (i != std::string::npos)
+        return(s.substr(0, i));
+    else
+        return("");
+}
+
+std::string
+GetExt(const std::string& s)
+{
+    char sep = '.';
+
+    size_t i = s.rfind(sep, s.length());
+
+    if (i != std::string::npos)
+        return(s.substr(i + 1, s.length() - i));
+    else
+        return("");
+}
+
+std::string
+GetDir(const std::string& s)
+{
+    char sep1 = '/', sep2 = '\\';
+
+    size_t i = s.rfind(sep1, s.length());
+    size_t j = s.rfind(sep2, s.length());
+
+    if (i != std::string::npos)
+        return(s.substr(0, i + 1));
+    else if (j != std::string::npos)
+        return(s.substr(0, j + 1));
+    else
+        return("");
+}
+
+std::string
+ZeroPadNumber(int num, int width)
+{
+    std::ostringstream ss;
+    ss << std::setw(width) << std::setfill('0') << num;
+    return ss.str();
+}
+
+bool
+IsDirectoryExists(std::string dirName)
+{
+#ifdef _WIN32
+    DWORD attribs = ::GetFileAttributes(std::wstring(dirName.begin(), dirName.end()).c_str());
+    if (attribs == INVALID_FILE_ATTRIBUTES)
+        return false;
+    return (attribs & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+    struct stat info;
+    if (stat(dirName.c_str(), &info) != 0)
+        return false;
+    return S_ISDIR(info.st_mode);
+#endif
+}
+
+void
+CreateDirectorys(std::string path)
+{
+    std::string dir = GetDir(path);
+    std::stack<std::string> dirQueue;
+    while (!IsDirectoryExists(dir)&& !dir.empty())
+    {
+        dirQueue.push(dir);
+        dir.resize(dir.size() - 1);
+        dir = GetDir(dir);
+    }
+    while (!dirQueue.empty())
+    {
+        dir = dirQueue.top();
+        dirQueue.pop();
+#ifdef _WIN32
+        CreateDirectory(std::wstring(dir.begin(), dir.end()).c_str(), NULL);
+#else
+        mkdir(dir.c_str(), 0755);
+#endif
+    }
+}
+
+long long
+GetFileLength(const std::string& fileName)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!::GetFileAttributesEx(std::wstring(fileName.begin(), fileName.end()).c_str(), GetFileExInfoStandard, &info) ||
+        (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        return -1;
+    return ((long long)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+#else
+    struct stat info;
+    if (stat(fileName.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+        return -1;
+    return (long long)info.st_size;
+#endif
+}
+
+bool
+RenameFile(const std::string& from, const std::string& to)
+{
+#ifdef _WIN32
+    // rename fails on Windows when the target exists
+    return ::MoveFileEx(std::wstring(from.begin(), from.end()).c_str(), std::wstring(to.begin(), to.end()).c_str(),
+                        MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+bool
+TruncateFile(const std::string& fileName, long long length)
+{
+#ifdef _WIN32
+    HANDLE file = ::CreateFile(std::wstring(fileName.begin(), fileName.end()).c_str(), GENERIC_WRITE, 0, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER position;
+    position.QuadPart = length;
+    bool isOk = ::SetFilePointerEx(file, position, NULL, FILE_BEGIN) && ::SetEndOfFile(file);
+    ::CloseHandle(file);
+    return isOk;
+#else
+    return truncate(fileName.c_str(), (off_t)length) == 0;
+#endif
+}
+
+static void
+PrintErrorToStderr(const std::string& msg)
+{
+    fprintf(stderr, "Error: %s\n", msg.c_str());
+}
+
+static ErrorHandler errorHandler = PrintErrorToStderr;
+
+void
+SetErrorHandler(ErrorHandler handler)
+{
+    errorHandler = handler ? handler : PrintErrorToStderr;
+}
+
+void
+ReportError(const std::string& msg)
+{
+    errorHandler(msg);
+}
+
+} // namespace ov
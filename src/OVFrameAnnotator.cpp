@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include "OVFrameAnnotator.h"
+#include "OVRenderer.h"
+
+namespace ov
+{
+
+const float OVFrameAnnotator::DepthTolerance = 0.01f;
+const char* const OVAnnotationFile::FileName = "annotations.jsonl";
+
+namespace
+{
+
+typedef Eigen::Array<float, 1, Eigen::Dynamic> RowArrayXf;
+
+// Vertices projected at a time, few enough to stay in the cache
+const Eigen::Index VertexBlockSize = 4096;
+
+void
+AppendNumber(std::string& line, float value)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%.2f", value);
+    line += text;
+}
+
+} // namespace
+
+bool
+OVFrameAnnotator::LoadKeypoints(const std::string& fileName, Mat3Xf& keypoints, std::string& err)
+{
+    std::ifstream file(fileName);
+    if (!file.is_open())
+    {
+        err = "Cannot open \"" + fileName + "\"";
+        return false;
+    }
+    std::vector<float> values;
+    float value;
+    while (file >> value)
+        values.push_back(value);
+    if (!file.eof() || values.empty() || values.size() % 3 != 0)
+    {
+        err = "Expected x y z keypoints in \"" + fileName + "\"";
+        return false;
+    }
+    keypoints = Eigen::Map<Mat3Xf>(values.data(), 3, values.size() / 3);
+    return true;
+}
+
+void
+OVFrameAnnotator::setScene(const Mat3Xf& vertices, const Mat3Xf& keypoints, const cv::Size& frameSize)
+{
+    _vertices = vertices;
+    _keypoints = keypoints;
+    _frameSize = frameSize;
+}
+
+std::string
+OVFrameAnnotator::annotate(int frameIndex, const Mat34& projection, const cv::Mat& depth, const cv::Rect& crop) const
+{
+    Eigen::Matrix3f rotation = projection.leftCols<3>().cast<float>();
+    Eigen::Vector3f translation = projection.col(3).cast<float>();
+    float planeNear = (float)OVRenderer::PlaneNear;
+    float width = (float)_frameSize.width;
+    float height = (float)_frameSize.height;
+    std::string line = "{\"frame\":" + std::to_string(frameIndex);
+
+    // Vertices behind the near plane are left out
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+    Mat3Xf points;
+    RowArrayXf x, y;
+    for (Eigen::Index first = 0; first < _vertices.cols(); first += VertexBlockSize)
+    {
+        Eigen::Index count = std::min(VertexBlockSize, _vertices.cols() - first);
+        points.noalias() = rotation * _vertices.middleCols(first, count);
+        points.colwise() += translation;
+        auto w = points.row(2).array();
+        auto isInFront = (w >= planeNear);
+        x = points.row(0).array() / w;
+        y = points.row(1).array() / w;
+        minX = std::min(minX, isInFront.select(x, FLT_MAX).minCoeff());
+        maxX = std::max(maxX, isInFront.select(x, -FLT_MAX).maxCoeff());
+        minY = std::min(minY, isInFront.select(y, FLT_MAX).minCoeff());
+        maxY = std::max(maxY, isInFront.select(y, -FLT_MAX).maxCoeff());
+    }
+    minX = std::max(minX, 0.0f);
+    minY = std::max(minY, 0.0f);
+    maxX = std::min(maxX, width);
+    maxY = std::min(maxY, height);
+    if (minX < maxX && minY < maxY)
+    {
+        line += ",\"box\":[";
+        AppendNumber(line, minX);
+        line += ',';
+        AppendNumber(line, minY);
+        line += ',';
+        AppendNumber(line, maxX);
+        line += ',';
+        AppendNumber(line, maxY);
+        line += ']';
+    }
+
+    // A keypoint is hidden where the depth image has a surface in front of
+    // it; outside the crop, the model has none
+    if (hasKeypoints())
+    {
+        points.noalias() = rotation * _keypoints;
+        points.colwise() += translation;
+        line += ",\"keypoints\":[";
+        for (Eigen::Index i = 0; i < points.cols(); ++i)
+        {
+            float w = points(2, i);
+            float pointX = (w >= planeNear) ? points(0, i) / w : 0;
+            float pointY = (w >= planeNear) ? points(1, i) / w : 0;
+            int visibility = 0;
+            if (w >= planeNear && pointX >= 0 && pointX < width && pointY >= 0 && pointY < height)
+            {
+                int col = (int)std::floor(pointX) - crop.x;
+                int row = (int)std::floor(pointY) - crop.y;
+                float surface = (!depth.empty() && col >= 0 && col < depth.cols && row >= 0 && row < depth.rows)
+                                ? depth.ptr<float>(row)[col] : 0;
+                visibility = (surface <= 0 || w <= surface * (1 + DepthTolerance)) ? 2 : 1;
+            }
+            line += (i > 0) ? ",[" : "[";
+            AppendNumber(line, pointX);
+            line += ',';
+            AppendNumber(line, pointY);
+            line += ',' + std::to_string(visibility) + ']';
+        }
+        line += ']';
+    }
+    line += '}';
+    return line;
+}
+
+OVAnnotationFile::OVAnnotationFile()
+{
+    _file = NULL;
+}
+
+OVAnnotationFile::~OVAnnotationFile()
+{
+    close();
+}
+
+bool
+OVAnnotationFile::open(const std::string& outputDir, bool isResumed)
+{
+    close();
+    _fileName = outputDir + FileName;
+    _err.clear();
+    _file = fopen(_fileName.c_str(), isResumed ? "a+b" : "wb");
+    if (!_file)
+    {
+        _err = "Cannot open \"" + _fileName + "\"";
+        return false;
+    }
+    // Finish a torn last line, so it does not swallow the next one; writes
+    // after a read need a seek first
+    bool isTorn = isResumed && fseek(_file, -1, SEEK_END) == 0 && fgetc(_file) != '\n';
+    fseek(_file, 0, SEEK_END);
+    if (isTorn)
+        fputc('\n', _file);
+    return true;
+}
+
+void
+OVAnnotationFile::close()
+{
+    if (_file)
+        fclose(_file);
+    _file = NULL;
+}
+
+bool
+OVAnnotationFile::add(const std::string& line)
+{
+    // Flushed line by line, like the manifest
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_file || fprintf(_file, "%s\n", line.c_str()) < 0 || fflush(_file) != 0)
+    {
+        _err = "Cannot write \"" + _fileName + "\"";
+        return false;
+    }
+    return true;
+}
+
+} // namespace ov
@@ -0,0 +1,395 @@
+#include <algorithm>
+#include <cstring>
+#include "OVFileUtil.h"
+#include "OVFrameArchive.h"
+
+namespace ov
+{
+
+const char* const OVFrameArchive::FileName = "frames.ovf";
+
+namespace
+{
+
+const int ArchiveVersion = 1;
+
+struct ArchiveHeader
+{
+    char magic[8];          // "OVFRAMES"
+    int  version;
+    int  format;            // FRAME_FORMAT
+    int  width;
+    int  height;
+};
+
+struct RecordHeader
+{
+    char      magic[4];     // "OVFR"
+    int       frameIndex;
+    int       type;
+    int       reserved;
+    long long size;
+};
+
+struct IndexEntry
+{
+    int       frameIndex;
+    int       type;
+    long long offset;
+    long long size;
+};
+
+struct ArchiveTrailer
+{
+    long long indexOffset;
+    long long numEntries;
+    char      magic[8];     // "OVFINDEX"
+};
+
+bool
+IsValidEntry(int frameIndex, int type)
+{
+    return frameIndex >= 0 && type >= 0 && type < ENTRY_COUNT;
+}
+
+bool
+IsEntryBefore(const ArchiveEntry& a, const ArchiveEntry& b)
+{
+    return a.frameIndex != b.frameIndex ? a.frameIndex < b.frameIndex : a.type < b.type;
+}
+
+// Sorted by frame and type, with the last entry written of each
+void
+KeepLatestEntries(std::vector<ArchiveEntry>& entries)
+{
+    std::stable_sort(entries.begin(), entries.end(), IsEntryBefore);
+    size_t numKept = 0;
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        bool isLast = (i + 1 == entries.size() || entries[i + 1].frameIndex != entries[i].frameIndex ||
+                       entries[i + 1].type != entries[i].type);
+        if (isLast)
+            entries[numKept++] = entries[i];
+    }
+    entries.resize(numKept);
+}
+
+// The header and entries of a mapped archive, from its index or by
+// walking its records; dataEnd receives the end of the last whole record
+bool
+ReadArchive(const OVMappedFile& file, ArchiveHeader& header, std::vector<ArchiveEntry>& entries,
+            long long& dataEnd)
+{
+    const char* data = file.getData();
+    long long size = (long long)file.getSize();
+    entries.clear();
+    if (size < (long long)sizeof(header))
+        return false;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, "OVFRAMES", 8) != 0 || header.version != ArchiveVersion)
+        return false;
+
+    ArchiveTrailer trailer;
+    if (size >= (long long)(sizeof(header) + sizeof(trailer)))
+    {
+        memcpy(&trailer, data + size - sizeof(trailer), sizeof(trailer));
+        bool isIndexed = memcmp(trailer.magic, "OVFINDEX", 8) == 0 &&
+                         trailer.indexOffset >= (long long)sizeof(header) && trailer.numEntries >= 0 &&
+                         trailer.numEntries <= size / (long long)sizeof(IndexEntry) &&
+                         trailer.indexOffset + trailer.numEntries * (long long)sizeof(IndexEntry) +
+                         (long long)sizeof(trailer) == size;
+        for (long long i = 0; isIndexed && i < trailer.numEntries; ++i)
+        {
+            IndexEntry entry;
+            memcpy(&entry, data + trailer.indexOffset + i * sizeof(entry), sizeof(entry));
+            isIndexed = IsValidEntry(entry.frameIndex, entry.type) && entry.offset >= (long long)sizeof(header) &&
+                        entry.size >= 0 && entry.offset + entry.size <= trailer.indexOffset;
+            ArchiveEntry archiveEntry = { entry.frameIndex, entry.type, entry.offset, entry.size };
+            entries.push_back(archiveEntry);
+        }
+        if (isIndexed)
+        {
+            dataEnd = trailer.indexOffset;
+            return true;
+        }
+        entries.clear();
+    }
+
+    // Cut short before the index was written
+    long long position = sizeof(header);
+    RecordHeader record;
+    while (size - position >= (long long)sizeof(record))
+    {
+        memcpy(&record, data + position, sizeof(record));
+        if (memcmp(record.magic, "OVFR", 4) != 0 || !IsValidEntry(record.frameIndex, record.type) ||
+            record.size < 0 || record.size > size - position - (long long)sizeof(record))
+            break;
+        ArchiveEntry entry = { record.frameIndex, record.type, position + (long long)sizeof(record), record.size };
+        entries.push_back(entry);
+        position += sizeof(record) + record.size;
+    }
+    dataEnd = position;
+    return true;
+}
+
+} // namespace
+
+OVFrameArchive::OVFrameArchive()
+{
+    _file = NULL;
+    _size = 0;
+    _isClosing = false;
+    _isFailed = false;
+}
+
+OVFrameArchive::~OVFrameArchive()
+{
+    close();
+}
+
+bool
+OVFrameArchive::open(const std::string& fileName, FRAME_FORMAT format, const cv::Size& frameSize)
+{
+    close();
+    _fileName = fileName;
+    _err.clear();
+    _entries.clear();
+    _isClosing = false;
+    _isFailed = false;
+
+    // Appended to after its last whole record, over its index
+    ArchiveHeader header;
+    long long dataEnd;
+    OVMappedFile previous;
+    bool isSameFormat = previous.open(fileName, true) && ReadArchive(previous, header, _entries, dataEnd) &&
+                        header.format == format && header.width == frameSize.width &&
+                        header.height == frameSize.height;
+    previous.close();
+    if (isSameFormat && TruncateFile(fileName, dataEnd))
+    {
+        _file = fopen(fileName.c_str(), "ab");
+        _size = dataEnd;
+    }
+    else
+    {
+        _entries.clear();
+        memcpy(header.magic, "OVFRAMES", 8);
+        header.version = ArchiveVersion;
+        header.format = format;
+        header.width = frameSize.width;
+        header.height = frameSize.height;
+        _file = fopen(fileName.c_str(), "wb");
+        if (_file && fwrite(&header, sizeof(header), 1, _file) != 1)
+        {
+            fclose(_file);
+            _file = NULL;
+        }
+        _size = sizeof(header);
+    }
+    if (!_file)
+    {
+        _err = "Cannot open \"" + fileName + "\"";
+        return false;
+    }
+
+    _chunk.reserve(ChunkSize);
+    _writer = std::thread(&OVFrameArchive::writeChunks, this);
+    return true;
+}
+
+bool
+OVFrameArchive::close()
+{
+    if (!_file)
+        return _err.empty();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_chunk.empty())
+            _fullChunks.push_back(std::move(_chunk));
+        _chunk.clear();
+        _isClosing = true;
+    }
+    _condition.notify_all();
+    _writer.join();
+
+    // The index of the latest entries, then the trailer that finds it
+    if (!_isFailed)
+    {
+        KeepLatestEntries(_entries);
+        std::vector<IndexEntry> index(_entries.size());
+        for (size_t i = 0; i < _entries.size(); ++i)
+        {
+            index[i].frameIndex = _entries[i].frameIndex;
+            index[i].type = _entries[i].type;
+            index[i].offset = _entries[i].offset;
+            index[i].size = _entries[i].size;
+        }
+        ArchiveTrailer trailer;
+        trailer.indexOffset = _size;
+        trailer.numEntries = (long long)index.size();
+        memcpy(trailer.magic, "OVFINDEX", 8);
+        bool isOk = fwrite(index.data(), sizeof(IndexEntry), index.size(), _file) == index.size() &&
+                    fwrite(&trailer, sizeof(trailer), 1, _file) == 1;
+        if (!isOk)
+            _isFailed = true;
+    }
+    if (fclose(_file) != 0)
+        _isFailed = true;
+    _file = NULL;
+    _fullChunks.clear();
+    _freeChunks.clear();
+    _chunk.shrink_to_fit();
+    if (_isFailed && _err.empty())
+        _err = "Cannot write \"" + _fileName + "\"";
+    return !_isFailed;
+}
+
+bool
+OVFrameArchive::append(int frameIndex, ARCHIVE_ENTRY type, const unsigned char* data, size_t size)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _condition.wait(lock, [this]() { return _fullChunks.size() < MaxPendingChunks || _isFailed; });
+    if (!_file || _isFailed)
+        return false;
+
+    // A full chunk goes to the writer, and an emptied one takes its place
+    RecordHeader record;
+    if (!_chunk.empty() && _chunk.size() + sizeof(record) + size > ChunkSize)
+    {
+        _fullChunks.push_back(std::move(_chunk));
+        _chunk.clear();
+        if (!_freeChunks.empty())
+        {
+            _chunk.swap(_freeChunks.back());
+            _freeChunks.pop_back();
+        }
+        else
+            _chunk.reserve(ChunkSize);
+        _condition.notify_all();
+    }
+
+    memcpy(record.magic, "OVFR", 4);
+    record.frameIndex = frameIndex;
+    record.type = type;
+    record.reserved = 0;
+    record.size = (long long)size;
+    const unsigned char* recordBytes = (const unsigned char*)&record;
+    _chunk.insert(_chunk.end(), recordBytes, recordBytes + sizeof(record));
+    _chunk.insert(_chunk.end(), data, data + size);
+    ArchiveEntry entry = { frameIndex, type, _size + (long long)sizeof(record), (long long)size };
+    _entries.push_back(entry);
+    _size += sizeof(record) + size;
+    return true;
+}
+
+void
+OVFrameArchive::writeChunks()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        _condition.wait(lock, [this]() { return !_fullChunks.empty() || _isClosing; });
+        if (_fullChunks.empty())
+            break;
+
+        // Written whole, outside the lock, and flushed so the records of a
+        // killed process reach the file
+        std::vector<unsigned char> chunk = std::move(_fullChunks.front());
+        _fullChunks.pop_front();
+        lock.unlock();
+        bool isOk = fwrite(chunk.data(), 1, chunk.size(), _file) == chunk.size() && fflush(_file) == 0;
+        lock.lock();
+
+        chunk.clear();
+        if (_freeChunks.size() < MaxPendingChunks)
+            _freeChunks.push_back(std::move(chunk));
+        if (!isOk && !_isFailed)
+        {
+            _isFailed = true;
+            _err = "Cannot write \"" + _fileName + "\"";
+        }
+        _condition.notify_all();
+    }
+}
+
+OVFrameArchiveReader::OVFrameArchiveReader()
+{
+    _format = FORMAT_PNG;
+}
+
+bool
+OVFrameArchiveReader::open(const std::string& fileName)
+{
+    close();
+    ArchiveHeader header;
+    long long dataEnd;
+    if (!_file.open(fileName, false) || !ReadArchive(_file, header, _entries, dataEnd) || header.format < 0 ||
+        header.format >= FORMAT_COUNT)
+    {
+        _err = "Cannot read the frame archive \"" + fileName + "\"";
+        close();
+        return false;
+    }
+    KeepLatestEntries(_entries);
+    _format = (FRAME_FORMAT)header.format;
+    _frameSize = cv::Size(header.width, header.height);
+    _decoder.reset(OVFrameEncoder::Create(_format));
+    _err.clear();
+    return true;
+}
+
+void
+OVFrameArchiveReader::close()
+{
+    _file.close();
+    _entries.clear();
+    _decoder.reset();
+}
+
+const unsigned char*
+OVFrameArchiveReader::getEntry(int frameIndex, ARCHIVE_ENTRY type, size_t& size) const
+{
+    ArchiveEntry key = { frameIndex, type, 0, 0 };
+    auto entry = std::lower_bound(_entries.begin(), _entries.end(), key, IsEntryBefore);
+    if (entry == _entries.end() || entry->frameIndex != frameIndex || entry->type != type)
+        return NULL;
+    size = (size_t)entry->size;
+    return (const unsigned char*)_file.getData() + entry->offset;
+}
+
+cv::Rect
+OVFrameArchiveReader::readCrop(int frameIndex) const
+{
+    size_t size;
+    const unsigned char* data = getEntry(frameIndex, ENTRY_CROP, size);
+    int crop[4];
+    if (!data || size != sizeof(crop))
+        return cv::Rect(0, 0, _frameSize.width, _frameSize.height);
+    memcpy(crop, data, sizeof(crop));
+    return cv::Rect(crop[0], crop[1], crop[2], crop[3]);
+}
+
+bool
+OVFrameArchiveReader::readImage(int frameIndex, cv::Mat& image) const
+{
+    size_t size;
+    const unsigned char* data = getEntry(frameIndex, ENTRY_IMAGE, size);
+    return data && _decoder && _decoder->decode(data, size, readCrop(frameIndex).size(), image);
+}
+
+bool
+OVFrameArchiveReader::readAuxImage(int frameIndex, ARCHIVE_ENTRY type, cv::Mat& image) const
+{
+    size_t size;
+    const unsigned char* data = getEntry(frameIndex, type, size);
+    if (!data || type == ENTRY_IMAGE || type == ENTRY_CROP)
+        return false;
+    image = cv::imdecode(cv::Mat(1, (int)size, CV_8U, (void*)data), cv::IMREAD_UNCHANGED);
+    // Normals are stored with x, y and z as R, G and B
+    if (type == ENTRY_NORMALS && image.channels() == 3)
+        cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
+    return !image.empty();
+}
+
+} // namespace ov
@@ -0,0 +1,369 @@
+#include <cstdio>
+#include <cstring>
+#include "OVFileUtil.h"
+#include "OVFrameEncoder.h"
+
+namespace ov
+{
+
+namespace
+{
+
+const char* FormatNames[FORMAT_COUNT] = { "png", "jpg", "ppm", "raw", "qoi" };
+
+bool
+IsBgrImage(const cv::Mat& image)
+{
+    return !image.empty() && image.type() == CV_8UC3;
+}
+
+// Through OpenCV, which reads PNG, JPEG and PPM
+bool
+DecodeWithOpenCV(const unsigned char* data, size_t size, cv::Mat& image)
+{
+    image = cv::imdecode(cv::Mat(1, (int)size, CV_8U, (void*)data), cv::IMREAD_COLOR);
+    return IsBgrImage(image);
+}
+
+class OVOpenCVEncoder : public OVFrameEncoder
+{
+public:
+    OVOpenCVEncoder(FRAME_FORMAT format, int quality) : OVFrameEncoder(format, quality)
+    {
+        if (quality >= 0)
+        {
+            _params.push_back(format == FORMAT_PNG ? cv::IMWRITE_PNG_COMPRESSION : cv::IMWRITE_JPEG_QUALITY);
+            _params.push_back(quality);
+        }
+    }
+
+    const char* getExtension() const { return _format == FORMAT_PNG ? ".png" : ".jpg"; }
+
+    bool encode(const cv::Mat& image, std::vector<unsigned char>& buffer) const
+    {
+        return IsBgrImage(image) && cv::imencode(getExtension(), image, buffer, _params);
+    }
+
+    bool decode(const unsigned char* data, size_t size, const cv::Size&, cv::Mat& image) const
+    {
+        return DecodeWithOpenCV(data, size, image);
+    }
+
+private:
+    std::vector<int> _params;
+};
+
+// P6 with RGB samples, or raw BGR rows without a header
+class OVUncompressedEncoder : public OVFrameEncoder
+{
+public:
+    OVUncompressedEncoder(FRAME_FORMAT format) : OVFrameEncoder(format, -1) {}
+
+    const char* getExtension() const { return _format == FORMAT_PPM ? ".ppm" : ".raw"; }
+
+    bool encode(const cv::Mat& image, std::vector<unsigned char>& buffer) const
+    {
+        if (!IsBgrImage(image))
+            return false;
+
+        char header[32];
+        int headerSize = 0;
+        if (_format == FORMAT_PPM)
+            headerSize = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", image.cols, image.rows);
+
+        size_t rowSize = (size_t)image.cols * 3;
+        buffer.resize(headerSize + rowSize * image.rows);
+        memcpy(buffer.data(), header, headerSize);
+        unsigned char* out = buffer.data() + headerSize;
+        for (int y = 0; y < image.rows; ++y, out += rowSize)
+        {
+            const unsigned char* row = image.ptr<unsigned char>(y);
+            if (_format == FORMAT_RAW)
+            {
+                memcpy(out, row, rowSize);
+                continue;
+            }
+            for (size_t x = 0; x < rowSize; x += 3)
+            {
+                out[x] = row[x + 2];
+                out[x + 1] = row[x + 1];
+                out[x + 2] = row[x];
+            }
+        }
+        return true;
+    }
+
+    bool decode(const unsigned char* data, size_t size, const cv::Size& frameSize, cv::Mat& image) const
+    {
+        if (_format == FORMAT_PPM)
+            return DecodeWithOpenCV(data, size, image);
+        if (frameSize.area() <= 0 || size != (size_t)frameSize.area() * 3)
+            return false;
+        cv::Mat(frameSize, CV_8UC3, (void*)data).copyTo(image);
+        return true;
+    }
+};
+
+// QOI (qoiformat.org): one pass, no entropy coding, typically within 10-20%
+// of PNG's size on rendered frames at many times its speed
+class OVQoiEncoder : public OVFrameEncoder
+{
+public:
+    OVQoiEncoder() : OVFrameEncoder(FORMAT_QOI, -1) {}
+
+    const char* getExtension() const { return ".qoi"; }
+
+    bool encode(const cv::Mat& image, std::vector<unsigned char>& buffer) const
+    {
+        if (!IsBgrImage(image))
+            return false;
+
+        // Worst case: every pixel an OP_RGB, plus the 14-byte header and 8-byte end marker
+        buffer.resize((size_t)image.cols * image.rows * 4 + 14 + 8);
+        unsigned char* out = buffer.data();
+        memcpy(out, "qoif", 4);
+        out += 4;
+        for (int shift = 24; shift >= 0; shift -= 8)
+            *out++ = (unsigned char)(image.cols >> shift);
+        for (int shift = 24; shift >= 0; shift -= 8)
+            *out++ = (unsigned char)(image.rows >> shift);
+        *out++ = 3;     // RGB
+        *out++ = 0;     // sRGB
+
+        // Alpha is always 255, so pixels are compared as packed RGB
+        unsigned int index[64] = {};
+        bool isIndexed[64] = {};
+        unsigned int prePixel = 0;
+        int run = 0;
+        for (int y = 0; y < image.rows; ++y)
+        {
+            const unsigned char* row = image.ptr<unsigned char>(y);
+            for (int x = 0; x < image.cols; ++x, row += 3)
+            {
+                unsigned char r = row[2], g = row[1], b = row[0];
+                unsigned int pixel = (r << 16) | (g << 8) | b;
+                if (pixel == prePixel)
+                {
+                    if (++run == 62)
+                    {
+                        *out++ = (unsigned char)(OP_RUN | (run - 1));
+                        run = 0;
+                    }
+                    continue;
+                }
+                if (run > 0)
+                {
+                    *out++ = (unsigned char)(OP_RUN | (run - 1));
+                    run = 0;
+                }
+
+                int hash = (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+                if (isIndexed[hash] && index[hash] == pixel)
+                    *out++ = (unsigned char)(OP_INDEX | hash);
+                else
+                {
+                    index[hash] = pixel;
+                    isIndexed[hash] = true;
+                    signed char dr = (signed char)(r - (prePixel >> 16));
+                    signed char dg = (signed char)(g - ((prePixel >> 8) & 0xff));
+                    signed char db = (signed char)(b - (prePixel & 0xff));
+                    int drg = dr - dg;
+                    int dbg = db - dg;
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                        *out++ = (unsigned char)(OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                    else if (drg >= -8 && drg <= 7 && dg >= -32 && dg <= 31 && dbg >= -8 && dbg <= 7)
+                    {
+                        *out++ = (unsigned char)(OP_LUMA | (dg + 32));
+                        *out++ = (unsigned char)((drg + 8) << 4 | (dbg + 8));
+                    }
+                    else
+                    {
+                        *out++ = OP_RGB;
+                        *out++ = r;
+                        *out++ = g;
+                        *out++ = b;
+                    }
+                }
+                prePixel = pixel;
+            }
+        }
+        if (run > 0)
+            *out++ = (unsigned char)(OP_RUN | (run - 1));
+
+        memcpy(out, EndMarker, sizeof(EndMarker));
+        out += sizeof(EndMarker);
+        buffer.resize(out - buffer.data());
+        return true;
+    }
+
+    // Any QOI image, with alpha dropped
+    bool decode(const unsigned char* data, size_t size, const cv::Size&, cv::Mat& image) const
+    {
+        const int HeaderSize = 14;
+        if (size < HeaderSize + sizeof(EndMarker) || memcmp(data, "qoif", 4) != 0)
+            return false;
+        unsigned int width = 0, height = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            width = (width << 8) | data[4 + i];
+            height = (height << 8) | data[8 + i];
+        }
+        int numChannels = data[12];
+        if (width == 0 || height == 0 || width > (1 << 16) || height > (1 << 16) ||
+            (numChannels != 3 && numChannels != 4))
+            return false;
+
+        image.create((int)height, (int)width, CV_8UC3);
+        const unsigned char* in = data + HeaderSize;
+        const unsigned char* end = data + size - sizeof(EndMarker);
+        unsigned char index[64][4] = {};
+        unsigned char pixel[4] = { 0, 0, 0, 255 };
+        int run = 0;
+        for (int y = 0; y < image.rows; ++y)
+        {
+            unsigned char* row = image.ptr<unsigned char>(y);
+            for (int x = 0; x < image.cols; ++x, row += 3)
+            {
+                if (run > 0)
+                    --run;
+                else
+                {
+                    if (in >= end)
+                        return false;
+                    int op = *in++;
+                    if (op == OP_RGB || op == OP_RGBA)
+                    {
+                        int numBytes = (op == OP_RGB) ? 3 : 4;
+                        if (end - in < numBytes)
+                            return false;
+                        memcpy(pixel, in, numBytes);
+                        in += numBytes;
+                    }
+                    else if ((op & 0xc0) == OP_INDEX)
+                        memcpy(pixel, index[op], 4);
+                    else if ((op & 0xc0) == OP_DIFF)
+                    {
+                        pixel[0] += ((op >> 4) & 3) - 2;
+                        pixel[1] += ((op >> 2) & 3) - 2;
+                        pixel[2] += (op & 3) - 2;
+                    }
+                    else if ((op & 0xc0) == OP_LUMA)
+                    {
+                        if (in >= end)
+                            return false;
+                        int dg = (op & 0x3f) - 32;
+                        int next = *in++;
+                        pixel[0] += dg - 8 + (next >> 4);
+                        pixel[1] += dg;
+                        pixel[2] += dg - 8 + (next & 0x0f);
+                    }
+                    else
+                        run = op & 0x3f;
+                    memcpy(index[(pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64], pixel, 4);
+                }
+                row[0] = pixel[2];
+                row[1] = pixel[1];
+                row[2] = pixel[0];
+            }
+        }
+        return true;
+    }
+
+private:
+    enum
+    {
+        OP_INDEX = 0x00,
+        OP_DIFF  = 0x40,
+        OP_LUMA  = 0x80,
+        OP_RUN   = 0xc0,
+        OP_RGB   = 0xfe,
+        OP_RGBA  = 0xff,
+    };
+
+    static const unsigned char EndMarker[8];
+};
+
+const unsigned char OVQoiEncoder::EndMarker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+} // namespace
+
+OVFrameEncoder*
+OVFrameEncoder::Create(FRAME_FORMAT format, int quality)
+{
+    switch (format)
+    {
+    case FORMAT_PNG:
+    case FORMAT_JPEG:
+        return new OVOpenCVEncoder(format, quality);
+    case FORMAT_PPM:
+    case FORMAT_RAW:
+        return new OVUncompressedEncoder(format);
+    case FORMAT_QOI:
+        return new OVQoiEncoder();
+    default:
+        return NULL;
+    }
+}
+
+bool
+OVFrameEncoder::ParseFormat(const std::string& name, FRAME_FORMAT& format)
+{
+    for (int i = 0; i < FORMAT_COUNT; ++i)
+    {
+        if (name == FormatNames[i])
+        {
+            format = (FRAME_FORMAT)i;
+            return true;
+        }
+    }
+    if (name == "jpeg")
+    {
+        format = FORMAT_JPEG;
+        return true;
+    }
+    return false;
+}
+
+const char*
+OVFrameEncoder::GetFormatName(FRAME_FORMAT format)
+{
+    return (format >= 0 && format < FORMAT_COUNT) ? FormatNames[format] : "";
+}
+
+bool
+OVFrameEncoder::IsValidQuality(FRAME_FORMAT format, int quality)
+{
+    if (quality == -1)
+        return true;
+    if (format == FORMAT_PNG)
+        return quality >= 0 && quality <= 9;
+    if (format == FORMAT_JPEG)
+        return quality >= 0 && quality <= 100;
+    return false;
+}
+
+bool
+OVFrameEncoder::write(const std::string& imageBase, const cv::Mat& image, size_t* numBytes) const
+{
+    // Kept by every encoding thread, so steady-state writes do not allocate
+    thread_local std::vector<unsigned char> buffer;
+    if (!encode(image, buffer))
+        return false;
+
+    // Written aside and renamed into place, so a frame file is never partial
+    std::string fileName = imageBase + getExtension();
+    std::string partFileName = imageBase + ".part" + getExtension();
+    FILE* file = fopen(partFileName.c_str(), "wb");
+    if (!file)
+        return false;
+    bool isOk = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    isOk = (fclose(file) == 0) && isOk;
+    isOk = isOk && RenameFile(partFileName, fileName);
+    if (!isOk)
+        remove(partFileName.c_str());
+    if (numBytes)
+        *numBytes = buffer.size();
+    return isOk;
+}
+
+} // namespace ov
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <chrono>
+#include "OVFramePipeline.h"
+#include "OVThreadPool.h"
+
+namespace ov
+{
+
+namespace
+{
+
+// Spin briefly, then sleep, so idle stages do not take cores from rendering
+void
+Backoff(int& numTries)
+{
+    if (++numTries < 16)
+        std::this_thread::yield();
+    else
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+}
+
+int
+DefaultWorkerCount(int share)
+{
+    int numThreads = OVThreadPool::DefaultThreadCount;
+    if (numThreads <= 0)
+        numThreads = (int)std::thread::hardware_concurrency();
+    return std::max(1, numThreads / share);
+}
+
+} // namespace
+
+OVFramePipeline::OVFramePipeline(int numProcessWorkers, int numEncodeWorkers, int queueCapacity)
+    : _processQueue(queueCapacity), _encodeQueue(queueCapacity)
+{
+    // Encoding PNGs costs several times more than blurring and adding noise
+    _numProcessWorkers = numProcessWorkers > 0 ? numProcessWorkers : DefaultWorkerCount(4);
+    _numEncodeWorkers = numEncodeWorkers > 0 ? numEncodeWorkers : DefaultWorkerCount(2);
+    _isStopping = false;
+    _isCancelled = false;
+    _hasFailed = false;
+    _processSample = StageSample();
+    _encodeSample = StageSample();
+    _numSubmitted = 0;
+    _numCompleted = 0;
+
+    // Frames in flight: both queues, plus one held by every worker and one
+    // more by a processing worker waiting for room in the encode queue
+    int maxInFlight = _processQueue.capacity() + _encodeQueue.capacity() + 2 * _numProcessWorkers + _numEncodeWorkers;
+    _isDone.assign(maxInFlight + 1, false);
+}
+
+OVFramePipeline::~OVFramePipeline()
+{
+    cancel();
+    finish();
+}
+
+void
+OVFramePipeline::start(const StageFunction& process, const StageFunction& encode)
+{
+    _process = process;
+    _encode = encode;
+    for (int i = 0; i < _numProcessWorkers; ++i)
+        _workers.push_back(std::thread(&OVFramePipeline::processLoop, this));
+    for (int i = 0; i < _numEncodeWorkers; ++i)
+        _workers.push_back(std::thread(&OVFramePipeline::encodeLoop, this));
+}
+
+void
+OVFramePipeline::submit(PipelineFrame& frame)
+{
+    // Every frame not yet counted holds a slot of _isDone, so a stalled frame
+    // holds back the submission of the one that would reuse its slot
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [this]() { return _numSubmitted - _numCompleted < (int)_isDone.size(); });
+    }
+    frame.sequence = _numSubmitted++;
+    sample(_processSample, _processQueue.size());
+    sample(_encodeSample, _encodeQueue.size());
+
+    int numTries = 0;
+    while (!_processQueue.tryPush(frame))
+        Backoff(numTries);
+}
+
+int
+OVFramePipeline::waitCompleted(int count)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _condition.wait(lock, [this, count]() { return _numCompleted > count || _numCompleted == _numSubmitted; });
+    return _numCompleted;
+}
+
+void
+OVFramePipeline::finish()
+{
+    if (_workers.empty())
+        return;
+
+    waitAll();
+    _isStopping = true;
+    for (int i = 0; i < _workers.size(); ++i)
+        _workers[i].join();
+    _workers.clear();
+    _isStopping = false;
+}
+
+void
+OVFramePipeline::getStats(std::vector<PipelineStageStats>& stats) const
+{
+    const char* names[2] = { "process", "encode" };
+    const StageSample* samples[2] = { &_processSample, &_encodeSample };
+    int numWorkers[2] = { _numProcessWorkers, _numEncodeWorkers };
+    int capacities[2] = { _processQueue.capacity(), _encodeQueue.capacity() };
+
+    stats.resize(2);
+    for (int i = 0; i < 2; ++i)
+    {
+        stats[i].name = names[i];
+        stats[i].numWorkers = numWorkers[i];
+        stats[i].capacity = capacities[i];
+        stats[i].meanOccupancy = samples[i]->count > 0 ? (double)samples[i]->sum / samples[i]->count : 0;
+        stats[i].maxOccupancy = samples[i]->max;
+    }
+}
+
+void
+OVFramePipeline::processLoop()
+{
+    PipelineFrame frame;
+    int numTries = 0;
+    while (true)
+    {
+        if (!_processQueue.tryPop(frame))
+        {
+            if (_isStopping)
+                return;
+            Backoff(numTries);
+            continue;
+        }
+        numTries = 0;
+
+        if (!_isCancelled && !_hasFailed && !_process(frame))
+            _hasFailed = true;
+        while (!_encodeQueue.tryPush(frame))
+            Backoff(numTries);
+        numTries = 0;
+    }
+}
+
+void
+OVFramePipeline::encodeLoop()
+{
+    PipelineFrame frame;
+    int numTries = 0;
+    while (true)
+    {
+        if (!_encodeQueue.tryPop(frame))
+        {
+            if (_isStopping)
+                return;
+            Backoff(numTries);
+            continue;
+        }
+        numTries = 0;
+
+        if (!_isCancelled && !_hasFailed && !_encode(frame))
+            _hasFailed = true;
+        int sequence = frame.sequence;
+        frame = PipelineFrame();
+        complete(sequence);
+    }
+}
+
+void
+OVFramePipeline::complete(int sequence)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    int size = (int)_isDone.size();
+    _isDone[sequence % size] = true;
+    int numCompleted = _numCompleted;
+    while (_isDone[numCompleted % size])
+    {
+        _isDone[numCompleted % size] = false;
+        ++numCompleted;
+    }
+    _numCompleted = numCompleted;
+    _condition.notify_all();
+}
+
+void
+OVFramePipeline::sample(StageSample& sample, int occupancy)
+{
+    sample.sum += occupancy;
+    ++sample.count;
+    sample.max = std::max(sample.max, occupancy);
+}
+
+} // namespace ov
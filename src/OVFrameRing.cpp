@@ -0,0 +1,210 @@
+#include <cstring>
+#include "OVFrameRing.h"
+#include "ov_frame_ring.h"
+
+namespace ov
+{
+
+namespace
+{
+
+// Slots and planes start on cache lines
+const uint64_t RingAlignment = 64;
+
+const int PlaneTypes[OV_RING_PLANE_COUNT] = { CV_8UC3, CV_32F, CV_16U, CV_16U, CV_32FC3 };
+
+uint64_t
+AlignRingOffset(uint64_t offset)
+{
+    return (offset + RingAlignment - 1) / RingAlignment * RingAlignment;
+}
+
+} // namespace
+
+OVFrameRing::OVFrameRing()
+{
+    _header = NULL;
+    _size = 0;
+#ifdef _WIN32
+    _mapping = NULL;
+#endif
+    _numReserved = 0;
+    _isCancelled = false;
+}
+
+OVFrameRing::~OVFrameRing()
+{
+    close();
+}
+
+bool
+OVFrameRing::create(const std::string& name, int numSlots, const cv::Size& frameSize, unsigned int planes)
+{
+    close();
+    _err.clear();
+    _numReserved = 0;
+    _isCancelled = false;
+    planes |= 1u << OV_RING_COLOR;
+
+    // The slot header, then every plane the ring has
+    uint64_t planeOffsets[OV_RING_PLANE_COUNT] = {};
+    uint64_t slotSize = AlignRingOffset(sizeof(ov_ring_slot));
+    for (int i = 0; i < OV_RING_PLANE_COUNT; ++i)
+    {
+        if (!(planes & (1u << i)))
+            continue;
+        planeOffsets[i] = slotSize;
+        slotSize = AlignRingOffset(slotSize + ov_ring_plane_size(i, frameSize.width, frameSize.height));
+    }
+    uint64_t slotsOffset = AlignRingOffset(sizeof(ov_ring_header));
+    _size = (size_t)(slotsOffset + slotSize * (uint64_t)numSlots);
+
+    void* data = NULL;
+#ifdef _WIN32
+    // A ring whose consumer has not detached yet keeps its name a moment
+    std::string mappingName = "Local\\" + name;
+    DWORD sizeHigh = (DWORD)((unsigned long long)_size >> 32);
+    DWORD sizeLow = (DWORD)(_size & 0xffffffff);
+    for (int i = 0; i < 500 && !_mapping; ++i)
+    {
+        _mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, sizeHigh, sizeLow,
+                                      mappingName.c_str());
+        if (_mapping && GetLastError() == ERROR_ALREADY_EXISTS)
+        {
+            CloseHandle(_mapping);
+            _mapping = NULL;
+            Sleep(10);
+        }
+        else if (!_mapping)
+            break;
+    }
+    if (_mapping)
+        data = MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, _size);
+#else
+    // Consumers still mapping a removed ring keep it until they detach
+    std::string path = "/" + name;
+    shm_unlink(path.c_str());
+    int file = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (file >= 0)
+    {
+        if (ftruncate(file, (off_t)_size) == 0)
+        {
+            data = mmap(NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+            if (data == MAP_FAILED)
+                data = NULL;
+        }
+        ::close(file);
+        if (!data)
+            shm_unlink(path.c_str());
+    }
+#endif
+    if (!data)
+    {
+        _err = "Cannot create the shared memory frame ring \"" + name + "\"";
+#ifdef _WIN32
+        if (_mapping)
+            CloseHandle(_mapping);
+        _mapping = NULL;
+#endif
+        _size = 0;
+        return false;
+    }
+
+    // New memory is zeroed, so every slot is empty; the version goes last,
+    // once a consumer can use the rest
+    _name = name;
+    _header = (ov_ring_header*)data;
+    memcpy(_header->magic, "OVRING\0", 8);
+    _header->slot_count = (uint32_t)numSlots;
+    _header->slot_size = slotSize;
+    _header->slots_offset = slotsOffset;
+    _header->width = frameSize.width;
+    _header->height = frameSize.height;
+    _header->planes = planes;
+    memcpy(_header->plane_offsets, planeOffsets, sizeof(planeOffsets));
+    ov_ring_store32(&_header->version, OV_RING_VERSION);
+    return true;
+}
+
+void
+OVFrameRing::close()
+{
+    if (!_header)
+        return;
+
+    ov_ring_store(&_header->closed, 1);
+#ifdef _WIN32
+    UnmapViewOfFile(_header);
+    CloseHandle(_mapping);
+    _mapping = NULL;
+#else
+    munmap(_header, _size);
+    shm_unlink(("/" + _name).c_str());
+#endif
+    _header = NULL;
+    _size = 0;
+}
+
+bool
+OVFrameRing::publish(int lineIndex, int frameIndex, const Pose& pose, const Mat3& cameraMatrix, const cv::Rect& crop,
+                     const cv::Mat* planes)
+{
+    if (!_header)
+        return false;
+    int width = crop.width;
+    int height = crop.height;
+    bool isValid = crop.x >= 0 && crop.y >= 0 && width > 0 && height > 0 && crop.x + width <= _header->width &&
+                   crop.y + height <= _header->height;
+    for (int i = 0; i < OV_RING_PLANE_COUNT && isValid; ++i)
+    {
+        bool isRingPlane = (_header->planes & (1u << i)) != 0;
+        isValid = !isRingPlane || (planes[i].cols == width && planes[i].rows == height &&
+                                   planes[i].type() == PlaneTypes[i]);
+    }
+    if (!isValid)
+    {
+        _err = "A frame does not match the planes of the frame ring \"" + _name + "\"";
+        return false;
+    }
+
+    // The slot is free once the consumer has released the frame a whole
+    // ring before this one
+    uint64_t position = _numReserved++;
+    while (position - ov_ring_load(&_header->read_count) >= _header->slot_count)
+    {
+        if (_isCancelled)
+            return false;
+        ov_ring_pause();
+    }
+
+    char* slotData = (char*)_header + _header->slots_offset + (position % _header->slot_count) * _header->slot_size;
+    ov_ring_slot* slot = (ov_ring_slot*)slotData;
+    slot->line_index = lineIndex;
+    slot->frame_index = frameIndex;
+    slot->crop_x = crop.x;
+    slot->crop_y = crop.y;
+    slot->crop_width = crop.width;
+    slot->crop_height = crop.height;
+    for (int row = 0; row < 3; ++row)
+    {
+        for (int col = 0; col < 3; ++col)
+        {
+            slot->rotation[row * 3 + col] = pose.R(row, col);
+            slot->camera_matrix[row * 3 + col] = cameraMatrix(row, col);
+        }
+        slot->translation[row] = pose.t(row);
+    }
+    for (int i = 0; i < OV_RING_PLANE_COUNT; ++i)
+    {
+        if (!(_header->planes & (1u << i)))
+            continue;
+        size_t rowSize = (size_t)width * planes[i].elemSize();
+        char* plane = slotData + _header->plane_offsets[i];
+        for (int row = 0; row < height; ++row)
+            memcpy(plane + row * rowSize, planes[i].ptr(row), rowSize);
+    }
+    ov_ring_store(&slot->sequence, position + 1);
+    return true;
+}
+
+} // namespace ov
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cmath>
+#include "OVFrameScheduler.h"
+
+namespace ov
+{
+
+const int OVFrameScheduler::SettleMilliseconds;
+const double OVFrameScheduler::MinScale = 0.25;
+const double OVFrameScheduler::MinSaving = 0.1;
+
+OVFrameScheduler::OVFrameScheduler()
+{
+    _frameInterval = 1000.0 / 60.0;
+    _isDirty = false;
+    _needsFullFrame = false;
+    _lastInput = Clock::now() - std::chrono::milliseconds(SettleMilliseconds);
+    _fullFrameTime = 0;
+    _reducedFrameTime = 0;
+    _reducedPixels = 0;
+}
+
+void
+OVFrameScheduler::invalidate(bool isInteractive)
+{
+    _isDirty = true;
+    if (isInteractive)
+        _lastInput = Clock::now();
+}
+
+bool
+OVFrameScheduler::nextFrame(double& scale)
+{
+    bool isSettled = Clock::now() - _lastInput >= std::chrono::milliseconds(SettleMilliseconds);
+    if (_isDirty)
+    {
+        _isDirty = false;
+        scale = isSettled ? 1.0 : interactiveScale();
+        _needsFullFrame = (scale < 1.0);
+        return true;
+    }
+
+    // Replace the last reduced frame once the input stops
+    if (_needsFullFrame && isSettled)
+    {
+        _needsFullFrame = false;
+        scale = 1.0;
+        return true;
+    }
+
+    return false;
+}
+
+void
+OVFrameScheduler::frameDone(double milliseconds, double scale)
+{
+    // Reduced frames at different scales are averaged together, which keeps
+    // them on the same line of time against pixel count
+    if (scale >= 1.0)
+    {
+        _fullFrameTime = (_fullFrameTime == 0) ? milliseconds : 0.5 * (_fullFrameTime + milliseconds);
+        return;
+    }
+    double pixels = scale * scale;
+    bool isFirst = (_reducedPixels == 0);
+    _reducedFrameTime = isFirst ? milliseconds : 0.5 * (_reducedFrameTime + milliseconds);
+    _reducedPixels = isFirst ? pixels : 0.5 * (_reducedPixels + pixels);
+}
+
+void
+OVFrameScheduler::estimateCost(double& fixedCost, double& pixelCost) const
+{
+    // Until frames at two scales are known, all of the time is taken to
+    // grow with the pixels, so that a reduced frame measures the fixed part
+    fixedCost = 0;
+    if (_reducedPixels == 0)
+    {
+        pixelCost = _fullFrameTime;
+        return;
+    }
+    if (_fullFrameTime == 0)
+    {
+        pixelCost = _reducedFrameTime / _reducedPixels;
+        return;
+    }
+
+    pixelCost = std::max(0.0, (_fullFrameTime - _reducedFrameTime) / (1.0 - _reducedPixels));
+    fixedCost = _fullFrameTime - pixelCost;
+    if (fixedCost < 0)
+    {
+        fixedCost = 0;
+        pixelCost = _fullFrameTime;
+    }
+}
+
+double
+OVFrameScheduler::interactiveScale() const
+{
+    double fixedCost, pixelCost;
+    estimateCost(fixedCost, pixelCost);
+    if (fixedCost + pixelCost <= _frameInterval || pixelCost <= 0)
+        return 1.0;
+
+    // When the fixed part alone misses the interval, the smallest scale
+    // comes closest
+    double pixels = std::max(0.0, (_frameInterval - fixedCost) / pixelCost);
+    double scale = std::max(MinScale, std::sqrt(pixels));
+    if (pixelCost * (1.0 - scale * scale) < MinSaving * (fixedCost + pixelCost))
+        return 1.0;
+    return scale;
+}
+
+} // namespace ov
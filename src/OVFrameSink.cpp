@@ -0,0 +1,399 @@
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include "OVFileUtil.h"
+#include "OVFrameRing.h"
+#include "OVFrameSink.h"
+#include "ov_frame_ring.h"
+
+namespace ov
+{
+
+namespace
+{
+
+const char* ContainerNames[CONTAINER_COUNT] = { "files", "archive", "video", "ring" };
+
+struct VideoCodec
+{
+    const char* name;
+    char        fourcc[4];
+    const char* extension;
+};
+
+const VideoCodec VideoCodecs[] =
+{
+    { "ffv1", { 'F', 'F', 'V', '1' }, ".mkv" },
+    { "mjpg", { 'M', 'J', 'P', 'G' }, ".avi" },
+    { "mp4v", { 'm', 'p', '4', 'v' }, ".mp4" },
+    { "avc1", { 'a', 'v', 'c', '1' }, ".mp4" },
+};
+
+const VideoCodec*
+FindVideoCodec(const std::string& name)
+{
+    for (int i = 0; i < sizeof(VideoCodecs) / sizeof(VideoCodecs[0]); ++i)
+    {
+        if (name == VideoCodecs[i].name)
+            return &VideoCodecs[i];
+    }
+    return NULL;
+}
+
+// A frame's auxiliary images by archive entry; normals with x, y and z as
+// the R, G and B channels of the file
+void
+GetAuxImages(const AuxImages& auxImages, std::vector<std::pair<ARCHIVE_ENTRY, cv::Mat> >& images)
+{
+    images.clear();
+    if (!auxImages.depth.empty())
+        images.push_back(std::make_pair(ENTRY_DEPTH, auxImages.depth));
+    if (!auxImages.shapeIds.empty())
+        images.push_back(std::make_pair(ENTRY_SHAPE_IDS, auxImages.shapeIds));
+    if (!auxImages.materialIds.empty())
+        images.push_back(std::make_pair(ENTRY_MATERIAL_IDS, auxImages.materialIds));
+    if (!auxImages.normals.empty())
+    {
+        cv::Mat normals;
+        cv::cvtColor(auxImages.normals, normals, cv::COLOR_RGB2BGR);
+        images.push_back(std::make_pair(ENTRY_NORMALS, normals));
+    }
+}
+
+// Through a temporary file of the same format, renamed into place
+bool
+WriteImage(const std::string& fileName, const cv::Mat& image)
+{
+    size_t dot = fileName.rfind('.');
+    std::string partFileName = fileName.substr(0, dot) + ".part" + fileName.substr(dot);
+    if (cv::imwrite(partFileName, image) && RenameFile(partFileName, fileName))
+        return true;
+    remove(partFileName.c_str());
+    return false;
+}
+
+// Float images as OpenEXR, indices as 16-bit PNG
+bool
+WriteAuxFiles(const std::string& imageBase, const AuxImages& auxImages)
+{
+    std::vector<std::pair<ARCHIVE_ENTRY, cv::Mat> > images;
+    GetAuxImages(auxImages, images);
+    bool isOk = true;
+    for (int i = 0; i < images.size(); ++i)
+        isOk = WriteImage(imageBase + OVFrameSink::GetAuxFileSuffix(images[i].first), images[i].second) && isOk;
+    return isOk;
+}
+
+// Numbered files, as frames have always been written
+class OVFileSink : public OVFrameSink
+{
+public:
+    OVFileSink(const OVFrameEncoder* encoder) : OVFrameSink(CONTAINER_FILES), _encoder(encoder) {}
+
+    bool open(const std::string& outputDir, const FrameLayout&)
+    {
+        _outputDir = outputDir;
+        return true;
+    }
+
+    bool close() { return true; }
+
+    bool writeImage(const PipelineFrame& frame, size_t& numBytes)
+    {
+        return _encoder->write(_outputDir + ZeroPadNumber(frame.frameIndex, 6), frame.image, &numBytes);
+    }
+
+    bool writeAuxImages(const PipelineFrame& frame)
+    {
+        return WriteAuxFiles(_outputDir + ZeroPadNumber(frame.frameIndex, 6), frame.auxImages);
+    }
+
+private:
+    const OVFrameEncoder* _encoder;
+    std::string           _outputDir;
+};
+
+// Encoded on the calling thread, then copied into the archive's chunks
+class OVArchiveSink : public OVFrameSink
+{
+public:
+    OVArchiveSink(const OVFrameEncoder* encoder) : OVFrameSink(CONTAINER_ARCHIVE), _encoder(encoder)
+    {
+        _isCropped = false;
+    }
+
+    bool open(const std::string& outputDir, const FrameLayout& layout)
+    {
+        _isCropped = layout.isCropped;
+        if (_archive.open(outputDir + OVFrameArchive::FileName, _encoder->getFormat(), layout.size))
+            return true;
+        _err = _archive.getError();
+        return false;
+    }
+
+    bool close()
+    {
+        if (_archive.close())
+            return true;
+        _err = _archive.getError();
+        return false;
+    }
+
+    bool writeImage(const PipelineFrame& frame, size_t& numBytes)
+    {
+        thread_local std::vector<unsigned char> buffer;
+        if (!_encoder->encode(frame.image, buffer))
+            return false;
+        numBytes = buffer.size();
+        return _archive.append(frame.frameIndex, ENTRY_IMAGE, buffer.data(), buffer.size()) && writeCrop(frame);
+    }
+
+    bool writeAuxImages(const PipelineFrame& frame)
+    {
+        std::vector<std::pair<ARCHIVE_ENTRY, cv::Mat> > images;
+        GetAuxImages(frame.auxImages, images);
+        std::vector<unsigned char> buffer;
+        for (int i = 0; i < images.size(); ++i)
+        {
+            std::string suffix = GetAuxFileSuffix(images[i].first);
+            if (!cv::imencode(suffix.substr(suffix.rfind('.')), images[i].second, buffer) ||
+                !_archive.append(frame.frameIndex, images[i].first, buffer.data(), buffer.size()))
+                return false;
+        }
+        // An archive of auxiliary images alone has crops of its own
+        return frame.auxSink == frame.sink || writeCrop(frame);
+    }
+
+private:
+    bool writeCrop(const PipelineFrame& frame)
+    {
+        int crop[4] = { frame.crop.x, frame.crop.y, frame.crop.width, frame.crop.height };
+        return !_isCropped || _archive.append(frame.frameIndex, ENTRY_CROP, (const unsigned char*)crop, sizeof(crop));
+    }
+
+    const OVFrameEncoder* _encoder;
+    OVFrameArchive        _archive;
+    bool                  _isCropped;
+};
+
+// Frames finish out of order, so they wait until those before them are in
+// the video. The video is written aside and renamed into place on close.
+class OVVideoSink : public OVFrameSink
+{
+public:
+    OVVideoSink(const VideoSettings& settings) : OVFrameSink(CONTAINER_VIDEO), _settings(settings)
+    {
+        _nextFrame = 0;
+    }
+
+    bool open(const std::string& outputDir, const FrameLayout& layout)
+    {
+        const VideoCodec* codec = FindVideoCodec(_settings.codec);
+        if (layout.isCropped)
+        {
+            _err = "Video frames cannot be cropped";
+            return false;
+        }
+        _outputDir = outputDir;
+        _fileName = outputDir + "frames" + (codec ? codec->extension : "");
+        _partFileName = outputDir + "frames.part" + (codec ? codec->extension : "");
+        _nextFrame = 0;
+        _pendingFrames.clear();
+        int fourcc = codec ? cv::VideoWriter::fourcc(codec->fourcc[0], codec->fourcc[1], codec->fourcc[2],
+                                                     codec->fourcc[3]) : 0;
+        if (!codec || !_writer.open(_partFileName, fourcc, _settings.fps, layout.size, true))
+        {
+            _err = "Cannot write the " + _settings.codec + " video \"" + _fileName + "\"";
+            return false;
+        }
+        if (_settings.quality >= 0)
+            _writer.set(cv::VIDEOWRITER_PROP_QUALITY, _settings.quality);
+        return true;
+    }
+
+    bool close()
+    {
+        if (!_writer.isOpened())
+            return _err.empty();
+
+        // Frames left behind a gap, after a stop, still go in order
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto frame = _pendingFrames.begin(); frame != _pendingFrames.end(); ++frame)
+            _writer.write(frame->second);
+        _pendingFrames.clear();
+        _writer.release();
+        if (!RenameFile(_partFileName, _fileName))
+        {
+            _err = "Cannot rename \"" + _partFileName + "\" to \"" + _fileName + "\"";
+            return false;
+        }
+        return true;
+    }
+
+    bool writeImage(const PipelineFrame& frame, size_t& numBytes)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        numBytes = 0;
+        _pendingFrames[frame.frameIndex] = frame.image;
+        while (!_pendingFrames.empty() && _pendingFrames.begin()->first == _nextFrame)
+        {
+            _writer.write(_pendingFrames.begin()->second);
+            _pendingFrames.erase(_pendingFrames.begin());
+            ++_nextFrame;
+        }
+        return true;
+    }
+
+    bool writeAuxImages(const PipelineFrame& frame)
+    {
+        return WriteAuxFiles(_outputDir + ZeroPadNumber(frame.frameIndex, 6), frame.auxImages);
+    }
+
+private:
+    VideoSettings           _settings;
+    std::string             _outputDir;
+    std::string             _fileName;
+    std::string             _partFileName;
+    cv::VideoWriter         _writer;
+    std::mutex              _mutex;
+    std::map<int, cv::Mat>  _pendingFrames;
+    int                     _nextFrame;
+};
+
+// Frames handed to another process through shared memory, with their
+// auxiliary images, pose and intrinsics, in the order they finish. Nothing
+// is written to the output directory.
+class OVRingSink : public OVFrameSink
+{
+public:
+    OVRingSink(const RingSettings& settings) : OVFrameSink(CONTAINER_RING), _settings(settings) {}
+
+    bool open(const std::string&, const FrameLayout& layout)
+    {
+        unsigned int planes = 1u << OV_RING_COLOR;
+        if (layout.auxOutputs & AUX_DEPTH)
+            planes |= 1u << OV_RING_DEPTH;
+        if (layout.auxOutputs & AUX_IDS)
+            planes |= (1u << OV_RING_SHAPE_IDS) | (1u << OV_RING_MATERIAL_IDS);
+        if (layout.auxOutputs & AUX_NORMALS)
+            planes |= 1u << OV_RING_NORMALS;
+        _cameraMatrix = layout.cameraMatrix;
+        if (_ring.create(_settings.name, _settings.numSlots, layout.size, planes))
+            return true;
+        _err = _ring.getError();
+        return false;
+    }
+
+    bool close()
+    {
+        _ring.close();
+        return true;
+    }
+
+    void cancel() { _ring.cancel(); }
+
+    bool writeImage(const PipelineFrame& frame, size_t& numBytes)
+    {
+        cv::Mat planes[OV_RING_PLANE_COUNT];
+        planes[OV_RING_COLOR] = frame.image;
+        planes[OV_RING_DEPTH] = frame.auxImages.depth;
+        planes[OV_RING_SHAPE_IDS] = frame.auxImages.shapeIds;
+        planes[OV_RING_MATERIAL_IDS] = frame.auxImages.materialIds;
+        planes[OV_RING_NORMALS] = frame.auxImages.normals;
+        numBytes = 0;
+        if (_ring.publish(frame.lineIndex, frame.frameIndex, frame.pose, _cameraMatrix, frame.crop, planes))
+            return true;
+        _err = _ring.getError();
+        return false;
+    }
+
+    // Published with the image
+    bool writeAuxImages(const PipelineFrame&) { return true; }
+
+private:
+    RingSettings _settings;
+    Mat3         _cameraMatrix;
+    OVFrameRing  _ring;
+};
+
+} // namespace
+
+OVFrameSink*
+OVFrameSink::Create(FRAME_CONTAINER container, const OVFrameEncoder* encoder, const VideoSettings& video,
+                    const RingSettings& ring)
+{
+    switch (container)
+    {
+    case CONTAINER_FILES:
+        return new OVFileSink(encoder);
+    case CONTAINER_ARCHIVE:
+        return new OVArchiveSink(encoder);
+    case CONTAINER_VIDEO:
+        return new OVVideoSink(video);
+    case CONTAINER_RING:
+        return new OVRingSink(ring);
+    default:
+        return NULL;
+    }
+}
+
+bool
+OVFrameSink::ParseContainer(const std::string& name, FRAME_CONTAINER& container)
+{
+    for (int i = 0; i < CONTAINER_COUNT; ++i)
+    {
+        if (name == ContainerNames[i])
+        {
+            container = (FRAME_CONTAINER)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char*
+OVFrameSink::GetContainerName(FRAME_CONTAINER container)
+{
+    return (container >= 0 && container < CONTAINER_COUNT) ? ContainerNames[container] : "";
+}
+
+bool
+OVFrameSink::IsValidVideoCodec(const std::string& codec)
+{
+    return FindVideoCodec(codec) != NULL;
+}
+
+void
+OVFrameSink::GetAuxEntries(int auxOutputs, std::vector<ARCHIVE_ENTRY>& types)
+{
+    types.clear();
+    if (auxOutputs & AUX_DEPTH)
+        types.push_back(ENTRY_DEPTH);
+    if (auxOutputs & AUX_IDS)
+    {
+        types.push_back(ENTRY_SHAPE_IDS);
+        types.push_back(ENTRY_MATERIAL_IDS);
+    }
+    if (auxOutputs & AUX_NORMALS)
+        types.push_back(ENTRY_NORMALS);
+}
+
+const char*
+OVFrameSink::GetAuxFileSuffix(ARCHIVE_ENTRY type)
+{
+    switch (type)
+    {
+    case ENTRY_DEPTH:
+        return "_depth.exr";
+    case ENTRY_SHAPE_IDS:
+        return "_shape.png";
+    case ENTRY_MATERIAL_IDS:
+        return "_material.png";
+    case ENTRY_NORMALS:
+        return "_normal.exr";
+    default:
+        return "";
+    }
+}
+
+} // namespace ov
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include "OVFrameStats.h"
+
+namespace ov
+{
+
+namespace
+{
+
+const char* const PhaseNames[PHASE_COUNT] = { "background", "foreground", "swap" };
+
+} // namespace
+
+OVFrameStats::OVFrameStats()
+{
+    _isEnabled = false;
+    clear();
+}
+
+void
+OVFrameStats::clear()
+{
+    _frameIndex = 0;
+    _records.clear();
+}
+
+void
+OVFrameStats::beginFrame()
+{
+    if (!_isEnabled)
+        return;
+
+    _current.frameIndex = _frameIndex;
+    for (int i = 0; i < PHASE_COUNT; ++i)
+    {
+        _current.cpuMs[i] = 0;
+        _current.gpuMs[i] = -1;
+    }
+    _frameStart = Clock::now();
+}
+
+void
+OVFrameStats::beginPhase(int phase)
+{
+    if (_isEnabled)
+        _phaseStart[phase] = Clock::now();
+}
+
+void
+OVFrameStats::endPhase(int phase)
+{
+    if (_isEnabled)
+        _current.cpuMs[phase] += Milliseconds(_phaseStart[phase], Clock::now());
+}
+
+void
+OVFrameStats::endFrame(int triangleCount, int drawCallCount, int stateChangeCount)
+{
+    if (!_isEnabled)
+        return;
+
+    _current.totalMs = Milliseconds(_frameStart, Clock::now());
+    _current.triangleCount = triangleCount;
+    _current.drawCallCount = drawCallCount;
+    _current.stateChangeCount = stateChangeCount;
+    _records.push_back(_current);
+    ++_frameIndex;
+}
+
+void
+OVFrameStats::setGpuTime(int frameIndex, int phase, double milliseconds)
+{
+    // Frame indices are consecutive, so the record is found by offset
+    if (_records.empty())
+        return;
+    int offset = frameIndex - _records.front().frameIndex;
+    if (offset >= 0 && offset < (int)_records.size())
+        _records[offset].gpuMs[phase] = milliseconds;
+}
+
+double
+OVFrameStats::getPercentile(int phase, double p, bool isGpu) const
+{
+    std::vector<double> values;
+    int first = std::max(0, (int)_records.size() - WindowSize);
+    for (int i = first; i < (int)_records.size(); ++i)
+    {
+        const FrameRecord& record = _records[i];
+        double value = (phase == PHASE_COUNT) ? record.totalMs
+                     : (isGpu ? record.gpuMs[phase] : record.cpuMs[phase]);
+        if (value >= 0)
+            values.push_back(value);
+    }
+    if (values.empty())
+        return -1;
+
+    // Nearest rank
+    int rank = std::min((int)values.size() - 1, std::max(0, (int)(p / 100.0 * values.size() + 0.5) - 1));
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
+}
+
+std::vector<std::string>
+OVFrameStats::getSummary() const
+{
+    std::vector<std::string> lines;
+    if (_records.empty())
+        return lines;
+
+    char line[256];
+    snprintf(line, sizeof(line), "frame   %6.2f %6.2f %6.2f ms (p50 p95 p99)",
+             getPercentile(PHASE_COUNT, 50), getPercentile(PHASE_COUNT, 95), getPercentile(PHASE_COUNT, 99));
+    lines.push_back(line);
+    for (int i = 0; i < PHASE_COUNT; ++i)
+    {
+        int n = snprintf(line, sizeof(line), "%-7.7s %6.2f %6.2f %6.2f", PhaseNames[i],
+                         getPercentile(i, 50), getPercentile(i, 95), getPercentile(i, 99));
+        double gpu = getPercentile(i, 50, true);
+        if (gpu >= 0)
+            snprintf(line + n, sizeof(line) - n, "  gpu %6.2f %6.2f", gpu, getPercentile(i, 95, true));
+        lines.push_back(line);
+    }
+    const FrameRecord& last = _records.back();
+    snprintf(line, sizeof(line), "%d tris, %d draws, %d state changes",
+             last.triangleCount, last.drawCallCount, last.stateChangeCount);
+    lines.push_back(line);
+
+    return lines;
+}
+
+bool
+OVFrameStats::writeCsv(const std::string& filename) const
+{
+    std::ofstream csv(filename);
+    if (!csv.is_open())
+        return false;
+
+    csv << "frame,total_ms";
+    for (int i = 0; i < PHASE_COUNT; ++i)
+        csv << "," << PhaseNames[i] << "_cpu_ms," << PhaseNames[i] << "_gpu_ms";
+    csv << ",triangles,draw_calls,state_changes\n";
+    for (int r = 0; r < (int)_records.size(); ++r)
+    {
+        const FrameRecord& record = _records[r];
+        csv << record.frameIndex << "," << record.totalMs;
+        for (int i = 0; i < PHASE_COUNT; ++i)
+        {
+            csv << "," << record.cpuMs[i] << ",";
+            if (record.gpuMs[i] >= 0)
+                csv << record.gpuMs[i];
+        }
+        csv << "," << record.triangleCount << "," << record.drawCallCount << "," << record.stateChangeCount << "\n";
+    }
+
+    return csv.good();
+}
+
+double
+OVFrameStats::Milliseconds(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+} // namespace ov
@@ -0,0 +1,111 @@
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include "OVGL.h"
+#if defined(_WIN32)
+// wglGetProcAddress is declared by <windows.h>
+#elif defined(OV_USE_EGL)
+#include <EGL/egl.h>
+#else
+#include <GL/glx.h>
+#endif
+
+namespace ov
+{
+
+namespace gl
+{
+
+#define OV_GL_DEFINE(ret, name, args) name##Proc name = NULL;
+OV_GL_FUNCTIONS(OV_GL_DEFINE)
+#undef OV_GL_DEFINE
+
+bool HasPixelBuffers = false;
+bool HasTimerQueries = false;
+
+} // namespace gl
+
+namespace
+{
+
+void
+GetGLVersion(int& major, int& minor)
+{
+    major = minor = 0;
+    const char* version = (const char*)glGetString(GL_VERSION);
+    if (!version)
+        return;
+    // OpenGL ES puts its name in front of the numbers
+    while (*version && !isdigit((unsigned char)*version))
+        ++version;
+    sscanf(version, "%d.%d", &major, &minor);
+}
+
+bool
+HasGLExtension(int major, const char* name)
+{
+    // Core profiles only list the extensions one by one
+    if (major >= 3 && gl::GetStringi)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i)
+        {
+            const char* extension = (const char*)gl::GetStringi(GL_EXTENSIONS, i);
+            if (extension && strcmp(extension, name) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+    size_t length = strlen(name);
+    for (const char* found = extensions ? strstr(extensions, name) : NULL; found; found = strstr(found + length, name))
+    {
+        if ((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == '\0'))
+            return true;
+    }
+    return false;
+}
+
+bool
+IsGLVersion(int major, int minor, int requiredMajor, int requiredMinor)
+{
+    return major > requiredMajor || (major == requiredMajor && minor >= requiredMinor);
+}
+
+} // namespace
+
+void*
+GetGLProcAddress(const char* name)
+{
+#if defined(_WIN32)
+    return (void*)wglGetProcAddress(name);
+#elif defined(OV_USE_EGL)
+    return (void*)eglGetProcAddress(name);
+#else
+    return (void*)glXGetProcAddressARB((const GLubyte*)name);
+#endif
+}
+
+bool
+LoadGLFunctions(GLProcAddressFn getProcAddress)
+{
+    bool isComplete = true;
+#define OV_GL_LOAD(ret, name, args) \
+    gl::name = (gl::name##Proc)getProcAddress("gl" #name); \
+    if (gl::name == NULL) \
+        isComplete = false;
+    OV_GL_FUNCTIONS(OV_GL_LOAD)
+#undef OV_GL_LOAD
+
+    int major, minor;
+    GetGLVersion(major, minor);
+    gl::HasPixelBuffers = (IsGLVersion(major, minor, 2, 1) || HasGLExtension(major, "GL_ARB_pixel_buffer_object"))
+        && gl::GenBuffers && gl::DeleteBuffers && gl::BindBuffer && gl::BufferData && gl::MapBuffer && gl::UnmapBuffer;
+    gl::HasTimerQueries = (IsGLVersion(major, minor, 3, 3) || HasGLExtension(major, "GL_ARB_timer_query"))
+        && gl::GenQueries && gl::DeleteQueries && gl::QueryCounter && gl::GetQueryObjectiv && gl::GetQueryObjectui64v;
+    return isComplete;
+}
+
+} // namespace ov
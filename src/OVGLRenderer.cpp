@@ -0,0 +1,393 @@
+#include <opencv2/opencv.hpp>
+#include <cstring>
+#include "OVGLRenderer.h"
+#include "OVTexture.h"
+
+namespace ov
+{
+
+OVGLRenderer::OVGLRenderer(OVRenderContext* context)
+{
+    _context = context;
+    memset(_readbacks, 0, sizeof(_readbacks));
+    _readbackHead = 0;
+    _readbackCount = 0;
+}
+
+OVGLRenderer::~OVGLRenderer()
+{
+}
+
+void
+OVGLRenderer::release()
+{
+    for (int i = 0; i < ReadbackRingSize; ++i)
+    {
+        if (_readbacks[i].buffer)
+            gl::DeleteBuffers(1, &_readbacks[i].buffer);
+    }
+    memset(_readbacks, 0, sizeof(_readbacks));
+    _readbackHead = 0;
+    _readbackCount = 0;
+
+    releaseTextures(_textureIds);
+    _textureIds.clear();
+    _background.release();
+    _gpuTimer.release();
+}
+
+bool
+OVGLRenderer::init()
+{
+    LoadGLFunctions(_context->getProcAddressFn());
+
+    // OpenGL initialization
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glShadeModel(GL_SMOOTH);
+    glEnable(GL_TEXTURE_2D);
+    _background.init();
+
+    glEnable(GL_LIGHT0);
+    glEnable(GL_LIGHT1);
+    glEnable(GL_LIGHT2);
+    glEnable(GL_LIGHT3);
+
+    return true;
+}
+
+void
+OVGLRenderer::render()
+{
+    bool isTimed = _frameStats && _frameStats->isEnabled();
+    if (isTimed)
+    {
+        _gpuTimer.collect(*_frameStats);
+        _gpuTimer.beginFrame(_frameStats->getFrameIndex());
+        _frameStats->beginPhase(PHASE_BACKGROUND);
+        _gpuTimer.beginPhase(PHASE_BACKGROUND);
+    }
+
+    glViewport(0, 0, (GLsizei)_viewportWidth, (GLsizei)_viewportHeight);
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrixd(_projectionMatrix);
+
+    // Render the background image
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_TEXTURE_2D);
+    glDisable(GL_LIGHTING);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    drawBackground(_background.getTextureId());
+    glDisable(GL_TEXTURE_2D);
+
+    if (isTimed)
+    {
+        _frameStats->endPhase(PHASE_BACKGROUND);
+        _frameStats->beginPhase(PHASE_FOREGROUND);
+        _gpuTimer.beginPhase(PHASE_FOREGROUND);
+    }
+
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    if (_lightingOn)
+        setupLights();
+
+    // Render the foreground target
+    Mat4 modelViewMatrix = getModelViewMatrix();
+    glLoadMatrixd(modelViewMatrix.data());
+
+    // Semitransparent effect
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (_renderMode == RENDER_SOLID)
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    else
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    drawForeground(_drawList, _materials);
+    glDisable(GL_BLEND);
+
+    if (isTimed)
+    {
+        _gpuTimer.endFrame();
+        _frameStats->endPhase(PHASE_FOREGROUND);
+    }
+
+    glFlush();
+}
+
+void
+OVGLRenderer::readPixels(cv::Mat& image)
+{
+    cv::Rect region = getReadRegion();
+    int w = region.width;
+    int h = region.height;
+
+    image.create(h, w, CV_8UC3);
+
+    // Byte alignment (that is, no alignment)
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    // Read pixels from GPU memory, whose rows start at the bottom
+    glReadPixels(region.x, _viewportHeight - region.y - h, w, h, GL_BGR, GL_UNSIGNED_BYTE, image.data);
+
+    // Flip around the x-axis
+    cv::flip(image, image, 0);
+}
+
+void
+OVGLRenderer::queueReadPixels()
+{
+    if (!hasPixelBuffers())
+    {
+        OVRenderer::queueReadPixels();
+        return;
+    }
+
+    // The caller collects a frame before queueing past the ring size
+    Readback& readback = _readbacks[(_readbackHead + _readbackCount) % ReadbackRingSize];
+    ++_readbackCount;
+    cv::Rect region = getReadRegion();
+    readback.width = region.width;
+    readback.height = region.height;
+    GLsizeiptr size = (GLsizeiptr)readback.width * readback.height * 3;
+
+    // Buffers only grow, as regions change size from frame to frame
+    if (readback.buffer == 0)
+        gl::GenBuffers(1, &readback.buffer);
+    gl::BindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    if (readback.size < size)
+    {
+        gl::BufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        readback.size = size;
+    }
+
+    // Returns at once; the transfer completes while the next frame renders
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(region.x, _viewportHeight - region.y - region.height, readback.width, readback.height, GL_BGR,
+                 GL_UNSIGNED_BYTE, 0);
+    gl::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+bool
+OVGLRenderer::collectPixels(cv::Mat& image)
+{
+    if (!hasPixelBuffers())
+        return OVRenderer::collectPixels(image);
+    if (_readbackCount == 0)
+        return false;
+
+    Readback& readback = _readbacks[_readbackHead];
+    _readbackHead = (_readbackHead + 1) % ReadbackRingSize;
+    --_readbackCount;
+
+    int w = readback.width;
+    int h = readback.height;
+    image.create(h, w, CV_8UC3);
+
+    gl::BindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    const uchar* pixels = (const uchar*)gl::MapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    if (pixels)
+    {
+        // Flip around the x-axis while copying out
+        for (int y = 0; y < h; ++y)
+            memcpy(image.ptr<uchar>(y), pixels + (size_t)(h - 1 - y) * w * 3, (size_t)w * 3);
+        gl::UnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    gl::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    return pixels != NULL;
+}
+
+int
+OVGLRenderer::getReadbackQueueSize() const
+{
+    return hasPixelBuffers() ? ReadbackRingSize : OVRenderer::getReadbackQueueSize();
+}
+
+int
+OVGLRenderer::getQueuedReadbackCount() const
+{
+    return hasPixelBuffers() ? _readbackCount : OVRenderer::getQueuedReadbackCount();
+}
+
+bool
+OVGLRenderer::loadTextures(std::vector<tinyobj::material_t>& materials,
+                           std::unordered_map<std::string, unsigned int>& textureIds,
+                           const std::string& dir)
+{
+    return LoadTextures(materials, textureIds, dir);
+}
+
+void
+OVGLRenderer::releaseTextures(const std::unordered_map<std::string, unsigned int>& textureIds)
+{
+    for (auto it = textureIds.begin(); it != textureIds.end(); ++it)
+        glDeleteTextures(1, &it->second);
+}
+
+void
+OVGLRenderer::uploadBackground()
+{
+    _background.upload(_backgroundImage);
+}
+
+void
+OVGLRenderer::drawOverlay(const cv::Mat& image, int x, int y)
+{
+    // Pixel coordinates with the origin at the top left
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, _viewportWidth, _viewportHeight, 0, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glPushAttrib(GL_ENABLE_BIT);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_TEXTURE_2D);
+    glDisable(GL_BLEND);
+
+    // Rows go downwards from the raster position
+    glRasterPos2i(x, y);
+    glPixelZoom(1, -1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glDrawPixels(image.cols, image.rows, GL_BGR, GL_UNSIGNED_BYTE, image.data);
+    glPixelZoom(1, 1);
+
+    glPopAttrib();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+}
+
+bool
+OVGLRenderer::hasPixelBuffers() const
+{
+    return gl::HasPixelBuffers;
+}
+
+void
+OVGLRenderer::setupLights()
+{
+    const GLfloat a[] = { 0.1f, 0.1f, 0.1f, 1.0f };
+    const GLfloat d[] = { 0.5f, 0.5f, 0.5f, 1.0f };
+    const GLfloat s[] = { 0.1f, 0.1f, 0.1f, 1.0f };
+    const GLfloat p0[] = { 7.0f, 0.0f, 0.0f, 1.0f };
+    const GLfloat p1[] = { -7.0f, 0.0f, 0.0f, 1.0f };
+    const GLfloat p2[] = { 0.0f, 7.0f, 0.0f, 1.0f };
+    const GLfloat p3[] = { 0.0f, -7.0f, 0.0f, 1.0f };
+    glLightfv(GL_LIGHT0, GL_AMBIENT, a);
+    glLightfv(GL_LIGHT0, GL_DIFFUSE, d);
+    glLightfv(GL_LIGHT0, GL_SPECULAR, s);
+    glLightfv(GL_LIGHT0, GL_POSITION, p0);
+    glLightfv(GL_LIGHT1, GL_AMBIENT, a);
+    glLightfv(GL_LIGHT1, GL_DIFFUSE, d);
+    glLightfv(GL_LIGHT1, GL_SPECULAR, s);
+    glLightfv(GL_LIGHT1, GL_POSITION, p1);
+    glLightfv(GL_LIGHT2, GL_AMBIENT, a);
+    glLightfv(GL_LIGHT2, GL_DIFFUSE, d);
+    glLightfv(GL_LIGHT2, GL_SPECULAR, s);
+    glLightfv(GL_LIGHT2, GL_POSITION, p2);
+    glLightfv(GL_LIGHT3, GL_AMBIENT, a);
+    glLightfv(GL_LIGHT3, GL_DIFFUSE, d);
+    glLightfv(GL_LIGHT3, GL_SPECULAR, s);
+    glLightfv(GL_LIGHT3, GL_POSITION, p3);
+    glEnable(GL_LIGHTING);
+}
+
+void
+OVGLRenderer::drawBackground(GLuint backgroundImageTextureId)
+{
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(-1, 1, -1, 1, 0, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+
+    // Draw the quad textured with the background image
+    glBindTexture(GL_TEXTURE_2D, backgroundImageTextureId);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0, 1);
+    glVertex2f(-1, -1);
+    glTexCoord2f(0, 0);
+    glVertex2f(-1, 1);
+    glTexCoord2f(1, 0);
+    glVertex2f(1, 1);
+    glTexCoord2f(1, 1);
+    glVertex2f(1, -1);
+    glEnd();
+
+    // Reset the projection matrix
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+}
+
+void
+OVGLRenderer::drawForeground(const OVDrawList& drawList,
+                             const std::vector<tinyobj::material_t>& materials)
+{
+    const std::vector<DrawBatch>& batches = drawList.batches();
+    if (batches.empty())
+        return;
+
+    glDisable(GL_COLOR_MATERIAL);
+    glEnable(GL_TEXTURE_2D);
+    glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, &drawList.positions()[0]);
+    glNormalPointer(GL_FLOAT, 0, &drawList.normals()[0]);
+    glTexCoordPointer(2, GL_FLOAT, 0, &drawList.texcoords()[0]);
+
+    int preId = -2;
+    GLuint preTextureId = 0;
+    glBindTexture(GL_TEXTURE_2D, 0);
+    for (int b = 0; b < batches.size(); ++b)
+    {
+        const DrawBatch& batch = batches[b];
+        if (batch.materialId != preId)
+        {
+            // The OpenGL default material is used for faces without one
+            GLfloat ambient[4] = { 0.2f, 0.2f, 0.2f, 1.0f };
+            GLfloat diffuse[4] = { 0.8f, 0.8f, 0.8f, 1.0f };
+            GLfloat specular[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+            GLfloat shininess = 0.0f;
+            if (batch.materialId >= 0)
+            {
+                const tinyobj::material_t& material = materials[batch.materialId];
+                memcpy(ambient, material.ambient, 3 * sizeof(float));
+                memcpy(diffuse, material.diffuse, 3 * sizeof(float));
+                memcpy(specular, material.specular, 3 * sizeof(float));
+                ambient[3] = diffuse[3] = specular[3] = material.dissolve;
+                shininess = material.shininess;
+            }
+            glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, ambient);
+            glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, diffuse);
+            glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, specular);
+            glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, shininess);
+            preId = batch.materialId;
+        }
+        if (batch.textureId != preTextureId)
+        {
+            glBindTexture(GL_TEXTURE_2D, batch.textureId);
+            preTextureId = batch.textureId;
+        }
+
+        glDrawElements(GL_TRIANGLES, batch.indexCount, GL_UNSIGNED_INT, &drawList.indices()[batch.firstIndex]);
+    }
+
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+} // namespace ov
@@ -0,0 +1,131 @@
+#include <cstring>
+#include "OVGLTimer.h"
+
+namespace ov
+{
+
+OVGLTimer::OVGLTimer()
+{
+    memset(_slots, 0, sizeof(_slots));
+    _current = -1;
+    _next = 0;
+    _hasQueries = false;
+}
+
+bool
+OVGLTimer::isSupported() const
+{
+    return gl::HasTimerQueries;
+}
+
+void
+OVGLTimer::release()
+{
+    if (!_hasQueries)
+        return;
+
+    for (int i = 0; i < Latency; ++i)
+    {
+        gl::DeleteQueries(PHASE_COUNT + 1, _slots[i].queries);
+        _slots[i].isPending = false;
+    }
+    _hasQueries = false;
+}
+
+void
+OVGLTimer::beginFrame(int frameIndex)
+{
+    if (!isSupported())
+        return;
+    if (!_hasQueries)
+    {
+        for (int i = 0; i < Latency; ++i)
+            gl::GenQueries(PHASE_COUNT + 1, _slots[i].queries);
+        _hasQueries = true;
+    }
+
+    // All slots busy: the oldest frame is dropped rather than waited for
+    Slot& slot = _slots[_next];
+    slot.isPending = false;
+    slot.frameIndex = frameIndex;
+    slot.markCount = 0;
+    _current = _next;
+    _next = (_next + 1) % Latency;
+}
+
+void
+OVGLTimer::beginPhase(int phase)
+{
+    if (_current < 0)
+        return;
+
+    Slot& slot = _slots[_current];
+    if (slot.markCount >= PHASE_COUNT)
+        return;
+    slot.phases[slot.markCount] = phase;
+    gl::QueryCounter(slot.queries[slot.markCount++], GL_TIMESTAMP);
+}
+
+void
+OVGLTimer::endFrame()
+{
+    if (_current < 0)
+        return;
+
+    Slot& slot = _slots[_current];
+    gl::QueryCounter(slot.queries[slot.markCount], GL_TIMESTAMP);
+    slot.isPending = (slot.markCount > 0);
+    _current = -1;
+}
+
+void
+OVGLTimer::collect(OVFrameStats& stats, bool isWaiting)
+{
+    // Oldest first, stopping at the first frame still in flight
+    for (int i = 0; i < Latency; ++i)
+    {
+        Slot& slot = _slots[(_next + i) % Latency];
+        if (!slot.isPending)
+            continue;
+
+        GLint isAvailable = GL_FALSE;
+        if (!isWaiting)
+            gl::GetQueryObjectiv(slot.queries[slot.markCount], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+        if (!isWaiting && !isAvailable)
+            return;
+
+        GLuint64 timestamps[PHASE_COUNT + 1];
+        for (int m = 0; m <= slot.markCount; ++m)
+            gl::GetQueryObjectui64v(slot.queries[m], GL_QUERY_RESULT, &timestamps[m]);
+        for (int m = 0; m < slot.markCount; ++m)
+            stats.setGpuTime(slot.frameIndex, slot.phases[m], (timestamps[m + 1] - timestamps[m]) * 1e-6);
+        slot.isPending = false;
+    }
+}
+
+bool
+OVGLTimer::collectFrame(int& frameIndex, double& milliseconds)
+{
+    for (int i = 0; i < Latency; ++i)
+    {
+        Slot& slot = _slots[(_next + i) % Latency];
+        if (!slot.isPending)
+            continue;
+
+        GLint isAvailable = GL_FALSE;
+        gl::GetQueryObjectiv(slot.queries[slot.markCount], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+        if (!isAvailable)
+            return false;
+
+        GLuint64 start = 0, end = 0;
+        gl::GetQueryObjectui64v(slot.queries[0], GL_QUERY_RESULT, &start);
+        gl::GetQueryObjectui64v(slot.queries[slot.markCount], GL_QUERY_RESULT, &end);
+        frameIndex = slot.frameIndex;
+        milliseconds = (end - start) * 1e-6;
+        slot.isPending = false;
+        return true;
+    }
+    return false;
+}
+
+} // namespace ov
@@ -0,0 +1,426 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include "OVBatch.h"
+#include "OVBatchCoordinator.h"
+#include "OVChildProcess.h"
+#include "OVFileUtil.h"
+#include "OVFrameEncoder.h"
+#include "OVGLRenderer.h"
+#include "OVHeadless.h"
+#include "OVOffscreenContext.h"
+#include "OVPoseSource.h"
+#include "OVShaderRenderer.h"
+#include "OVSoftRenderer.h"
+#include "OVThreadPool.h"
+
+namespace ov
+{
+
+namespace
+{
+
+enum EXIT_CODE
+{
+    EXIT_OK    = 0,
+    EXIT_ERROR = 1,
+    EXIT_USAGE = 2,
+};
+
+struct HeadlessOptions
+{
+    std::string batchFile;
+    std::string shardBatchFile;     // Served as a worker of a sharded run
+    std::string benchmarkImage;
+    std::string posesFile;          // Converted to binary
+    std::string outputFile;
+    std::string precision;
+    std::string renderer;
+    int         numThreads;
+    int         posesPerPass;
+    int         numWorkers;         // Processes of a sharded run, 0 for none
+};
+
+void
+PrintError(const std::string& msg)
+{
+    fprintf(stderr, "Error: %s\n", msg.c_str());
+}
+
+void
+PrintUsage()
+{
+    fprintf(stderr,
+            "Usage: objviewer --batch <file> [options]\n"
+            "       objviewer --benchmark-encoders <image>\n"
+            "       objviewer --convert-poses <file> --output <file> [--precision float64|float32]\n"
+            "  --threads <n>               Worker threads, 0 for one per hardware thread (0)\n"
+            "  --renderer gl|shader|software\n"
+            "                              Fixed-function or OpenGL 3.3 offscreen, or CPU (gl)\n"
+            "  --poses-per-pass <n>        Poses per pass of the shader renderer (1)\n"
+            "  --workers <n>               Worker processes sharing the batch, each with its\n"
+            "                              own renderer and a share of the threads (0)\n");
+}
+
+bool
+ParseInt(const char* text, int& value)
+{
+    char* end;
+    long number = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || number < 0 || number > 1 << 20)
+        return false;
+    value = (int)number;
+    return true;
+}
+
+bool
+ParseOptions(int argc, char** argv, HeadlessOptions& options)
+{
+    options.renderer = "gl";
+    options.precision = "float64";
+    options.numThreads = 0;
+    options.posesPerPass = 1;
+    options.numWorkers = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (arg == "--help" || arg == "-h")
+            return false;
+        if (!value)
+        {
+            PrintError("Missing value of " + arg);
+            return false;
+        }
+
+        if (arg == "--batch")
+            options.batchFile = value;
+        else if (arg == "--serve-shards")
+            options.shardBatchFile = value;
+        else if (arg == "--benchmark-encoders")
+            options.benchmarkImage = value;
+        else if (arg == "--convert-poses")
+            options.posesFile = value;
+        else if (arg == "--output")
+            options.outputFile = value;
+        else if (arg == "--precision")
+            options.precision = value;
+        else if (arg == "--renderer")
+            options.renderer = value;
+        else if (arg == "--threads")
+        {
+            if (!ParseInt(value, options.numThreads))
+            {
+                PrintError("Invalid thread count \"" + std::string(value) + "\"");
+                return false;
+            }
+        }
+        else if (arg == "--workers")
+        {
+            if (!ParseInt(value, options.numWorkers))
+            {
+                PrintError("Invalid worker count \"" + std::string(value) + "\"");
+                return false;
+            }
+        }
+        else if (arg == "--poses-per-pass")
+        {
+            if (!ParseInt(value, options.posesPerPass) || options.posesPerPass == 0)
+            {
+                PrintError("Invalid poses per pass \"" + std::string(value) + "\"");
+                return false;
+            }
+        }
+        else
+        {
+            PrintError("Unknown option " + arg);
+            return false;
+        }
+        ++i;
+    }
+
+    if (!options.posesFile.empty() && options.outputFile.empty())
+    {
+        PrintError("No output file for the converted poses");
+        return false;
+    }
+    if (options.precision != "float64" && options.precision != "float32")
+    {
+        PrintError("Unknown precision \"" + options.precision + "\"");
+        return false;
+    }
+    if (options.batchFile.empty() && options.shardBatchFile.empty() && options.benchmarkImage.empty() &&
+        options.posesFile.empty())
+    {
+        PrintError("No batch file");
+        return false;
+    }
+    if (options.renderer != "gl" && options.renderer != "shader" && options.renderer != "software")
+    {
+        PrintError("Unknown renderer \"" + options.renderer + "\"");
+        return false;
+    }
+
+    return true;
+}
+
+// Encode one image repeatedly with every format at a few settings, in
+// memory, and print the size and the single-thread throughput of each
+int
+RunEncoderBenchmark(const std::string& imageFile)
+{
+    cv::Mat image = cv::imread(imageFile, cv::IMREAD_COLOR);
+    if (image.empty())
+    {
+        PrintError("Cannot read \"" + imageFile + "\"");
+        return EXIT_ERROR;
+    }
+
+    static const struct
+    {
+        FRAME_FORMAT format;
+        int          quality;
+    } Settings[] =
+    {
+        { FORMAT_RAW,  -1 },
+        { FORMAT_PPM,  -1 },
+        { FORMAT_QOI,  -1 },
+        { FORMAT_PNG,  1 },
+        { FORMAT_PNG,  3 },
+        { FORMAT_PNG,  9 },
+        { FORMAT_JPEG, 75 },
+        { FORMAT_JPEG, 95 },
+    };
+
+    double rawSize = (double)image.total() * image.elemSize();
+    printf("%dx%d, %.0f bytes per frame unencoded\n", image.cols, image.rows, rawSize);
+    printf("format  quality  bytes/frame   ratio     MB/s\n");
+    std::vector<unsigned char> buffer;
+    for (int i = 0; i < sizeof(Settings) / sizeof(Settings[0]); ++i)
+    {
+        std::unique_ptr<OVFrameEncoder> encoder(OVFrameEncoder::Create(Settings[i].format, Settings[i].quality));
+
+        // At least half a second per setting, after one warm-up frame
+        if (!encoder->encode(image, buffer))
+        {
+            PrintError(std::string("Cannot encode ") + OVFrameEncoder::GetFormatName(Settings[i].format));
+            return EXIT_ERROR;
+        }
+        int numFrames = 0;
+        double seconds = 0;
+        auto startTime = std::chrono::steady_clock::now();
+        while (seconds < 0.5 || numFrames < 3)
+        {
+            encoder->encode(image, buffer);
+            ++numFrames;
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        }
+
+        std::string quality = Settings[i].quality >= 0 ? std::to_string(Settings[i].quality) : "-";
+        printf("%-6s  %7s  %11zu  %6.2f  %7.1f\n", OVFrameEncoder::GetFormatName(Settings[i].format), quality.c_str(),
+               buffer.size(), rawSize / buffer.size(), rawSize * numFrames / seconds / (1 << 20));
+    }
+    return EXIT_OK;
+}
+
+// Prints one line per job and per tenth of its frames, which keeps cluster logs short
+class ProgressPrinter
+{
+public:
+    ProgressPrinter() : _numFrames(0), _preLine(-1), _preDecile(-1) {}
+
+    bool print(const BatchProgress& progress)
+    {
+        int decile = (progress.frameIndex + 1) * 10 / std::max(progress.frameCount, 1);
+        if (progress.lineIndex != _preLine && progress.resumedCount > 0)
+        {
+            fprintf(stderr, "[line %d] %s: resuming, %d/%d frames already written\n", progress.lineIndex + 1,
+                    progress.job->posesFile.c_str(), progress.resumedCount, progress.frameCount);
+        }
+        if (progress.lineIndex != _preLine || decile != _preDecile)
+        {
+            fprintf(stderr, "[line %d] %s: frame %d/%d\n", progress.lineIndex + 1, progress.job->posesFile.c_str(),
+                    progress.frameIndex + 1, progress.frameCount);
+            _preLine = progress.lineIndex;
+            _preDecile = decile;
+        }
+        ++_numFrames;
+        return true;
+    }
+
+    int getFrameCount() const { return _numFrames; }
+
+private:
+    int _numFrames;
+    int _preLine;
+    int _preDecile;
+};
+
+// Shard the batch over worker processes running this program
+int
+RunCoordinator(const HeadlessOptions& options, const char* argv0)
+{
+    // Every worker takes an equal share of the hardware threads unless told otherwise
+    int numThreads = options.numThreads;
+    if (numThreads == 0)
+        numThreads = std::max((int)std::thread::hardware_concurrency() / options.numWorkers, 1);
+    std::vector<std::string> command;
+    command.push_back(OVChildProcess::GetExecutablePath(argv0));
+    command.push_back("--serve-shards");
+    command.push_back(options.batchFile);
+    command.push_back("--renderer");
+    command.push_back(options.renderer);
+    command.push_back("--threads");
+    command.push_back(std::to_string(numThreads));
+    command.push_back("--poses-per-pass");
+    command.push_back(std::to_string(options.posesPerPass));
+
+    OVBatchCoordinator coordinator;
+    ProgressPrinter printer;
+    coordinator.setProgressCallback([&printer](const BatchProgress& progress) { return printer.print(progress); });
+
+    auto startTime = std::chrono::steady_clock::now();
+    bool isOk = coordinator.run(options.batchFile, command, options.numWorkers);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (!isOk)
+    {
+        PrintError(coordinator.getError());
+        return EXIT_ERROR;
+    }
+    int numFrames = coordinator.getWrittenCount();
+    fprintf(stderr, "Wrote %d frames in %.1f s (%.1f frames/s) with %d workers\n", numFrames, seconds,
+            seconds > 0 ? numFrames / seconds : 0.0, options.numWorkers);
+    return EXIT_OK;
+}
+
+// Write a text, binary or generated poses file as a binary one
+int
+RunPoseConversion(const HeadlessOptions& options)
+{
+    std::string err;
+    std::unique_ptr<OVPoseSource> poses(OVPoseSource::Open(options.posesFile, err));
+    if (!poses || !OVPoseSource::WriteBinary(options.outputFile, *poses, options.precision == "float32", err))
+    {
+        PrintError(err);
+        return EXIT_ERROR;
+    }
+    fprintf(stderr, "Wrote %lld poses to %s\n", poses->getCount(), options.outputFile.c_str());
+    return EXIT_OK;
+}
+
+} // namespace
+
+bool
+IsHeadlessCommand(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--batch") == 0 || strcmp(argv[i], "--benchmark-encoders") == 0 ||
+            strcmp(argv[i], "--convert-poses") == 0 || strcmp(argv[i], "--serve-shards") == 0)
+            return true;
+    }
+    return false;
+}
+
+int
+RunHeadless(int argc, char** argv)
+{
+    HeadlessOptions options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage();
+        return EXIT_USAGE;
+    }
+
+    // Errors reported anywhere in the pipeline must not open message boxes
+    SetErrorHandler(PrintError);
+    OVThreadPool::DefaultThreadCount = options.numThreads;
+    if (!options.benchmarkImage.empty())
+        return RunEncoderBenchmark(options.benchmarkImage);
+    if (!options.posesFile.empty())
+        return RunPoseConversion(options);
+    if (options.numWorkers > 0 && options.shardBatchFile.empty())
+        return RunCoordinator(options, argv[0]);
+
+    // The drawable is resized to every job's frame size
+    OVOffscreenContext context;
+    std::unique_ptr<OVRenderer> renderer;
+    OVShaderRenderer* shaderRenderer = NULL;
+    if (options.renderer == "software")
+        renderer.reset(new OVSoftRenderer());
+    else
+    {
+        bool isShader = (options.renderer == "shader");
+        std::string err;
+        context.setCoreProfile(isShader);
+        if (!context.create(OFFSCREEN_AUTO, 640, 480, err))
+        {
+            PrintError(err);
+            return EXIT_ERROR;
+        }
+        if (isShader)
+            renderer.reset(shaderRenderer = new OVShaderRenderer(&context));
+        else
+            renderer.reset(new OVGLRenderer(&context));
+    }
+    if (!renderer->init())
+    {
+        PrintError(shaderRenderer ? shaderRenderer->getError() : "Cannot initialize the renderer");
+        return EXIT_ERROR;
+    }
+
+    OVBatchGenerator generator(renderer.get(), context.isValid() ? &context : NULL);
+    generator.setPosesPerPass(options.posesPerPass);
+    if (!options.shardBatchFile.empty())
+    {
+        // The coordinator reports the errors
+        std::string err;
+        bool isWorkerOk = OVBatchCoordinator::RunWorker(generator, options.shardBatchFile, err);
+        renderer->release();
+        return isWorkerOk ? EXIT_OK : EXIT_ERROR;
+    }
+    ProgressPrinter printer;
+    generator.setProgressCallback([&printer](const BatchProgress& progress) { return printer.print(progress); });
+
+    auto startTime = std::chrono::steady_clock::now();
+    bool isOk = generator.run(options.batchFile);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    renderer->release();
+    renderer.reset();
+    context.destroy();
+
+    if (!isOk)
+    {
+        PrintError(generator.getError());
+        return EXIT_ERROR;
+    }
+    int numFrames = printer.getFrameCount();
+    fprintf(stderr, "Wrote %d frames in %.1f s (%.1f frames/s)\n", numFrames, seconds,
+            seconds > 0 ? numFrames / seconds : 0.0);
+
+    // A stage whose queue is mostly full is the bottleneck
+    const std::vector<PipelineStageStats>& stats = generator.getPipelineStats();
+    for (int i = 0; i < stats.size(); ++i)
+    {
+        fprintf(stderr, "  %-8s %2d workers, queue %.1f/%d on average, %d at most\n", stats[i].name.c_str(),
+                stats[i].numWorkers, stats[i].meanOccupancy, stats[i].capacity, stats[i].maxOccupancy);
+    }
+
+    // Per encoding thread, so comparable between formats whatever the worker count
+    EncodeStats encodeStats;
+    generator.getEncodeStats(encodeStats);
+    // Videos encode inside OpenCV, with no size per frame
+    if (encodeStats.numFrames > 0 && encodeStats.seconds > 0 && encodeStats.numBytes > 0)
+    {
+        fprintf(stderr, "  %lld bytes per frame (%.2f:1), encoded at %.1f MB/s per thread\n",
+                encodeStats.numBytes / encodeStats.numFrames, (double)encodeStats.numRawBytes / encodeStats.numBytes,
+                encodeStats.numRawBytes / encodeStats.seconds / (1 << 20));
+    }
+    return EXIT_OK;
+}
+
+} // namespace ov
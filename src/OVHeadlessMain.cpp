@@ -0,0 +1,10 @@
+#include "OVHeadless.h"
+
+// Entry point of the headless build (CMakeLists.txt), which leaves out the
+// viewer and wxWidgets. The viewer's main in main.cpp takes the same command
+// line.
+int
+main(int argc, char** argv)
+{
+    return ov::RunHeadless(argc, argv);
+}
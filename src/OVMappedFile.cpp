@@ -0,0 +1,111 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "OVMappedFile.h"
+
+namespace ov
+{
+
+OVMappedFile::OVMappedFile()
+{
+    _data = NULL;
+    _size = 0;
+    _isOpen = false;
+#ifdef _WIN32
+    _file = INVALID_HANDLE_VALUE;
+    _mapping = NULL;
+#endif
+}
+
+OVMappedFile::~OVMappedFile()
+{
+    close();
+}
+
+bool
+OVMappedFile::open(const std::string& fileName, bool isSequential)
+{
+    close();
+
+#ifdef _WIN32
+    DWORD flags = isSequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+    _file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, NULL);
+    if (_file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(_file, &size))
+    {
+        close();
+        return false;
+    }
+    _size = (size_t)size.QuadPart;
+    if (_size > 0)
+    {
+        // Files cannot be mapped with a size of 0
+        _mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (_mapping)
+            _data = (const char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!_data)
+        {
+            close();
+            return false;
+        }
+    }
+#else
+    int file = ::open(fileName.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+    struct stat info;
+    if (fstat(file, &info) != 0)
+    {
+        ::close(file);
+        return false;
+    }
+    _size = (size_t)info.st_size;
+    if (_size > 0)
+    {
+        void* data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data == MAP_FAILED)
+        {
+            ::close(file);
+            _size = 0;
+            return false;
+        }
+        posix_madvise(data, _size, isSequential ? POSIX_MADV_SEQUENTIAL : POSIX_MADV_RANDOM);
+        _data = (const char*)data;
+    }
+    // The mapping keeps the file
+    ::close(file);
+#endif
+
+    _isOpen = true;
+    return true;
+}
+
+void
+OVMappedFile::close()
+{
+#ifdef _WIN32
+    if (_data)
+        UnmapViewOfFile(_data);
+    if (_mapping)
+        CloseHandle(_mapping);
+    if (_file != INVALID_HANDLE_VALUE)
+        CloseHandle(_file);
+    _file = INVALID_HANDLE_VALUE;
+    _mapping = NULL;
+#else
+    if (_data)
+        munmap((void*)_data, _size);
+#endif
+    _data = NULL;
+    _size = 0;
+    _isOpen = false;
+}
+
+} // namespace ov
@@ -0,0 +1,330 @@
+#include "OVOffscreenContext.h"
+#ifdef OV_USE_OSMESA
+#include <GL/osmesa.h>
+#endif
+#ifdef OV_USE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+namespace ov
+{
+
+namespace
+{
+
+#ifdef OV_USE_OSMESA
+void*
+GetOSMesaProcAddress(const char* name)
+{
+    return (void*)OSMesaGetProcAddress(name);
+}
+#endif
+
+#ifdef OV_USE_EGL
+void*
+GetEGLProcAddress(const char* name)
+{
+    return (void*)eglGetProcAddress(name);
+}
+#endif
+
+} // namespace
+
+OVOffscreenContext::OVOffscreenContext()
+{
+    _backend = OFFSCREEN_AUTO;
+    _isCoreProfile = false;
+    _width = 0;
+    _height = 0;
+    _osmesaContext = NULL;
+    _eglDisplay = NULL;
+    _eglContext = NULL;
+    _framebuffer = 0;
+    _colorRenderbuffer = 0;
+    _depthRenderbuffer = 0;
+}
+
+OVOffscreenContext::~OVOffscreenContext()
+{
+    destroy();
+}
+
+bool
+OVOffscreenContext::create(int backend, int width, int height, std::string& err)
+{
+    destroy();
+    _width = width;
+    _height = height;
+
+    std::string osmesaErr, eglErr;
+    if ((backend == OFFSCREEN_AUTO || backend == OFFSCREEN_EGL) && createEGL(eglErr))
+        _backend = OFFSCREEN_EGL;
+    else if ((backend == OFFSCREEN_AUTO || backend == OFFSCREEN_OSMESA) && createOSMesa(osmesaErr))
+        _backend = OFFSCREEN_OSMESA;
+    else
+    {
+        err = "Cannot create an offscreen OpenGL context.";
+        if (!eglErr.empty())
+            err += "\nEGL: " + eglErr;
+        if (!osmesaErr.empty())
+            err += "\nOSMesa: " + osmesaErr;
+        return false;
+    }
+
+    LoadGLFunctions(getProcAddressFn());
+    if (_backend == OFFSCREEN_EGL && !createFramebuffer())
+    {
+        err = "Cannot create an offscreen framebuffer object.";
+        destroy();
+        return false;
+    }
+
+    return true;
+}
+
+void
+OVOffscreenContext::destroy()
+{
+#ifdef OV_USE_EGL
+    if (_eglContext)
+    {
+        makeCurrent();
+        destroyFramebuffer();
+        eglMakeCurrent((EGLDisplay)_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext((EGLDisplay)_eglDisplay, (EGLContext)_eglContext);
+        eglTerminate((EGLDisplay)_eglDisplay);
+    }
+#endif
+#ifdef OV_USE_OSMESA
+    if (_osmesaContext)
+        OSMesaDestroyContext((OSMesaContext)_osmesaContext);
+#endif
+    _osmesaContext = NULL;
+    _osmesaBuffer.clear();
+    _eglDisplay = NULL;
+    _eglContext = NULL;
+    _backend = OFFSCREEN_AUTO;
+}
+
+bool
+OVOffscreenContext::makeCurrent()
+{
+#ifdef OV_USE_OSMESA
+    if (_backend == OFFSCREEN_OSMESA)
+        return OSMesaMakeCurrent((OSMesaContext)_osmesaContext, &_osmesaBuffer[0], GL_UNSIGNED_BYTE, _width, _height) != 0;
+#endif
+#ifdef OV_USE_EGL
+    if (_backend == OFFSCREEN_EGL)
+    {
+        if (!eglMakeCurrent((EGLDisplay)_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, (EGLContext)_eglContext))
+            return false;
+        gl::BindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+        return true;
+    }
+#endif
+    return false;
+}
+
+void
+OVOffscreenContext::swapBuffers()
+{
+    // Nothing is presented; the frame stays in the buffer for readback
+}
+
+bool
+OVOffscreenContext::resize(int width, int height)
+{
+    if (width == _width && height == _height)
+        return true;
+
+    _width = width;
+    _height = height;
+    if (_backend == OFFSCREEN_OSMESA)
+    {
+        _osmesaBuffer.assign((size_t)_width * _height * 4, 0);
+        return makeCurrent();
+    }
+    if (_backend == OFFSCREEN_EGL)
+    {
+        makeCurrent();
+        destroyFramebuffer();
+        return createFramebuffer();
+    }
+    return false;
+}
+
+GLProcAddressFn
+OVOffscreenContext::getProcAddressFn() const
+{
+#ifdef OV_USE_OSMESA
+    if (_backend == OFFSCREEN_OSMESA)
+        return GetOSMesaProcAddress;
+#endif
+#ifdef OV_USE_EGL
+    if (_backend == OFFSCREEN_EGL)
+        return GetEGLProcAddress;
+#endif
+    return GetGLProcAddress;
+}
+
+bool
+OVOffscreenContext::createOSMesa(std::string& err)
+{
+#ifdef OV_USE_OSMESA
+    OSMesaContext context = NULL;
+    if (_isCoreProfile)
+    {
+#ifdef OSMESA_CORE_PROFILE
+        const int attribs[] =
+        {
+            OSMESA_FORMAT, OSMESA_BGRA,
+            OSMESA_DEPTH_BITS, 24,
+            OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+            OSMESA_CONTEXT_MAJOR_VERSION, 3,
+            OSMESA_CONTEXT_MINOR_VERSION, 3,
+            0
+        };
+        context = OSMesaCreateContextAttribs(attribs, NULL);
+#endif
+    }
+    else
+    {
+        context = OSMesaCreateContextExt(OSMESA_BGRA, 24, 0, 0, NULL);
+    }
+    if (context == NULL)
+    {
+        err = _isCoreProfile ? "OSMesaCreateContextAttribs failed" : "OSMesaCreateContextExt failed";
+        return false;
+    }
+    _osmesaContext = context;
+    _osmesaBuffer.assign((size_t)_width * _height * 4, 0);
+    _backend = OFFSCREEN_OSMESA;
+    if (!makeCurrent())
+    {
+        err = "OSMesaMakeCurrent failed";
+        _backend = OFFSCREEN_AUTO;
+        return false;
+    }
+    return true;
+#else
+    err = "not compiled in (define OV_USE_OSMESA)";
+    return false;
+#endif
+}
+
+bool
+OVOffscreenContext::createEGL(std::string& err)
+{
+#ifdef OV_USE_EGL
+    // Prefer the surfaceless platform, which needs neither a display server nor a GPU
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    {
+        err = "eglInitialize failed";
+        return false;
+    }
+
+    const EGLint configAttribs[] =
+    {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglBindAPI(EGL_OPENGL_API)
+        || !eglChooseConfig(display, configAttribs, &config, 1, &numConfigs)
+        || numConfigs == 0)
+    {
+        err = "no EGL config supporting desktop OpenGL";
+        eglTerminate(display);
+        return false;
+    }
+
+    // The fixed-function renderer needs a compatibility profile
+    const EGLint compatibilityAttribs[] =
+    {
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+        EGL_NONE
+    };
+    const EGLint coreAttribs[] =
+    {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT,
+                                          _isCoreProfile ? coreAttribs : compatibilityAttribs);
+    if (context == EGL_NO_CONTEXT)
+    {
+        err = "eglCreateContext failed";
+        eglTerminate(display);
+        return false;
+    }
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        err = "eglMakeCurrent failed (EGL_KHR_surfaceless_context missing?)";
+        eglDestroyContext(display, context);
+        eglTerminate(display);
+        return false;
+    }
+
+    _eglDisplay = display;
+    _eglContext = context;
+    return true;
+#else
+    err = "not compiled in (define OV_USE_EGL)";
+    return false;
+#endif
+}
+
+bool
+OVOffscreenContext::createFramebuffer()
+{
+    if (gl::GenFramebuffers == NULL || gl::GenRenderbuffers == NULL)
+        return false;
+
+    gl::GenRenderbuffers(1, &_colorRenderbuffer);
+    gl::BindRenderbuffer(GL_RENDERBUFFER, _colorRenderbuffer);
+    gl::RenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, _width, _height);
+    gl::GenRenderbuffers(1, &_depthRenderbuffer);
+    gl::BindRenderbuffer(GL_RENDERBUFFER, _depthRenderbuffer);
+    gl::RenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, _width, _height);
+
+    gl::GenFramebuffers(1, &_framebuffer);
+    gl::BindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    gl::FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _colorRenderbuffer);
+    gl::FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depthRenderbuffer);
+
+    return gl::CheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+void
+OVOffscreenContext::destroyFramebuffer()
+{
+    if (_framebuffer)
+        gl::DeleteFramebuffers(1, &_framebuffer);
+    if (_colorRenderbuffer)
+        gl::DeleteRenderbuffers(1, &_colorRenderbuffer);
+    if (_depthRenderbuffer)
+        gl::DeleteRenderbuffers(1, &_depthRenderbuffer);
+    _framebuffer = 0;
+    _colorRenderbuffer = 0;
+    _depthRenderbuffer = 0;
+}
+
+} // namespace ov
@@ -0,0 +1,550 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include "OVPoseGenerator.h"
+
+namespace ov
+{
+
+namespace
+{
+
+const double Pi = 3.14159265358979323846;
+const double GoldenAngle = Pi * (3 - std::sqrt(5.0));
+
+// The key=value pairs after "<kind>:"
+struct Description
+{
+    std::string                        kind;
+    std::map<std::string, std::string> values;
+    std::string                        text;
+};
+
+bool
+ParseDescription(const std::string& text, Description& description)
+{
+    size_t colon = text.find(':');
+    if (colon == std::string::npos)
+        return false;
+    description.kind = text.substr(0, colon);
+    description.text = text;
+    description.values.clear();
+    std::stringstream stream(text.substr(colon + 1));
+    std::string pair;
+    while (std::getline(stream, pair, ','))
+    {
+        size_t separator = pair.find('=');
+        if (separator == std::string::npos || separator == 0)
+            return false;
+        description.values[pair.substr(0, separator)] = pair.substr(separator + 1);
+    }
+    return true;
+}
+
+bool
+HasOnlyKeys(const Description& description, const char* const* keys, int numKeys, std::string& err)
+{
+    for (auto it = description.values.begin(); it != description.values.end(); ++it)
+    {
+        if (std::find(keys, keys + numKeys, it->first) == keys + numKeys)
+        {
+            err = "Unknown key \"" + it->first + "\" in \"" + description.text + "\"";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Numbers separated by '/'; numbers keeps its contents when the key is absent
+bool
+ReadNumbers(const Description& description, const std::string& key, std::vector<double>& numbers, std::string& err)
+{
+    auto it = description.values.find(key);
+    if (it == description.values.end())
+        return true;
+
+    numbers.clear();
+    std::stringstream stream(it->second);
+    std::string item;
+    while (std::getline(stream, item, '/'))
+    {
+        char* end;
+        double number = strtod(item.c_str(), &end);
+        if (item.empty() || *end != '\0' || !std::isfinite(number))
+        {
+            err = "Invalid value of \"" + key + "\" in \"" + description.text + "\"";
+            return false;
+        }
+        numbers.push_back(number);
+    }
+    return true;
+}
+
+bool
+ReadNumber(const Description& description, const std::string& key, double& number, std::string& err)
+{
+    std::vector<double> numbers(1, number);
+    if (!ReadNumbers(description, key, numbers, err))
+        return false;
+    if (numbers.size() != 1)
+    {
+        err = "\"" + key + "\" takes one value in \"" + description.text + "\"";
+        return false;
+    }
+    number = numbers[0];
+    return true;
+}
+
+bool
+ReadVector(const Description& description, const std::string& key, Vec3& vector, std::string& err)
+{
+    std::vector<double> numbers(vector.data(), vector.data() + 3);
+    if (!ReadNumbers(description, key, numbers, err))
+        return false;
+    if (numbers.size() != 3)
+    {
+        err = "\"" + key + "\" takes x/y/z in \"" + description.text + "\"";
+        return false;
+    }
+    vector = Vec3(numbers[0], numbers[1], numbers[2]);
+    return true;
+}
+
+bool
+ReadCount(const Description& description, const std::string& key, double maxCount, long long& count,
+          std::string& err)
+{
+    double number = 0;
+    if (!ReadNumber(description, key, number, err))
+        return false;
+    if (number < 1 || number > maxCount || number != std::floor(number))
+    {
+        err = "\"" + key + "\" needs a whole number from 1 to " + std::to_string((long long)maxCount) +
+              " in \"" + description.text + "\"";
+        return false;
+    }
+    count = (long long)number;
+    return true;
+}
+
+bool
+ReadRadii(const Description& description, int maxRadii, std::vector<double>& radii, std::string& err)
+{
+    if (!ReadNumbers(description, "radius", radii, err))
+        return false;
+    bool isValid = !radii.empty() && radii.size() <= maxRadii;
+    for (int i = 0; i < radii.size() && isValid; ++i)
+        isValid = radii[i] > 0;
+    if (!isValid)
+    {
+        err = "\"radius\" needs " + std::string(maxRadii == 2 ? "one or two" : "one or more") +
+              " positive values in \"" + description.text + "\"";
+        return false;
+    }
+    return true;
+}
+
+// A camera at center looking at target, with up pointing up in the image
+void
+LookAt(const Vec3& center, const Vec3& target, const Vec3& up, Pose& pose)
+{
+    Vec3 z = (target - center).normalized();
+    Vec3 x = z.cross(up);
+    if (x.squaredNorm() < 1e-12)
+        x = z.cross(std::abs(z.z()) < 0.9 ? Vec3::UnitZ() : Vec3::UnitX());
+    x.normalize();
+    Vec3 y = z.cross(x);
+    pose.R.row(0) = x.transpose();
+    pose.R.row(1) = y.transpose();
+    pose.R.row(2) = z.transpose();
+    pose.t = -pose.R * center;
+}
+
+// Looks at a target from directions on spheres of given radii
+class OVViewGenerator : public OVPoseGenerator
+{
+protected:
+    bool readView(const Description& description, std::string& err)
+    {
+        _target = Vec3::Zero();
+        _up = Vec3::UnitY();
+        if (!ReadVector(description, "target", _target, err) || !ReadVector(description, "up", _up, err))
+            return false;
+        if (_up.squaredNorm() == 0)
+        {
+            err = "\"up\" cannot be 0/0/0 in \"" + description.text + "\"";
+            return false;
+        }
+        return true;
+    }
+
+    void view(const Vec3& direction, double radius, Pose& pose) const
+    {
+        LookAt(_target + radius * direction, _target, _up, pose);
+    }
+
+    Vec3 _target;
+    Vec3 _up;
+};
+
+class OVFibonacciGenerator : public OVViewGenerator
+{
+public:
+    bool create(const Description& description, std::string& err)
+    {
+        static const char* const Keys[] = { "count", "radius", "target", "up" };
+        if (!HasOnlyKeys(description, Keys, 4, err) || !ReadCount(description, "count", 1e9, _numViews, err) ||
+            !ReadRadii(description, 1000, _radii, err) || !readView(description, err))
+            return false;
+        _count = _numViews * (long long)_radii.size();
+        return true;
+    }
+
+protected:
+    void generate(long long index, Pose& pose) const
+    {
+        long long i = index % _numViews;
+        double y = 1 - (2 * i + 1) / (double)_numViews;
+        double ring = std::sqrt(std::max(1 - y * y, 0.0));
+        double angle = GoldenAngle * (double)i;
+        view(Vec3(ring * std::cos(angle), y, ring * std::sin(angle)), _radii[index / _numViews], pose);
+    }
+
+private:
+    long long           _numViews;
+    std::vector<double> _radii;
+};
+
+// Vertices are numbered corners first, then the inner points of every edge,
+// then the inner points of every face, so vertex i is found without
+// building the mesh
+class OVIcosphereGenerator : public OVViewGenerator
+{
+public:
+    bool create(const Description& description, std::string& err)
+    {
+        static const char* const Keys[] = { "subdivisions", "radius", "target", "up" };
+        double subdivisions = 0;
+        if (!HasOnlyKeys(description, Keys, 4, err) || !ReadNumber(description, "subdivisions", subdivisions, err) ||
+            !ReadRadii(description, 1000, _radii, err) || !readView(description, err))
+            return false;
+        if (subdivisions < 0 || subdivisions > 10 || subdivisions != std::floor(subdivisions))
+        {
+            err = "\"subdivisions\" needs a whole number from 0 to 10 in \"" + description.text + "\"";
+            return false;
+        }
+
+        const double Phi = (1 + std::sqrt(5.0)) / 2;
+        const double Corners[12][3] =
+        {
+            { -1,  Phi, 0 }, { 1,  Phi, 0 }, { -1, -Phi, 0 }, { 1, -Phi, 0 },
+            { 0, -1,  Phi }, { 0, 1,  Phi }, { 0, -1, -Phi }, { 0, 1, -Phi },
+            {  Phi, 0, -1 }, {  Phi, 0, 1 }, { -Phi, 0, -1 }, { -Phi, 0, 1 },
+        };
+        const int Faces[20][3] =
+        {
+            { 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+            { 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+            { 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+            { 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 },
+        };
+        for (int i = 0; i < 12; ++i)
+            _corners[i] = Vec3(Corners[i][0], Corners[i][1], Corners[i][2]).normalized();
+        _edges.clear();
+        for (int f = 0; f < 20; ++f)
+        {
+            _faces[f] = Eigen::Vector3i(Faces[f][0], Faces[f][1], Faces[f][2]);
+            for (int k = 0; k < 3; ++k)
+            {
+                Eigen::Vector2i edge(std::min(Faces[f][k], Faces[f][(k + 1) % 3]),
+                                     std::max(Faces[f][k], Faces[f][(k + 1) % 3]));
+                if (std::find(_edges.begin(), _edges.end(), edge) == _edges.end())
+                    _edges.push_back(edge);
+            }
+        }
+
+        _numSegments = 1 << (int)subdivisions;
+        _numViews = 10LL * _numSegments * _numSegments + 2;
+        _count = _numViews * (long long)_radii.size();
+        return true;
+    }
+
+protected:
+    void generate(long long index, Pose& pose) const
+    {
+        long long i = index % _numViews;
+        int n = _numSegments;
+        Vec3 direction;
+        if (i < 12)
+            direction = _corners[i];
+        else if ((i -= 12) < 30LL * (n - 1))
+        {
+            const Eigen::Vector2i& edge = _edges[i / (n - 1)];
+            double s = (i % (n - 1) + 1) / (double)n;
+            direction = (1 - s) * _corners[edge[0]] + s * _corners[edge[1]];
+        }
+        else
+        {
+            // Inner points (a, b) of a face, a and b >= 1 and a + b <= n - 1, row by row
+            i -= 30LL * (n - 1);
+            long long numInner = (long long)(n - 1) * (n - 2) / 2;
+            const Eigen::Vector3i& face = _faces[i / numInner];
+            long long j = i % numInner;
+            int a = 1;
+            for (; j >= n - 1 - a; ++a)
+                j -= n - 1 - a;
+            int b = (int)j + 1;
+            direction = ((n - a - b) * _corners[face[0]] + a * _corners[face[1]] + b * _corners[face[2]]) / n;
+        }
+        view(direction.normalized(), _radii[index / _numViews], pose);
+    }
+
+private:
+    Vec3                         _corners[12];
+    Eigen::Vector3i              _faces[20];
+    std::vector<Eigen::Vector2i> _edges;
+    int                          _numSegments;
+    long long                    _numViews;
+    std::vector<double>          _radii;
+};
+
+class OVRandomGenerator : public OVViewGenerator
+{
+public:
+    bool create(const Description& description, std::string& err)
+    {
+        static const char* const Keys[] = { "count", "radius", "seed", "jitter", "roll", "target", "up" };
+        double seed = 0;
+        _jitter = 0;
+        _roll = 0;
+        if (!HasOnlyKeys(description, Keys, 7, err) || !ReadCount(description, "count", 1e12, _count, err) ||
+            !ReadRadii(description, 2, _radii, err) || !ReadNumber(description, "seed", seed, err) ||
+            !ReadNumber(description, "jitter", _jitter, err) || !ReadNumber(description, "roll", _roll, err) ||
+            !readView(description, err))
+            return false;
+        if (_radii.size() == 1)
+            _radii.push_back(_radii[0]);
+        _seed = MixBits((uint64_t)seed);
+        _jitter = std::min(std::abs(_jitter), 180.0) * Pi / 180;
+        _roll = std::min(std::abs(_roll), 180.0) * Pi / 180;
+        return true;
+    }
+
+protected:
+    void generate(long long index, Pose& pose) const
+    {
+        // Six draws per pose from the counter-based generator
+        double u[6];
+        for (int k = 0; k < 6; ++k)
+            u[k] = (MixBits(_seed + (uint64_t)(index * 6 + k + 1) * GoldenGamma) >> 11) * (1.0 / 9007199254740992.0);
+
+        // Uniform over the shell's volume
+        double z = 2 * u[0] - 1;
+        double ring = std::sqrt(std::max(1 - z * z, 0.0));
+        double angle = 2 * Pi * u[1];
+        Vec3 direction(ring * std::cos(angle), ring * std::sin(angle), z);
+        double r0 = _radii[0] * _radii[0] * _radii[0];
+        double r1 = _radii[1] * _radii[1] * _radii[1];
+        Vec3 center = _target + std::cbrt(r0 + u[2] * (r1 - r0)) * direction;
+        LookAt(center, _target, _up, pose);
+
+        // Uniform over the cap of directions within the jitter of the target
+        if (_jitter > 0)
+        {
+            double cosTilt = 1 - u[3] * (1 - std::cos(_jitter));
+            double sinTilt = std::sqrt(std::max(1 - cosTilt * cosTilt, 0.0));
+            double heading = 2 * Pi * u[4];
+            Vec3 forward = pose.R.transpose() * Vec3(sinTilt * std::cos(heading), sinTilt * std::sin(heading), cosTilt);
+            LookAt(center, center + forward, _up, pose);
+        }
+        if (_roll > 0)
+        {
+            pose.R = Eigen::AngleAxisd((2 * u[5] - 1) * _roll, Vec3::UnitZ()).toRotationMatrix() * pose.R;
+            pose.t = -pose.R * center;
+        }
+    }
+
+private:
+    std::vector<double> _radii;
+    uint64_t            _seed;
+    double              _jitter;    // Radians
+    double              _roll;
+};
+
+Vec3
+QuaternionLog(const Eigen::Quaterniond& q)
+{
+    double s = q.vec().norm();
+    return (s < 1e-12) ? Vec3::Zero() : Vec3(q.vec() / s * std::atan2(s, q.w()));
+}
+
+Eigen::Quaterniond
+QuaternionExp(const Vec3& v)
+{
+    double angle = v.norm();
+    if (angle < 1e-12)
+        return Eigen::Quaterniond::Identity();
+    Vec3 axis = v / angle * std::sin(angle);
+    return Eigen::Quaterniond(std::cos(angle), axis.x(), axis.y(), axis.z());
+}
+
+class OVKeyframeGenerator : public OVPoseGenerator
+{
+public:
+    bool create(const Description& description, std::string& err)
+    {
+        static const char* const Keys[] = { "file", "count", "interpolation" };
+        if (!HasOnlyKeys(description, Keys, 3, err) || !ReadCount(description, "count", 1e12, _count, err))
+            return false;
+        auto interpolation = description.values.find("interpolation");
+        _isSpline = (interpolation != description.values.end() && interpolation->second == "spline");
+        if (interpolation != description.values.end() && !_isSpline && interpolation->second != "slerp")
+        {
+            err = "Unknown interpolation \"" + interpolation->second + "\" in \"" + description.text + "\"";
+            return false;
+        }
+        auto file = description.values.find("file");
+        if (file == description.values.end())
+        {
+            err = "No keyframe file in \"" + description.text + "\"";
+            return false;
+        }
+
+        std::unique_ptr<OVPoseSource> keyframes(OVPoseSource::Open(file->second, err));
+        if (!keyframes)
+            return false;
+        Pose pose;
+        while (keyframes->next(pose))
+        {
+            // Rotations on one hemisphere, so neighbours interpolate the short way
+            Eigen::Quaterniond rotation(pose.R);
+            rotation.normalize();
+            if (!_rotations.empty() && _rotations.back().dot(rotation) < 0)
+                rotation.coeffs() = -rotation.coeffs();
+            _rotations.push_back(rotation);
+            _centers.push_back(-pose.R.transpose() * pose.t);
+        }
+        if (!keyframes->getError().empty() || _rotations.empty())
+        {
+            err = keyframes->getError().empty() ? "No keyframes in \"" + file->second + "\"" : keyframes->getError();
+            return false;
+        }
+
+        // Squad's inner control rotations
+        int numKeys = (int)_rotations.size();
+        for (int k = 0; k < numKeys; ++k)
+        {
+            const Eigen::Quaterniond& q = _rotations[k];
+            Eigen::Quaterniond inverse = q.conjugate();
+            Vec3 toNext = QuaternionLog(inverse * _rotations[std::min(k + 1, numKeys - 1)]);
+            Vec3 toPrevious = QuaternionLog(inverse * _rotations[std::max(k - 1, 0)]);
+            _innerRotations.push_back(q * QuaternionExp(-(toNext + toPrevious) / 4));
+        }
+        return true;
+    }
+
+protected:
+    void generate(long long index, Pose& pose) const
+    {
+        int numKeys = (int)_rotations.size();
+        double s = (_count > 1) ? (double)index * (numKeys - 1) / (double)(_count - 1) : 0;
+        int k = std::max(std::min((int)s, numKeys - 2), 0);
+        double u = (numKeys > 1) ? s - k : 0;
+        int next = std::min(k + 1, numKeys - 1);
+
+        Eigen::Quaterniond rotation;
+        Vec3 center;
+        if (_isSpline)
+        {
+            // Catmull-Rom through the centres, squad through the rotations
+            const Vec3& p0 = _centers[std::max(k - 1, 0)];
+            const Vec3& p1 = _centers[k];
+            const Vec3& p2 = _centers[next];
+            const Vec3& p3 = _centers[std::min(k + 2, numKeys - 1)];
+            center = 0.5 * (2 * p1 + (p2 - p0) * u + (2 * p0 - 5 * p1 + 4 * p2 - p3) * u * u +
+                            (3 * p1 - p0 - 3 * p2 + p3) * u * u * u);
+            rotation = _rotations[k].slerp(u, _rotations[next])
+                           .slerp(2 * u * (1 - u), _innerRotations[k].slerp(u, _innerRotations[next]));
+        }
+        else
+        {
+            center = (1 - u) * _centers[k] + u * _centers[next];
+            rotation = _rotations[k].slerp(u, _rotations[next]);
+        }
+        pose.R = rotation.toRotationMatrix();
+        pose.t = -pose.R * center;
+    }
+
+private:
+    bool                            _isSpline;
+    std::vector<Eigen::Quaterniond> _rotations;
+    std::vector<Eigen::Quaterniond> _innerRotations;
+    std::vector<Vec3>               _centers;
+};
+
+template<typename Generator>
+OVPoseGenerator*
+CreateGenerator(const Description& description, std::string& err)
+{
+    Generator* generator = new Generator();
+    if (generator->create(description, err))
+        return generator;
+    delete generator;
+    return NULL;
+}
+
+} // namespace
+
+bool
+OVPoseGenerator::IsDescription(const std::string& text)
+{
+    size_t colon = text.find(':');
+    if (colon == std::string::npos)
+        return false;
+    std::string kind = text.substr(0, colon);
+    return kind == "fibonacci" || kind == "icosphere" || kind == "random" || kind == "keyframes";
+}
+
+OVPoseGenerator*
+OVPoseGenerator::Create(const std::string& text, std::string& err)
+{
+    Description description;
+    if (!ParseDescription(text, description))
+    {
+        err = "Expected <kind>:<key>=<value>,... in \"" + text + "\"";
+        return NULL;
+    }
+    if (description.kind == "fibonacci")
+        return CreateGenerator<OVFibonacciGenerator>(description, err);
+    if (description.kind == "icosphere")
+        return CreateGenerator<OVIcosphereGenerator>(description, err);
+    if (description.kind == "random")
+        return CreateGenerator<OVRandomGenerator>(description, err);
+    if (description.kind == "keyframes")
+        return CreateGenerator<OVKeyframeGenerator>(description, err);
+    err = "Unknown pose generator \"" + description.kind + "\"";
+    return NULL;
+}
+
+bool
+OVPoseGenerator::seek(long long index)
+{
+    if (index < 0 || index > _count)
+        return false;
+    _position = index;
+    return true;
+}
+
+bool
+OVPoseGenerator::next(Pose& pose)
+{
+    if (_position >= _count)
+        return false;
+    generate(_position++, pose);
+    return true;
+}
+
+} // namespace ov
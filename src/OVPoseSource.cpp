@@ -0,0 +1,406 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "OVMappedFile.h"
+#include "OVPoseGenerator.h"
+#include "OVPoseSource.h"
+
+namespace ov
+{
+
+namespace
+{
+
+const char PoseFileMagic[8] = { 'O', 'V', 'P', 'O', 'S', 'E', 'S', '1' };
+
+// Powers of ten that a double holds exactly
+const double ExactPowersOf10[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// R in column-major order, then t
+void
+PoseFromValues(const double* values, Pose& pose)
+{
+    pose.R << values[0], values[3], values[6],
+              values[1], values[4], values[7],
+              values[2], values[5], values[8];
+    pose.t << values[9], values[10], values[11];
+}
+
+void
+ValuesFromPose(const Pose& pose, double* values)
+{
+    for (int j = 0; j < 3; ++j)
+    {
+        for (int i = 0; i < 3; ++i)
+            values[j * 3 + i] = pose.R(i, j);
+        values[9 + j] = pose.t(j);
+    }
+}
+
+bool
+IsBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool
+IsDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Parse the number at p, not reading past end, and move p after it. Numbers
+// of up to 15 significant digits and powers of ten up to 22 are converted
+// with one exact multiplication or division, which rounds correctly
+// (Clinger's fast path); the rare others go through strtod.
+bool
+ParseNumber(const char*& p, const char* end, double& value)
+{
+    const char* start = p;
+    bool isNegative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        isNegative = (*p++ == '-');
+
+    unsigned long long mantissa = 0;
+    int numDigits = 0;      // Significant digits in mantissa
+    int exponent = 0;
+    bool hasDigits = false;
+    bool isExact = true;    // No nonzero digit dropped
+    for (; p < end && IsDigit(*p); ++p)
+    {
+        hasDigits = true;
+        if (numDigits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            numDigits += (mantissa != 0);
+        }
+        else
+        {
+            ++exponent;
+            isExact = isExact && *p == '0';
+        }
+    }
+    if (p < end && *p == '.')
+    {
+        for (++p; p < end && IsDigit(*p); ++p)
+        {
+            hasDigits = true;
+            if (numDigits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                numDigits += (mantissa != 0);
+                --exponent;
+            }
+            else
+                isExact = isExact && *p == '0';
+        }
+    }
+    if (!hasDigits)
+    {
+        p = start;
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char* q = p + 1;
+        bool isNegativeExponent = false;
+        if (q < end && (*q == '-' || *q == '+'))
+            isNegativeExponent = (*q++ == '-');
+        if (q < end && IsDigit(*q))
+        {
+            int power = 0;
+            for (; q < end && IsDigit(*q); ++q)
+                power = std::min(power * 10 + (*q - '0'), 100000);
+            exponent += isNegativeExponent ? -power : power;
+            p = q;
+        }
+    }
+
+    bool isSeparated = (p == end || IsBlank(*p) || *p == '\n');
+    if (isSeparated && isExact && numDigits <= 15 && exponent >= -22 && exponent <= 22)
+    {
+        value = (double)mantissa;
+        value = (exponent < 0) ? value / ExactPowersOf10[-exponent] : value * ExactPowersOf10[exponent];
+        if (isNegative)
+            value = -value;
+        return true;
+    }
+
+    // strtod needs a terminated copy, as the mapping may end right after the number
+    const char* tokenEnd = start;
+    while (tokenEnd < end && !IsBlank(*tokenEnd) && *tokenEnd != '\n')
+        ++tokenEnd;
+    char token[128];
+    size_t length = tokenEnd - start;
+    if (length >= sizeof(token))
+        return false;
+    memcpy(token, start, length);
+    token[length] = '\0';
+    char* parsedEnd;
+    value = strtod(token, &parsedEnd);
+    if (parsedEnd != token + length)
+    {
+        p = start;
+        return false;
+    }
+    p = tokenEnd;
+    return true;
+}
+
+class OVTextPoseSource : public OVPoseSource
+{
+public:
+    bool open(const std::string& fileName, std::string& err)
+    {
+        if (!_file.open(fileName, true))
+        {
+            err = "Cannot open \"" + fileName + "\"";
+            return false;
+        }
+        _fileName = fileName;
+        _begin = _file.getData();
+        _end = _begin + _file.getSize();
+        _cursor = _begin;
+
+        // Lines with anything but blanks, including a last line with no newline
+        for (const char* p = _begin; p < _end; p = getNextLine(p))
+        {
+            const char* q = p;
+            const char* lineEnd = getLineEnd(p);
+            while (q < lineEnd && IsBlank(*q))
+                ++q;
+            _count += (q < lineEnd);
+        }
+        return true;
+    }
+
+    bool seek(long long index)
+    {
+        if (index < 0 || index > _count)
+            return false;
+        if (index < _position)
+        {
+            _cursor = _begin;
+            _position = 0;
+        }
+        for (; _position < index; ++_position)
+            _cursor = getNextLine(skipBlankLines(_cursor));
+        return true;
+    }
+
+    bool next(Pose& pose)
+    {
+        if (_position >= _count)
+            return false;
+
+        const char* p = skipBlankLines(_cursor);
+        const char* lineEnd = getLineEnd(p);
+        double values[ValuesPerPose];
+        for (int i = 0; i < ValuesPerPose; ++i)
+        {
+            while (p < lineEnd && IsBlank(*p))
+                ++p;
+            if (!ParseNumber(p, lineEnd, values[i]))
+            {
+                _err = "Pose " + std::to_string(_position + 1) + " of \"" + _fileName + "\" needs " +
+                       std::to_string(ValuesPerPose) + " numbers";
+                return false;
+            }
+        }
+        PoseFromValues(values, pose);
+        _cursor = getNextLine(lineEnd);
+        ++_position;
+        return true;
+    }
+
+private:
+    // The newline ending the line at p, or the end of the file
+    const char* getLineEnd(const char* p) const
+    {
+        const char* newline = (const char*)memchr(p, '\n', _end - p);
+        return newline ? newline : _end;
+    }
+
+    const char* getNextLine(const char* p) const
+    {
+        const char* lineEnd = getLineEnd(p);
+        return (lineEnd < _end) ? lineEnd + 1 : _end;
+    }
+
+    const char* skipBlankLines(const char* p) const
+    {
+        while (p < _end)
+        {
+            const char* lineEnd = getLineEnd(p);
+            const char* q = p;
+            while (q < lineEnd && IsBlank(*q))
+                ++q;
+            if (q < lineEnd)
+                return p;
+            p = getNextLine(p);
+        }
+        return _end;
+    }
+
+    OVMappedFile _file;
+    std::string  _fileName;
+    const char*  _begin;
+    const char*  _end;
+    const char*  _cursor;       // Start of the line after the last pose read
+};
+
+class OVBinaryPoseSource : public OVPoseSource
+{
+public:
+    bool open(const std::string& fileName, std::string& err)
+    {
+        if (!_file.open(fileName, false))
+        {
+            err = "Cannot open \"" + fileName + "\"";
+            return false;
+        }
+
+        PoseFileHeader header;
+        bool isValid = _file.getSize() >= sizeof(header);
+        if (isValid)
+        {
+            memcpy(&header, _file.getData(), sizeof(header));
+            isValid = (header.valueSize == 4 || header.valueSize == 8) && header.valuesPerPose == ValuesPerPose &&
+                      header.count <= (_file.getSize() - sizeof(header)) / (header.valueSize * ValuesPerPose);
+        }
+        if (!isValid)
+        {
+            err = "\"" + fileName + "\" is not a valid binary poses file";
+            return false;
+        }
+        _values = _file.getData() + sizeof(header);
+        _valueSize = header.valueSize;
+        _count = (long long)header.count;
+        return true;
+    }
+
+    bool seek(long long index)
+    {
+        if (index < 0 || index > _count)
+            return false;
+        _position = index;
+        return true;
+    }
+
+    bool next(Pose& pose)
+    {
+        if (_position >= _count)
+            return false;
+
+        // memcpy, as the values of float32 files are only 4-byte aligned
+        const char* data = _values + _position * _valueSize * ValuesPerPose;
+        double values[ValuesPerPose];
+        if (_valueSize == sizeof(double))
+            memcpy(values, data, sizeof(values));
+        else
+        {
+            float singles[ValuesPerPose];
+            memcpy(singles, data, sizeof(singles));
+            for (int i = 0; i < ValuesPerPose; ++i)
+                values[i] = singles[i];
+        }
+        PoseFromValues(values, pose);
+        ++_position;
+        return true;
+    }
+
+private:
+    OVMappedFile _file;
+    const char*  _values;
+    int          _valueSize;
+};
+
+} // namespace
+
+OVPoseSource*
+OVPoseSource::Open(const std::string& fileName, std::string& err)
+{
+    if (OVPoseGenerator::IsDescription(fileName))
+        return OVPoseGenerator::Create(fileName, err);
+
+    char magic[sizeof(PoseFileMagic)] = {};
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (!file)
+    {
+        err = "Cannot open \"" + fileName + "\"";
+        return NULL;
+    }
+    size_t numRead = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+
+    if (numRead == sizeof(magic) && memcmp(magic, PoseFileMagic, sizeof(magic)) == 0)
+    {
+        OVBinaryPoseSource* source = new OVBinaryPoseSource();
+        if (source->open(fileName, err))
+            return source;
+        delete source;
+    }
+    else
+    {
+        OVTextPoseSource* source = new OVTextPoseSource();
+        if (source->open(fileName, err))
+            return source;
+        delete source;
+    }
+    return NULL;
+}
+
+bool
+OVPoseSource::WriteBinary(const std::string& fileName, OVPoseSource& source, bool isSinglePrecision,
+                          std::string& err)
+{
+    FILE* file = fopen(fileName.c_str(), "wb");
+    if (!file)
+    {
+        err = "Cannot create \"" + fileName + "\"";
+        return false;
+    }
+
+    PoseFileHeader header = {};
+    memcpy(header.magic, PoseFileMagic, sizeof(header.magic));
+    header.valueSize = isSinglePrecision ? sizeof(float) : sizeof(double);
+    header.valuesPerPose = ValuesPerPose;
+    header.count = source.getCount() - source.getPosition();
+    bool isOk = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    Pose pose;
+    double values[ValuesPerPose];
+    float singles[ValuesPerPose];
+    while (isOk && source.next(pose))
+    {
+        ValuesFromPose(pose, values);
+        if (isSinglePrecision)
+        {
+            for (int i = 0; i < ValuesPerPose; ++i)
+                singles[i] = (float)values[i];
+            isOk = fwrite(singles, sizeof(singles), 1, file) == 1;
+        }
+        else
+            isOk = fwrite(values, sizeof(values), 1, file) == 1;
+    }
+    isOk = (fclose(file) == 0) && isOk;
+
+    if (!source.getError().empty())
+    {
+        err = source.getError();
+        return false;
+    }
+    if (!isOk)
+    {
+        err = "Cannot write \"" + fileName + "\"";
+        return false;
+    }
+    return true;
+}
+
+} // namespace ov
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "OVCommon.h"
+#include "OVPostProcessor.h"
+#include "OVThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OV_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace ov
+{
+
+namespace
+{
+
+// Rows per parallel work item; every band also blurs 2 * radius rows of its neighbours
+const int BandRows = 64;
+
+// Per-thread rows, kept between frames
+struct Scratch
+{
+    std::vector<float> padded;  // A source row with reflected borders
+    std::vector<float> ring;    // Horizontally blurred rows
+    std::vector<float> row;     // Blurred output row
+    std::vector<float> noise;
+};
+
+// The border mode of cv::GaussianBlur: dcb|abcd|cba
+int
+Reflect101(int i, int n)
+{
+    if (n == 1)
+        return 0;
+    while (i < 0 || i >= n)
+        i = (i < 0) ? -i : 2 * n - 2 - i;
+    return i;
+}
+
+// Uniform in (0, 1), never 0, so its logarithm is finite
+float
+ToUniform(unsigned int x)
+{
+    return ((x >> 8) + 0.5f) * (1.0f / 16777216.0f);
+}
+
+} // namespace
+
+OVPostProcessor::OVPostProcessor()
+{
+    _kernel.assign(1, 1.0f);
+    _radius = 0;
+    _noiseSigma = 0;
+    _key[0] = 0;
+    _key[1] = 0;
+}
+
+void
+OVPostProcessor::setBlur(double sigma)
+{
+    _kernel.assign(1, 1.0f);
+    _radius = 0;
+    if (sigma <= 0)
+        return;
+
+    // The kernel size cv::GaussianBlur picks for 8-bit images
+    int size = (int)std::lround(sigma * 3 * 2 + 1) | 1;
+    _radius = size / 2;
+    std::vector<double> weights(size);
+    double sum = 0;
+    for (int i = 0; i < size; ++i)
+    {
+        double x = i - _radius;
+        weights[i] = std::exp(-x * x / (2 * sigma * sigma));
+        sum += weights[i];
+    }
+    _kernel.resize(size);
+    for (int i = 0; i < size; ++i)
+        _kernel[i] = (float)(weights[i] / sum);
+}
+
+void
+OVPostProcessor::setNoise(double sigma, unsigned int seed, unsigned int stream)
+{
+    _noiseSigma = (float)std::max(sigma, 0.0);
+    _key[0] = seed;
+    _key[1] = stream;
+}
+
+void
+OVPostProcessor::apply(const cv::Mat& src, cv::Mat& dst, unsigned int frameIndex, OVThreadPool& pool) const
+{
+    dst.create(src.size(), CV_8UC3);
+    int numBands = (src.rows + BandRows - 1) / BandRows;
+    pool.parallelFor(numBands, [&](int band)
+    {
+        applyBand(src, dst, frameIndex, band * BandRows, std::min(src.rows, (band + 1) * BandRows));
+    });
+}
+
+void
+OVPostProcessor::applyBand(const cv::Mat& src, cv::Mat& dst, unsigned int frameIndex, int firstRow, int lastRow) const
+{
+    thread_local Scratch scratch;
+    int width = src.cols;
+    int rowSize = width * 3;
+    int ringSize = 2 * _radius + 1;
+    scratch.padded.resize((width + 2 * _radius) * 3);
+    scratch.ring.resize(ringSize * rowSize);
+    scratch.row.resize(rowSize);
+    scratch.noise.assign(rowSize, 0.0f);
+    const float* kernel = _kernel.data();
+    float* row = scratch.row.data();
+    float* noise = scratch.noise.data();
+
+    // Row y of the image goes to slot (y - ringFirst) % ringSize
+    int ringFirst = firstRow - _radius;
+    int nextRow = ringFirst;
+    std::vector<const float*> taps(ringSize);
+    for (int y = firstRow; y < lastRow; ++y)
+    {
+        for (; nextRow <= y + _radius; ++nextRow)
+        {
+            float* slot = &scratch.ring[((nextRow - ringFirst) % ringSize) * rowSize];
+            blurRow(src.ptr<unsigned char>(Reflect101(nextRow, src.rows)), width, scratch.padded.data(), slot);
+        }
+        for (int k = 0; k < ringSize; ++k)
+            taps[k] = &scratch.ring[((y - _radius + k - ringFirst) % ringSize) * rowSize];
+
+        // Vertical pass; the scalar loop keeps the vector loop's order of operations
+        int i = 0;
+#ifdef OV_USE_SSE2
+        for (; i + 4 <= rowSize; i += 4)
+        {
+            __m128 sum = _mm_mul_ps(_mm_set1_ps(kernel[0]), _mm_loadu_ps(taps[0] + i));
+            for (int k = 1; k < ringSize; ++k)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(kernel[k]), _mm_loadu_ps(taps[k] + i)));
+            _mm_storeu_ps(row + i, sum);
+        }
+#endif
+        for (; i < rowSize; ++i)
+        {
+            float sum = kernel[0] * taps[0][i];
+            for (int k = 1; k < ringSize; ++k)
+                sum += kernel[k] * taps[k][i];
+            row[i] = sum;
+        }
+
+        // Noise of sample i of row y is number y * rowSize + i of the frame
+        if (_noiseSigma > 0)
+            generateNoise(frameIndex, (unsigned long long)y * rowSize, rowSize, noise);
+
+        // Round to nearest even, as cvRound does, and saturate
+        unsigned char* out = dst.ptr<unsigned char>(y);
+        i = 0;
+#ifdef OV_USE_SSE2
+        for (; i + 4 <= rowSize; i += 4)
+        {
+            __m128i value = _mm_cvtps_epi32(_mm_add_ps(_mm_loadu_ps(row + i), _mm_loadu_ps(noise + i)));
+            value = _mm_packs_epi32(value, value);
+            value = _mm_packus_epi16(value, value);
+            int packed = _mm_cvtsi128_si32(value);
+            memcpy(out + i, &packed, 4);
+        }
+#endif
+        for (; i < rowSize; ++i)
+        {
+            int value = (int)std::nearbyint(row[i] + noise[i]);
+            out[i] = (unsigned char)std::min(std::max(value, 0), 255);
+        }
+    }
+}
+
+void
+OVPostProcessor::blurRow(const unsigned char* src, int width, float* padded, float* out) const
+{
+    int rowSize = width * 3;
+    for (int i = 0; i < rowSize; ++i)
+        padded[_radius * 3 + i] = src[i];
+    for (int x = 1; x <= _radius; ++x)
+    {
+        const unsigned char* left = src + Reflect101(-x, width) * 3;
+        const unsigned char* right = src + Reflect101(width - 1 + x, width) * 3;
+        for (int c = 0; c < 3; ++c)
+        {
+            padded[(_radius - x) * 3 + c] = left[c];
+            padded[(_radius + width - 1 + x) * 3 + c] = right[c];
+        }
+    }
+
+    // Sample i of the output reads the padded samples i, i + 3, ..., i + 6 * radius
+    int numTaps = 2 * _radius + 1;
+    const float* kernel = _kernel.data();
+    int i = 0;
+#ifdef OV_USE_SSE2
+    for (; i + 4 <= rowSize; i += 4)
+    {
+        __m128 sum = _mm_mul_ps(_mm_set1_ps(kernel[0]), _mm_loadu_ps(padded + i));
+        for (int k = 1; k < numTaps; ++k)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(kernel[k]), _mm_loadu_ps(padded + i + k * 3)));
+        _mm_storeu_ps(out + i, sum);
+    }
+#endif
+    for (; i < rowSize; ++i)
+    {
+        float sum = kernel[0] * padded[i];
+        for (int k = 1; k < numTaps; ++k)
+            sum += kernel[k] * padded[i + k * 3];
+        out[i] = sum;
+    }
+}
+
+void
+OVPostProcessor::generateNoise(unsigned int frameIndex, unsigned long long first, int count, float* out) const
+{
+    // Every frame has its own stream; each of its outputs gives two
+    // uniforms, turned into two normal samples by a Box-Muller transform
+    const float TwoPi = 6.28318530718f;
+    uint64_t frameSeed = MixBits(MixBits(((uint64_t)_key[0] << 32) | _key[1]) + frameIndex);
+    unsigned long long pair = first / 2;
+    int skip = (int)(first % 2);
+    while (count > 0)
+    {
+        uint64_t bits = MixBits(frameSeed + (pair + 1) * GoldenGamma);
+        float radius = std::sqrt(-2.0f * std::log(ToUniform((unsigned int)bits)));
+        float angle = TwoPi * ToUniform((unsigned int)(bits >> 32));
+        float samples[2] = { radius * std::cos(angle), radius * std::sin(angle) };
+
+        int n = std::min(2 - skip, count);
+        for (int j = 0; j < n; ++j)
+            *out++ = _noiseSigma * samples[skip + j];
+        count -= n;
+        skip = 0;
+        ++pair;
+    }
+}
+
+} // namespace ov
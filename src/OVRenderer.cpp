@@ -0,0 +1,405 @@
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cfloat>
+#include "OVRenderer.h"
+#include "OVFileUtil.h"
+#include "OVCommon.h"
+
+namespace ov
+{
+
+int OVRenderer::FrameWidth = 800;
+int OVRenderer::FrameHeight = 600;
+double OVRenderer::PlaneNear = 0.01;
+double OVRenderer::PlaneFar = 100;
+
+OVRenderer::OVRenderer()
+{
+    // Offset transformation coefficients
+    _offsetRotation = { 180, 0, 0 };
+    _offsetTranslation = { 0, 0, 7 };
+    _offsetScale = 1;
+
+    _renderMode = RENDER_SOLID;
+    _lightingOn = true;
+    _viewportWidth = FrameWidth;
+    _viewportHeight = FrameHeight;
+    _frameStats = NULL;
+    _auxOutputs = 0;
+    _modelMin = Vec3::Constant(DBL_MAX);
+    _modelMax = Vec3::Constant(-DBL_MAX);
+    resetMatrix();
+}
+
+OVRenderer::~OVRenderer()
+{
+}
+
+bool
+OVRenderer::setForegroundObject(const std::string& filename, bool isUnitization)
+{
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::unordered_map<std::string, unsigned int> textureIds;
+    std::string dir = GetDir(filename);
+    std::string err;
+
+    if(!tinyobj::LoadObj(shapes,
+                         materials,
+                         err,
+                         filename.c_str(),
+                         dir.c_str(),
+                         tinyobj::triangulation | tinyobj::calculate_normals))
+    {
+        ReportError(err);
+        return false;
+    }
+
+    if (!loadTextures(materials, textureIds, dir))
+        return false;
+
+    if (isUnitization)
+        unitize(shapes);
+
+    size_t numVertices = 0;
+    for (int i = 0; i < shapes.size(); ++i)
+        numVertices += shapes[i].mesh.positions.size() / 3;
+    _modelVertices.resize(3, numVertices);
+    for (int i = 0, column = 0; i < shapes.size(); ++i)
+    {
+        const std::vector<float>& positions = shapes[i].mesh.positions;
+        for (int v = 0; v + 2 < positions.size(); v += 3, ++column)
+            _modelVertices.col(column) << positions[v], positions[v + 1], positions[v + 2];
+    }
+    _modelMin = Vec3::Constant(DBL_MAX);
+    _modelMax = Vec3::Constant(-DBL_MAX);
+    if (numVertices > 0)
+    {
+        _modelMin = _modelVertices.rowwise().minCoeff().cast<double>();
+        _modelMax = _modelVertices.rowwise().maxCoeff().cast<double>();
+    }
+
+    releaseTextures(_textureIds);
+    _shapes = shapes;
+    _materials = materials;
+    _textureIds = textureIds;
+    _drawList.build(_shapes, _materials, _textureIds);
+    drawListChanged();
+
+    return true;
+}
+
+bool
+OVRenderer::setBackgroundImage(const std::string& filename)
+{
+    cv::Mat cameraImage = cv::imread(filename, CV_LOAD_IMAGE_COLOR);
+    if (cameraImage.empty())
+    {
+        ReportError("Cannot open \"" + filename + "\".\n");
+        return false;
+    }
+
+    return setBackgroundImage(cameraImage);
+}
+
+bool
+OVRenderer::setBackgroundImage(const cv::Mat& image)
+{
+    if (image.empty() || image.type() != CV_8UC3)
+        return false;
+
+    _backgroundImage = image;
+    FrameWidth = _backgroundImage.cols;
+    FrameHeight = _backgroundImage.rows;
+    uploadBackground();
+
+    return true;
+}
+
+bool
+OVRenderer::readCameraParameters(const std::string& camParamFile)
+{
+    cv::FileStorage fs(camParamFile, cv::FileStorage::READ);
+    if (!fs.isOpened())
+        return false;
+    cv::Mat cameraMatrix;
+    fs["camera_matrix"] >> cameraMatrix;
+
+    double fx = cameraMatrix.at<double>(0, 0);
+    double fy = cameraMatrix.at<double>(1, 1);
+    double cx = cameraMatrix.at<double>(0, 2);
+    double cy = cameraMatrix.at<double>(1, 2);
+
+    double w, h;
+    fs["image_width"] >> w;
+    fs["image_height"] >> h;
+
+    assert(FrameWidth == w && FrameHeight && h);
+
+    setProjection(fx, fy, cx, cy, w, h);
+
+    return true;
+}
+
+bool
+OVRenderer::ReadCameraImageSize(const std::string& camParamFile, int& width, int& height)
+{
+    cv::FileStorage fs(camParamFile, cv::FileStorage::READ);
+    if (!fs.isOpened())
+        return false;
+
+    double w = 0, h = 0;
+    fs["image_width"] >> w;
+    fs["image_height"] >> h;
+    width = (int)w;
+    height = (int)h;
+
+    return width > 0 && height > 0;
+}
+
+void
+OVRenderer::resetMatrix()
+{
+    // Get the default camera parameters accordring to the image size
+    double fx = Vec2(FrameWidth, FrameHeight).norm();
+    double fy = fx;
+    double cx = (FrameWidth - 1.) / 2.;
+    double cy = (FrameHeight - 1.) / 2.;
+    setProjection(fx, fy, cx, cy, FrameWidth, FrameHeight);
+
+    // Set the rotation matrix and translation vector
+    _R = Mat3::Identity();
+    _t = Vec3::Zero();
+}
+
+void
+OVRenderer::setOffsetPose(const Vec3& r, const Vec3& t, const double s)
+{
+    _offsetRotation = r;
+    _offsetTranslation = t;
+    _offsetScale = s;
+}
+
+void
+OVRenderer::getOffsetPose(Vec3& r, Vec3& t, double& s) const
+{
+    r = _offsetRotation;
+    t = _offsetTranslation;
+    s = _offsetScale;
+}
+
+Mat4
+OVRenderer::getModelViewMatrix() const
+{
+    // Same order as glTranslate, glRotate (z, y, x), glScale and then the pose
+    const double degToRad = 3.14159265358979323846 / 180.0;
+    Eigen::Affine3d offset = Eigen::Translation3d(_offsetTranslation)
+                           * Eigen::AngleAxisd(_offsetRotation[2] * degToRad, Vec3::UnitZ())
+                           * Eigen::AngleAxisd(_offsetRotation[1] * degToRad, Vec3::UnitY())
+                           * Eigen::AngleAxisd(_offsetRotation[0] * degToRad, Vec3::UnitX())
+                           * Eigen::Scaling(_offsetScale);
+
+    Mat4 pose = Mat4::Identity();
+    pose.block<3, 3>(0, 0) = _R;
+    pose.block<3, 1>(0, 3) = _t;
+
+    return offset.matrix() * pose;
+}
+
+void
+OVRenderer::setViewport(int width, int height)
+{
+    _viewportWidth = width;
+    _viewportHeight = height;
+}
+
+void
+OVRenderer::queueReadPixels()
+{
+    _readbackQueue.push_back(cv::Mat());
+    readPixels(_readbackQueue.back());
+}
+
+bool
+OVRenderer::collectPixels(cv::Mat& image)
+{
+    if (_readbackQueue.empty())
+        return false;
+
+    image = _readbackQueue.front();
+    _readbackQueue.pop_front();
+    return true;
+}
+
+void
+OVRenderer::renderPoses(const std::vector<Pose>& poses, std::vector<cv::Mat>& images)
+{
+    Mat3 R = _R;
+    Vec3 t = _t;
+    cv::Rect region = _readRegion;
+    _readRegion = cv::Rect();
+    images.resize(poses.size());
+    for (int i = 0; i < poses.size(); ++i)
+    {
+        setPose(poses[i].R, poses[i].t);
+        render();
+        readPixels(images[i]);
+    }
+    setPose(R, t);
+    _readRegion = region;
+}
+
+Mat34
+OVRenderer::getImageProjection() const
+{
+    // Clip w is the distance along the optical axis; NDC x and y run from
+    // -1 to 1, with y up while image rows go down
+    Mat4 clip = getProjectionMatrix() * getModelViewMatrix();
+    Mat34 projection;
+    projection.row(0) = (clip.row(0) + clip.row(3)) * (_viewportWidth / 2.0);
+    projection.row(1) = (clip.row(3) - clip.row(1)) * (_viewportHeight / 2.0);
+    projection.row(2) = clip.row(3);
+    return projection;
+}
+
+cv::Rect
+OVRenderer::getReadRegion() const
+{
+    cv::Rect frame(0, 0, _viewportWidth, _viewportHeight);
+    cv::Rect region = _readRegion & frame;
+    return (region.area() > 0) ? region : frame;
+}
+
+cv::Rect
+OVRenderer::getModelRegion(int margin) const
+{
+    cv::Rect frame(0, 0, _viewportWidth, _viewportHeight);
+    if (_modelMin.x() > _modelMax.x())
+        return frame;
+
+    Mat34 projection = getImageProjection();
+    double minX = DBL_MAX, minY = DBL_MAX, maxX = -DBL_MAX, maxY = -DBL_MAX;
+    for (int i = 0; i < 8; ++i)
+    {
+        Vec4 corner((i & 1) ? _modelMax.x() : _modelMin.x(), (i & 2) ? _modelMax.y() : _modelMin.y(),
+                    (i & 4) ? _modelMax.z() : _modelMin.z(), 1);
+        Vec3 image = projection * corner;
+        if (image.z() < PlaneNear)
+            return frame;
+        double x = image.x() / image.z();
+        double y = image.y() / image.z();
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+    }
+    int left = (int)std::max(std::floor(minX) - margin, -1.0);
+    int top = (int)std::max(std::floor(minY) - margin, -1.0);
+    int right = (int)std::min(std::ceil(maxX) + margin, _viewportWidth + 1.0);
+    int bottom = (int)std::min(std::ceil(maxY) + margin, _viewportHeight + 1.0);
+    cv::Rect region = cv::Rect(left, top, std::max(right - left, 0), std::max(bottom - top, 0)) & frame;
+    return (region.area() > 0) ? region : frame;
+}
+
+void
+OVRenderer::setProjection(double fx, double fy, double cx, double cy, double w, double h)
+{
+    _cameraMatrix << fx, 0, cx,
+                     0, fy, cy,
+                     0, 0, 1;
+
+    // Set the projection matrix for opengl
+    _projectionMatrix[0] = 2 * fx / w;
+    _projectionMatrix[1] = 0;
+    _projectionMatrix[2] = 0;
+    _projectionMatrix[3] = 0;
+    _projectionMatrix[4] = 0;
+    _projectionMatrix[5] = -2 * fy / h;
+    _projectionMatrix[6] = 0;
+    _projectionMatrix[7] = 0;
+    _projectionMatrix[8] = 2 * (cx / w) - 1;
+    _projectionMatrix[9] = 1 - 2 * (cy / h);
+    _projectionMatrix[10] = (PlaneFar + PlaneNear) / (PlaneFar - PlaneNear);
+    _projectionMatrix[11] = 1;
+    _projectionMatrix[12] = 0;
+    _projectionMatrix[13] = 0;
+    _projectionMatrix[14] = 2 * PlaneFar*PlaneNear / (PlaneNear - PlaneFar);
+    _projectionMatrix[15] = 0;
+}
+
+void
+OVRenderer::linearizeDepth(cv::Mat& depth) const
+{
+    // The inverse of the depth mapping of setProjection with the planes it was built with
+    double a = _projectionMatrix[10];
+    double b = _projectionMatrix[14];
+    for (int r = 0; r < depth.rows; ++r)
+    {
+        float* row = depth.ptr<float>(r);
+        for (int c = 0; c < depth.cols; ++c)
+            row[c] = (row[c] < 1.0f) ? (float)(b / (2.0 * row[c] - 1.0 - a)) : 0.0f;
+    }
+}
+
+void
+OVRenderer::unitize(std::vector<tinyobj::shape_t>& shapes)
+{
+    float maxx = FLT_MIN;
+    float minx = FLT_MAX;
+    float maxy = FLT_MIN;
+    float miny = FLT_MAX;
+    float maxz = FLT_MIN;
+    float minz = FLT_MAX;
+    float cx, cy, cz, w, h, d;
+    float scale;
+
+    for (int i = 0; i < shapes.size(); ++i)
+    {
+        for (int v = 0; v < shapes[i].mesh.positions.size() / 3; ++v)
+        {
+            if (maxx < shapes[i].mesh.positions[3 * v + 0])
+                maxx = shapes[i].mesh.positions[3 * v + 0];
+            if (minx > shapes[i].mesh.positions[3 * v + 0])
+                minx = shapes[i].mesh.positions[3 * v + 0];
+
+            if (maxy < shapes[i].mesh.positions[3 * v + 1])
+                maxy = shapes[i].mesh.positions[3 * v + 1];
+            if (miny > shapes[i].mesh.positions[3 * v + 1])
+                miny = shapes[i].mesh.positions[3 * v + 1];
+
+            if (maxz < shapes[i].mesh.positions[3 * v + 2])
+                maxz = shapes[i].mesh.positions[3 * v + 2];
+            if (minz > shapes[i].mesh.positions[3 * v + 2])
+                minz = shapes[i].mesh.positions[3 * v + 2];
+        }
+    }
+
+    // Calculate model width, height, and depth
+    w = abs(maxx) + abs(minx);
+    h = abs(maxy) + abs(miny);
+    d = abs(maxz) + abs(minz);
+
+    // Calculate center of the model
+    cx = (maxx + minx) / 2.0f;
+    cy = (maxy + miny) / 2.0f;
+    cz = (maxz + minz) / 2.0f;
+
+    // Calculate unitizing scale factor
+    scale = 2.0 / std::max(std::max(w, h), d);
+
+    // Translate around center then scale
+    for (int i = 0; i < shapes.size(); ++i)
+    {
+        for (int v = 0; v < shapes[i].mesh.positions.size() / 3; ++v)
+        {
+            shapes[i].mesh.positions[3 * v + 0] -= cx;
+            shapes[i].mesh.positions[3 * v + 1] -= cy;
+            shapes[i].mesh.positions[3 * v + 2] -= cz;
+            shapes[i].mesh.positions[3 * v + 0] *= scale;
+            shapes[i].mesh.positions[3 * v + 1] *= scale;
+            shapes[i].mesh.positions[3 * v + 2] *= scale;
+        }
+    }
+}
+
+} // namespace ov
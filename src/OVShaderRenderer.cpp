@@ -0,0 +1,906 @@
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "OVShaderRenderer.h"
+#include "OVTexture.h"
+
+namespace ov
+{
+
+namespace
+{
+
+// Binding points of the uniform blocks
+const GLuint FrameBinding = 0;
+const GLuint MaterialBinding = 1;
+const GLuint PoseBinding = 2;
+
+// Pixels between the tiles of an atlas. Triangles are clipped half way into
+// the gap, so the edges made by the clipping never show in wireframe mode.
+const int AtlasGutter = 2;
+
+// std140 layouts of the uniform blocks
+struct FrameBlock
+{
+    float projection[16];
+    float atlasGrid[4];     // Columns, and the clip margins in x and y
+    float atlasTile[4];     // Frame size and tile stride in normalized device coordinates
+    float lightPositions[4][4];
+    float lightAmbient[4];
+    float lightDiffuse[4];
+    float lightSpecular[4];
+    float globalAmbient[4];
+};
+
+struct PoseBlock
+{
+    float modelViews[OVShaderRenderer::MaxPosesPerPass][16];
+    float normalMatrices[OVShaderRenderer::MaxPosesPerPass][16];
+};
+
+struct MaterialBlock
+{
+    float ambient[4];
+    float diffuse[4];
+    float specular[4];
+    float        shininess;
+    unsigned int id;        // Material index + 1, 0 for the default material
+    float        padding[2];
+};
+
+// Gouraud shading with the lights and material model of the fixed-function
+// path. Instance i is drawn with pose i into tile i of the atlas grid.
+const char* const SceneVertexSource =
+    "layout(location = 0) in vec3 inPosition;\n"
+    "layout(location = 1) in vec3 inNormal;\n"
+    "layout(location = 2) in vec2 inTexcoord;\n"
+    "layout(location = 3) in uint inShapeId;\n"
+    "layout(std140) uniform Frame\n"
+    "{\n"
+    "    mat4 projection;\n"
+    "    vec4 atlasGrid;\n"
+    "    vec4 atlasTile;\n"
+    "    vec4 lightPositions[4];\n"
+    "    vec4 lightAmbient;\n"
+    "    vec4 lightDiffuse;\n"
+    "    vec4 lightSpecular;\n"
+    "    vec4 globalAmbient;\n"
+    "};\n"
+    "layout(std140) uniform Poses\n"
+    "{\n"
+    "    mat4 modelViews[MAX_POSES];\n"
+    "    mat4 normalMatrices[MAX_POSES];\n"
+    "};\n"
+    "layout(std140) uniform Material\n"
+    "{\n"
+    "    vec4  ambient;\n"
+    "    vec4  diffuse;\n"
+    "    vec4  specular;\n"
+    "    float shininess;\n"
+    "    uint  materialId;\n"
+    "};\n"
+    "out vec4 color;\n"
+    "out vec2 texcoord;\n"
+    "out vec3 normal;\n"
+    "flat out uvec2 ids;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 eyePosition = modelViews[gl_InstanceID] * vec4(inPosition, 1.0);\n"
+    "    vec4 clip = projection * eyePosition;\n"
+    "#ifdef ATLAS\n"
+    "    gl_ClipDistance[0] = clip.w * (1.0 + atlasGrid.y) + clip.x;\n"
+    "    gl_ClipDistance[1] = clip.w * (1.0 + atlasGrid.y) - clip.x;\n"
+    "    gl_ClipDistance[2] = clip.w * (1.0 + atlasGrid.z) + clip.y;\n"
+    "    gl_ClipDistance[3] = clip.w * (1.0 + atlasGrid.z) - clip.y;\n"
+    "#endif\n"
+    "    int cols = int(atlasGrid.x);\n"
+    "    float col = float(gl_InstanceID % cols);\n"
+    "    float row = float(gl_InstanceID / cols);\n"
+    "    gl_Position = vec4(atlasTile.x * clip.x + clip.w * (atlasTile.x - 1.0 + col * atlasTile.z),\n"
+    "                       atlasTile.y * clip.y + clip.w * (1.0 - atlasTile.y - row * atlasTile.w),\n"
+    "                       clip.z, clip.w);\n"
+    "    texcoord = inTexcoord;\n"
+    "    normal = mat3(normalMatrices[gl_InstanceID]) * inNormal;\n"
+    "    ids = uvec2(inShapeId + 1u, materialId);\n"
+    "#ifdef LIGHTING\n"
+    "    vec3 N = normal;\n"
+    "    vec3 c = ambient.rgb * globalAmbient.rgb;\n"
+    "    for (int i = 0; i < 4; ++i)\n"
+    "    {\n"
+    "        vec3 L = normalize(lightPositions[i].xyz - eyePosition.xyz);\n"
+    "        float NdotL = dot(N, L);\n"
+    "        c += ambient.rgb * lightAmbient.rgb;\n"
+    "        if (NdotL > 0.0)\n"
+    "        {\n"
+    "            vec3 H = normalize(L + vec3(0.0, 0.0, 1.0));\n"
+    "            float NdotH = max(dot(N, H), 0.0);\n"
+    "            float s = (shininess > 0.0) ? pow(NdotH, shininess) : 1.0;\n"
+    "            c += NdotL * diffuse.rgb * lightDiffuse.rgb + s * specular.rgb * lightSpecular.rgb;\n"
+    "        }\n"
+    "    }\n"
+    "    color = vec4(clamp(c, 0.0, 1.0), clamp(diffuse.a, 0.0, 1.0));\n"
+    "#else\n"
+    "    color = vec4(1.0);\n"
+    "#endif\n"
+    "}\n";
+
+// Outputs 1 and 2 are only stored when the auxiliary target is bound
+const char* const SceneFragmentSource =
+    "in vec4 color;\n"
+    "in vec2 texcoord;\n"
+    "in vec3 normal;\n"
+    "flat in uvec2 ids;\n"
+    "#ifdef TEXTURED\n"
+    "uniform sampler2D diffuseMap;\n"
+    "#endif\n"
+    "layout(location = 0) out vec4 fragColor;\n"
+    "layout(location = 1) out uvec2 fragIds;\n"
+    "layout(location = 2) out vec4 fragNormal;\n"
+    "void main()\n"
+    "{\n"
+    "#ifdef TEXTURED\n"
+    "    fragColor = color * texture(diffuseMap, texcoord);\n"
+    "#else\n"
+    "    fragColor = color;\n"
+    "#endif\n"
+    "    fragIds = ids;\n"
+    "    float length2 = dot(normal, normal);\n"
+    "    fragNormal = vec4(length2 > 0.0 ? normal * inversesqrt(length2) : vec3(0.0), 1.0);\n"
+    "}\n";
+
+// A textured rectangle from four vertices without attributes; the first
+// image row is at the top
+const char* const QuadVertexSource =
+    "uniform vec4 rect;\n"
+    "out vec2 texcoord;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));\n"
+    "    gl_Position = vec4(mix(rect.xy, rect.zw, corner), 0.0, 1.0);\n"
+    "    texcoord = vec2(corner.x, 1.0 - corner.y);\n"
+    "}\n";
+
+const char* const QuadFragmentSource =
+    "in vec2 texcoord;\n"
+    "uniform sampler2D image;\n"
+    "out vec4 fragColor;\n"
+    "void main()\n"
+    "{\n"
+    "    fragColor = texture(image, texcoord);\n"
+    "}\n";
+
+} // namespace
+
+OVShaderRenderer::OVShaderRenderer(OVRenderContext* context)
+    : OVGLRenderer(context)
+{
+    memset(_programs, 0, sizeof(_programs));
+    _quadProgram = 0;
+    _quadRectLocation = -1;
+    _vertexArray = 0;
+    _vertexBuffer = 0;
+    _indexBuffer = 0;
+    _emptyVertexArray = 0;
+    _frameBuffer = 0;
+    _materialBuffer = 0;
+    _poseBuffer = 0;
+    _materialStride = 0;
+    _atlasFramebuffer = 0;
+    _atlasColorbuffer = 0;
+    _atlasDepthbuffer = 0;
+    _atlasWidth = 0;
+    _atlasHeight = 0;
+    _auxFramebuffer = 0;
+    memset(_auxRenderbuffers, 0, sizeof(_auxRenderbuffers));
+    _auxWidth = 0;
+    _auxHeight = 0;
+    _isAuxPass = false;
+    _overlayTextureId = 0;
+}
+
+OVShaderRenderer::~OVShaderRenderer()
+{
+}
+
+void
+OVShaderRenderer::release()
+{
+    // A failed init leaves some of the objects unmade, and maybe entry
+    // points unloaded
+    GLuint* programs = &_programs[0][0][0];
+    for (size_t i = 0; i < sizeof(_programs) / sizeof(GLuint); ++i)
+    {
+        if (programs[i])
+            gl::DeleteProgram(programs[i]);
+    }
+    memset(_programs, 0, sizeof(_programs));
+    if (_quadProgram)
+        gl::DeleteProgram(_quadProgram);
+    _quadProgram = 0;
+
+    GLuint vertexArrays[] = { _vertexArray, _emptyVertexArray };
+    if (_vertexArray)
+        gl::DeleteVertexArrays(2, vertexArrays);
+    GLuint buffers[] = { _vertexBuffer, _indexBuffer, _frameBuffer, _materialBuffer, _poseBuffer };
+    if (_vertexBuffer)
+        gl::DeleteBuffers(5, buffers);
+    _vertexArray = _emptyVertexArray = 0;
+    _vertexBuffer = _indexBuffer = _frameBuffer = _materialBuffer = _poseBuffer = 0;
+
+    if (_atlasFramebuffer)
+    {
+        gl::DeleteFramebuffers(1, &_atlasFramebuffer);
+        gl::DeleteRenderbuffers(1, &_atlasColorbuffer);
+        gl::DeleteRenderbuffers(1, &_atlasDepthbuffer);
+    }
+    _atlasFramebuffer = _atlasColorbuffer = _atlasDepthbuffer = 0;
+    _atlasWidth = _atlasHeight = 0;
+    if (_auxFramebuffer)
+    {
+        gl::DeleteFramebuffers(1, &_auxFramebuffer);
+        gl::DeleteRenderbuffers(4, _auxRenderbuffers);
+    }
+    _auxFramebuffer = 0;
+    memset(_auxRenderbuffers, 0, sizeof(_auxRenderbuffers));
+    _auxWidth = _auxHeight = 0;
+
+    if (_overlayTextureId)
+        glDeleteTextures(1, &_overlayTextureId);
+    _overlayTextureId = 0;
+
+    OVGLRenderer::release();
+}
+
+bool
+OVShaderRenderer::IsSupported()
+{
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major < 3 || (major == 3 && minor < 3))
+        return false;
+
+    return gl::CreateShader && gl::GetUniformBlockIndex && gl::BindBufferRange
+        && gl::GenVertexArrays && gl::GenerateMipmap && gl::ActiveTexture
+        && gl::DrawElementsInstanced && gl::GenFramebuffers
+        && gl::VertexAttribIPointer && gl::DrawBuffers && gl::ClearBufferuiv && gl::ClearBufferfv;
+}
+
+bool
+OVShaderRenderer::init()
+{
+    LoadGLFunctions(_context->getProcAddressFn());
+    if (!IsSupported())
+    {
+        _err = "OpenGL 3.3 is not supported by this context";
+        return false;
+    }
+
+    // Writing gl_ClipDistance can change how some drivers rasterize lines even
+    // with the planes disabled, so only the atlas programs get them
+    for (int atlas = 0; atlas < 2; ++atlas)
+    {
+        for (int lighting = 0; lighting < 2; ++lighting)
+        {
+            for (int textured = 0; textured < 2; ++textured)
+            {
+                std::string defines = std::string(atlas ? "#define ATLAS\n" : "")
+                                    + std::string(lighting ? "#define LIGHTING\n" : "")
+                                    + std::string(textured ? "#define TEXTURED\n" : "");
+                GLuint program = buildProgram(SceneVertexSource, SceneFragmentSource, defines);
+                if (!program)
+                    return false;
+                gl::UniformBlockBinding(program, gl::GetUniformBlockIndex(program, "Frame"), FrameBinding);
+                gl::UniformBlockBinding(program, gl::GetUniformBlockIndex(program, "Material"), MaterialBinding);
+                gl::UniformBlockBinding(program, gl::GetUniformBlockIndex(program, "Poses"), PoseBinding);
+                if (textured)
+                {
+                    gl::UseProgram(program);
+                    gl::Uniform1i(gl::GetUniformLocation(program, "diffuseMap"), 0);
+                }
+                _programs[atlas][lighting][textured] = program;
+            }
+        }
+    }
+    _quadProgram = buildProgram(QuadVertexSource, QuadFragmentSource, "");
+    if (!_quadProgram)
+        return false;
+    gl::UseProgram(_quadProgram);
+    gl::Uniform1i(gl::GetUniformLocation(_quadProgram, "image"), 0);
+    _quadRectLocation = gl::GetUniformLocation(_quadProgram, "rect");
+    gl::UseProgram(0);
+
+    gl::GenVertexArrays(1, &_vertexArray);
+    gl::GenVertexArrays(1, &_emptyVertexArray);
+    gl::GenBuffers(1, &_vertexBuffer);
+    gl::GenBuffers(1, &_indexBuffer);
+    gl::GenBuffers(1, &_frameBuffer);
+    gl::GenBuffers(1, &_materialBuffer);
+    gl::GenBuffers(1, &_poseBuffer);
+    gl::BindBuffer(GL_UNIFORM_BUFFER, _frameBuffer);
+    gl::BufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), NULL, GL_DYNAMIC_DRAW);
+    gl::BindBuffer(GL_UNIFORM_BUFFER, _poseBuffer);
+    gl::BufferData(GL_UNIFORM_BUFFER, sizeof(PoseBlock), NULL, GL_DYNAMIC_DRAW);
+    gl::BindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    _materialStride = (int)((sizeof(MaterialBlock) + alignment - 1) / alignment * alignment);
+
+    _background.init();
+    glGenTextures(1, &_overlayTextureId);
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glDepthFunc(GL_LESS);
+
+    // The draw list may already hold a model
+    drawListChanged();
+
+    return true;
+}
+
+void
+OVShaderRenderer::render()
+{
+    std::vector<Pose> poses(1);
+    getPose(poses[0].R, poses[0].t);
+    updatePoseBlock(poses, 0, 1);
+    updateFrameBlock(1, 1, 0);
+
+    // With auxiliary outputs the frame is drawn into the auxiliary target
+    // and its color copied to the current one
+    int w = _viewportWidth;
+    int h = _viewportHeight;
+    GLint targetFramebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &targetFramebuffer);
+    _isAuxPass = (_auxOutputs != 0) && setupAuxTarget(w, h);
+    if (_isAuxPass)
+        gl::BindFramebuffer(GL_FRAMEBUFFER, _auxFramebuffer);
+
+    drawFrames(1, 1, 1, 0);
+
+    if (_isAuxPass)
+    {
+        gl::BindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffer);
+        gl::BlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        gl::BindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+        _isAuxPass = false;
+    }
+    glFlush();
+}
+
+bool
+OVShaderRenderer::readAuxPixels(AuxImages& images)
+{
+    if (!_auxOutputs || !_auxFramebuffer)
+        return false;
+
+    cv::Rect region = getReadRegion();
+    int x = region.x;
+    int y = _viewportHeight - region.y - region.height;
+    int w = region.width;
+    int h = region.height;
+    GLint targetFramebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &targetFramebuffer);
+    gl::BindFramebuffer(GL_FRAMEBUFFER, _auxFramebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    if (_auxOutputs & AUX_DEPTH)
+    {
+        images.depth.create(h, w, CV_32F);
+        glReadPixels(x, y, w, h, GL_DEPTH_COMPONENT, GL_FLOAT, images.depth.data);
+        cv::flip(images.depth, images.depth, 0);
+        linearizeDepth(images.depth);
+    }
+    if (_auxOutputs & AUX_IDS)
+    {
+        cv::Mat ids(h, w, CV_16UC2);
+        glReadBuffer(GL_COLOR_ATTACHMENT1);
+        glReadPixels(x, y, w, h, GL_RG_INTEGER, GL_UNSIGNED_SHORT, ids.data);
+        cv::flip(ids, ids, 0);
+        cv::Mat channels[2];
+        cv::split(ids, channels);
+        images.shapeIds = channels[0];
+        images.materialIds = channels[1];
+    }
+    if (_auxOutputs & AUX_NORMALS)
+    {
+        images.normals.create(h, w, CV_32FC3);
+        glReadBuffer(GL_COLOR_ATTACHMENT2);
+        glReadPixels(x, y, w, h, GL_RGB, GL_FLOAT, images.normals.data);
+        cv::flip(images.normals, images.normals, 0);
+    }
+
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    gl::BindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+    return true;
+}
+
+void
+OVShaderRenderer::renderPoses(const std::vector<Pose>& poses, std::vector<cv::Mat>& images)
+{
+    images.resize(poses.size());
+    if (poses.empty())
+        return;
+
+    // Square-ish grids that fit the largest renderbuffer
+    int w = _viewportWidth;
+    int h = _viewportHeight;
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxSize);
+    int tileW = w + AtlasGutter;
+    int tileH = h + AtlasGutter;
+    int maxCols = std::max(1, (int)maxSize / tileW);
+    int maxRows = std::max(1, (int)maxSize / tileH);
+    int passSize = std::min((int)poses.size(), MaxPosesPerPass);
+    int cols = std::min(maxCols, (int)std::ceil(std::sqrt((double)passSize)));
+    int rows = std::min(maxRows, (passSize + cols - 1) / cols);
+    passSize = std::min(passSize, cols * rows);
+    if (!setupAtlas(cols * tileW, rows * tileH))
+    {
+        OVRenderer::renderPoses(poses, images);
+        return;
+    }
+
+    // The context's own target is not necessarily framebuffer 0
+    GLint targetFramebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &targetFramebuffer);
+    gl::BindFramebuffer(GL_FRAMEBUFFER, _atlasFramebuffer);
+    cv::Mat atlas;
+    for (int first = 0; first < poses.size(); first += passSize)
+    {
+        int count = std::min(passSize, (int)poses.size() - first);
+        int passRows = (count + cols - 1) / cols;
+        updatePoseBlock(poses, first, count);
+        updateFrameBlock(cols, passRows, AtlasGutter);
+        drawFrames(count, cols, passRows, AtlasGutter);
+
+        // One readback for the pass; the first row of tiles is at the top
+        atlas.create(passRows * tileH, cols * tileW, CV_8UC3);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, cols * tileW, passRows * tileH, GL_BGR, GL_UNSIGNED_BYTE, atlas.data);
+        cv::flip(atlas, atlas, 0);
+        for (int i = 0; i < count; ++i)
+            atlas(cv::Rect((i % cols) * tileW, (i / cols) * tileH, w, h)).copyTo(images[first + i]);
+    }
+    gl::BindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+    glViewport(0, 0, (GLsizei)w, (GLsizei)h);
+}
+
+void
+OVShaderRenderer::drawFrames(int count, int cols, int rows, int gutter)
+{
+    bool isTimed = _frameStats && _frameStats->isEnabled();
+    if (isTimed)
+    {
+        _gpuTimer.collect(*_frameStats);
+        _gpuTimer.beginFrame(_frameStats->getFrameIndex());
+        _frameStats->beginPhase(PHASE_BACKGROUND);
+        _gpuTimer.beginPhase(PHASE_BACKGROUND);
+    }
+
+    // Tile i is in column i % cols and row i / cols from the top
+    int w = _viewportWidth;
+    int h = _viewportHeight;
+    int atlasW = cols * (w + gutter);
+    int atlasH = rows * (h + gutter);
+    glViewport(0, 0, (GLsizei)atlasW, (GLsizei)atlasH);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glDisable(GL_DEPTH_TEST);
+    for (int i = 0; i < count; ++i)
+    {
+        glViewport((i % cols) * (w + gutter), atlasH - (i / cols) * (h + gutter) - h, (GLsizei)w, (GLsizei)h);
+        drawQuad(_background.getTextureId(), -1, 1, 1, -1);
+    }
+    glViewport(0, 0, (GLsizei)atlasW, (GLsizei)atlasH);
+
+    // The background leaves the auxiliary buffers empty
+    if (_isAuxPass)
+    {
+        const GLuint zeroIds[4] = { 0, 0, 0, 0 };
+        const GLfloat zeroNormal[4] = { 0, 0, 0, 0 };
+        const GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+        gl::DrawBuffers(3, drawBuffers);
+        gl::ClearBufferuiv(GL_COLOR, 1, zeroIds);
+        gl::ClearBufferfv(GL_COLOR, 2, zeroNormal);
+    }
+
+    if (isTimed)
+    {
+        _frameStats->endPhase(PHASE_BACKGROUND);
+        _frameStats->beginPhase(PHASE_FOREGROUND);
+        _gpuTimer.beginPhase(PHASE_FOREGROUND);
+    }
+
+    const std::vector<DrawBatch>& batches = _drawList.batches();
+    if (!batches.empty())
+    {
+        // Tiles are clipped to their own frame only in an atlas
+        bool isAtlas = (gutter > 0);
+        for (int i = 0; i < 4 && isAtlas; ++i)
+            glEnable(GL_CLIP_DISTANCE0 + i);
+
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glPolygonMode(GL_FRONT_AND_BACK, _renderMode == RENDER_SOLID ? GL_FILL : GL_LINE);
+        gl::BindVertexArray(_vertexArray);
+        gl::ActiveTexture(GL_TEXTURE0);
+
+        // Batches are sorted by texture, so programs change at most twice
+        int lighting = _lightingOn ? 1 : 0;
+        GLuint preProgram = 0;
+        int preId = -2;
+        GLuint preTextureId = 0;
+        glBindTexture(GL_TEXTURE_2D, 0);
+        for (int b = 0; b < batches.size(); ++b)
+        {
+            const DrawBatch& batch = batches[b];
+            GLuint program = _programs[isAtlas ? 1 : 0][lighting][batch.textureId != 0 ? 1 : 0];
+            if (program != preProgram)
+            {
+                gl::UseProgram(program);
+                preProgram = program;
+            }
+            if (batch.materialId != preId)
+            {
+                gl::BindBufferRange(GL_UNIFORM_BUFFER, MaterialBinding, _materialBuffer,
+                                    (GLintptr)(batch.materialId + 1) * _materialStride, sizeof(MaterialBlock));
+                preId = batch.materialId;
+            }
+            if (batch.textureId != preTextureId)
+            {
+                glBindTexture(GL_TEXTURE_2D, batch.textureId);
+                preTextureId = batch.textureId;
+            }
+
+            gl::DrawElementsInstanced(GL_TRIANGLES, batch.indexCount, GL_UNSIGNED_INT,
+                                      (const void*)((size_t)batch.firstIndex * sizeof(unsigned int)), count);
+        }
+
+        gl::BindVertexArray(0);
+        gl::UseProgram(0);
+        glDisable(GL_BLEND);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        for (int i = 0; i < 4 && isAtlas; ++i)
+            glDisable(GL_CLIP_DISTANCE0 + i);
+    }
+
+    if (_isAuxPass)
+    {
+        const GLenum drawBuffer = GL_COLOR_ATTACHMENT0;
+        gl::DrawBuffers(1, &drawBuffer);
+    }
+
+    if (isTimed)
+    {
+        _gpuTimer.endFrame();
+        _frameStats->endPhase(PHASE_FOREGROUND);
+    }
+}
+
+void
+OVShaderRenderer::drawOverlay(const cv::Mat& image, int x, int y)
+{
+    glBindTexture(GL_TEXTURE_2D, _overlayTextureId);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.cols, image.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, image.data);
+
+    float w = (float)_viewportWidth;
+    float h = (float)_viewportHeight;
+    glDisable(GL_DEPTH_TEST);
+    drawQuad(_overlayTextureId, 2 * x / w - 1, 1 - 2 * y / h, 2 * (x + image.cols) / w - 1, 1 - 2 * (y + image.rows) / h);
+}
+
+bool
+OVShaderRenderer::loadTextures(std::vector<tinyobj::material_t>& materials,
+                               std::unordered_map<std::string, unsigned int>& textureIds,
+                               const std::string& dir)
+{
+    std::unordered_map<std::string, cv::Mat> textures;
+    if (!LoadTextureImages(materials, textures, dir))
+        return false;
+
+    // Same sampling as LoadTextures, with mipmaps built on the GPU
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (auto it = textures.begin(); it != textures.end(); ++it)
+    {
+        const cv::Mat& texture = it->second;
+        GLuint textureId;
+        glGenTextures(1, &textureId);
+        glBindTexture(GL_TEXTURE_2D, textureId);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+        GLenum format = (texture.type() == CV_8UC3) ? GL_BGR : GL_BGRA;
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, texture.cols, texture.rows, 0, format, GL_UNSIGNED_BYTE, texture.data);
+        gl::GenerateMipmap(GL_TEXTURE_2D);
+
+        textureIds[it->first] = textureId;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return true;
+}
+
+void
+OVShaderRenderer::drawListChanged()
+{
+    if (!_vertexArray)
+        return;
+
+    // Positions, normals, texture coordinates and shape indices one after another
+    const std::vector<float>& positions = _drawList.positions();
+    const std::vector<float>& normals = _drawList.normals();
+    const std::vector<float>& texcoords = _drawList.texcoords();
+    const std::vector<unsigned int>& shapeIds = _drawList.shapeIds();
+    const std::vector<unsigned int>& indices = _drawList.indices();
+    size_t positionBytes = positions.size() * sizeof(float);
+    size_t normalBytes = normals.size() * sizeof(float);
+    size_t texcoordBytes = texcoords.size() * sizeof(float);
+    size_t shapeIdBytes = shapeIds.size() * sizeof(unsigned int);
+    size_t shapeIdOffset = positionBytes + normalBytes + texcoordBytes;
+
+    gl::BindVertexArray(_vertexArray);
+    gl::BindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+    gl::BufferData(GL_ARRAY_BUFFER, shapeIdOffset + shapeIdBytes, NULL, GL_STATIC_DRAW);
+    if (!positions.empty())
+    {
+        gl::BufferSubData(GL_ARRAY_BUFFER, 0, positionBytes, &positions[0]);
+        gl::BufferSubData(GL_ARRAY_BUFFER, positionBytes, normalBytes, &normals[0]);
+        gl::BufferSubData(GL_ARRAY_BUFFER, positionBytes + normalBytes, texcoordBytes, &texcoords[0]);
+        gl::BufferSubData(GL_ARRAY_BUFFER, shapeIdOffset, shapeIdBytes, &shapeIds[0]);
+    }
+    gl::EnableVertexAttribArray(0);
+    gl::VertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (const void*)0);
+    gl::EnableVertexAttribArray(1);
+    gl::VertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (const void*)positionBytes);
+    gl::EnableVertexAttribArray(2);
+    gl::VertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (const void*)(positionBytes + normalBytes));
+    gl::EnableVertexAttribArray(3);
+    gl::VertexAttribIPointer(3, 1, GL_UNSIGNED_INT, 0, (const void*)shapeIdOffset);
+    gl::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer);
+    gl::BufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
+                   indices.empty() ? NULL : &indices[0], GL_STATIC_DRAW);
+    gl::BindVertexArray(0);
+    gl::BindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Block 0 is the OpenGL default material, block i + 1 is material i
+    std::vector<char> materialData((_materials.size() + 1) * _materialStride, 0);
+    for (int i = -1; i < (int)_materials.size(); ++i)
+    {
+        MaterialBlock block = { { 0.2f, 0.2f, 0.2f, 1.0f }, { 0.8f, 0.8f, 0.8f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f },
+                                0.0f, 0, { 0.0f, 0.0f } };
+        if (i >= 0)
+        {
+            const tinyobj::material_t& material = _materials[i];
+            memcpy(block.ambient, material.ambient, 3 * sizeof(float));
+            memcpy(block.diffuse, material.diffuse, 3 * sizeof(float));
+            memcpy(block.specular, material.specular, 3 * sizeof(float));
+            block.ambient[3] = block.diffuse[3] = block.specular[3] = material.dissolve;
+            block.shininess = material.shininess;
+            block.id = (unsigned int)(i + 1);
+        }
+        memcpy(&materialData[(i + 1) * _materialStride], &block, sizeof(block));
+    }
+    gl::BindBuffer(GL_UNIFORM_BUFFER, _materialBuffer);
+    gl::BufferData(GL_UNIFORM_BUFFER, materialData.size(), &materialData[0], GL_STATIC_DRAW);
+    gl::BindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+GLuint
+OVShaderRenderer::buildProgram(const char* vertexSource, const char* fragmentSource, const std::string& defines)
+{
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource, defines);
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource, defines);
+    if (!vertexShader || !fragmentShader)
+    {
+        if (vertexShader) gl::DeleteShader(vertexShader);
+        if (fragmentShader) gl::DeleteShader(fragmentShader);
+        return 0;
+    }
+
+    GLuint program = gl::CreateProgram();
+    gl::AttachShader(program, vertexShader);
+    gl::AttachShader(program, fragmentShader);
+    gl::LinkProgram(program);
+    gl::DeleteShader(vertexShader);
+    gl::DeleteShader(fragmentShader);
+
+    GLint isLinked = GL_FALSE;
+    gl::GetProgramiv(program, GL_LINK_STATUS, &isLinked);
+    if (!isLinked)
+    {
+        GLint length = 0;
+        gl::GetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+        std::vector<GLchar> log(length + 1, 0);
+        gl::GetProgramInfoLog(program, length, NULL, &log[0]);
+        _err = "Cannot link the shader program:\n" + std::string(&log[0]);
+        gl::DeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
+GLuint
+OVShaderRenderer::compileShader(GLenum type, const char* source, const std::string& defines)
+{
+    std::string header = "#version 330 core\n#define MAX_POSES " + std::to_string(MaxPosesPerPass) + "\n" + defines;
+    const GLchar* sources[2] = { header.c_str(), source };
+    GLuint shader = gl::CreateShader(type);
+    gl::ShaderSource(shader, 2, sources, NULL);
+    gl::CompileShader(shader);
+
+    GLint isCompiled = GL_FALSE;
+    gl::GetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
+    if (!isCompiled)
+    {
+        GLint length = 0;
+        gl::GetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+        std::vector<GLchar> log(length + 1, 0);
+        gl::GetShaderInfoLog(shader, length, NULL, &log[0]);
+        _err = "Cannot compile the shader:\n" + std::string(&log[0]);
+        gl::DeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+void
+OVShaderRenderer::updateFrameBlock(int cols, int rows, int gutter)
+{
+    FrameBlock block;
+    Eigen::Map<Eigen::Matrix4f>(block.projection) = getProjectionMatrix().cast<float>();
+    float w = (float)_viewportWidth;
+    float h = (float)_viewportHeight;
+    float atlasW = cols * (w + gutter);
+    float atlasH = rows * (h + gutter);
+    block.atlasGrid[0] = (float)cols;
+    block.atlasGrid[1] = gutter / w;
+    block.atlasGrid[2] = gutter / h;
+    block.atlasGrid[3] = 0.0f;
+    block.atlasTile[0] = w / atlasW;
+    block.atlasTile[1] = h / atlasH;
+    block.atlasTile[2] = 2 * (w + gutter) / atlasW;
+    block.atlasTile[3] = 2 * (h + gutter) / atlasH;
+
+    // The lights of OVGLRenderer::setupLights, in eye coordinates
+    const float lightPositions[4][4] =
+    {
+        { 7.0f, 0.0f, 0.0f, 1.0f },
+        { -7.0f, 0.0f, 0.0f, 1.0f },
+        { 0.0f, 7.0f, 0.0f, 1.0f },
+        { 0.0f, -7.0f, 0.0f, 1.0f },
+    };
+    memcpy(block.lightPositions, lightPositions, sizeof(lightPositions));
+    const float a[] = { 0.1f, 0.1f, 0.1f, 1.0f };
+    const float d[] = { 0.5f, 0.5f, 0.5f, 1.0f };
+    const float s[] = { 0.1f, 0.1f, 0.1f, 1.0f };
+    const float g[] = { 0.2f, 0.2f, 0.2f, 1.0f };
+    memcpy(block.lightAmbient, a, sizeof(a));
+    memcpy(block.lightDiffuse, d, sizeof(d));
+    memcpy(block.lightSpecular, s, sizeof(s));
+    memcpy(block.globalAmbient, g, sizeof(g));
+
+    gl::BindBuffer(GL_UNIFORM_BUFFER, _frameBuffer);
+    gl::BufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+    gl::BindBuffer(GL_UNIFORM_BUFFER, 0);
+    gl::BindBufferRange(GL_UNIFORM_BUFFER, FrameBinding, _frameBuffer, 0, sizeof(FrameBlock));
+}
+
+void
+OVShaderRenderer::updatePoseBlock(const std::vector<Pose>& poses, int first, int count)
+{
+    // Model-view matrices as getModelViewMatrix builds them, offset pose included
+    Mat3 R;
+    Vec3 t;
+    getPose(R, t);
+    PoseBlock block;
+    for (int i = 0; i < count; ++i)
+    {
+        setPose(poses[first + i].R, poses[first + i].t);
+        Eigen::Matrix4f modelView = getModelViewMatrix().cast<float>();
+        Eigen::Matrix4f normalMatrix = Eigen::Matrix4f::Identity();
+        normalMatrix.block<3, 3>(0, 0) = modelView.block<3, 3>(0, 0).inverse().transpose();
+        Eigen::Map<Eigen::Matrix4f>(block.modelViews[i]) = modelView;
+        Eigen::Map<Eigen::Matrix4f>(block.normalMatrices[i]) = normalMatrix;
+    }
+    setPose(R, t);
+
+    // Upload both arrays in full; the unused entries are never read
+    gl::BindBuffer(GL_UNIFORM_BUFFER, _poseBuffer);
+    gl::BufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+    gl::BindBuffer(GL_UNIFORM_BUFFER, 0);
+    gl::BindBufferRange(GL_UNIFORM_BUFFER, PoseBinding, _poseBuffer, 0, sizeof(PoseBlock));
+}
+
+bool
+OVShaderRenderer::setupAtlas(int width, int height)
+{
+    if (_atlasFramebuffer && width <= _atlasWidth && height <= _atlasHeight)
+        return true;
+
+    GLint targetFramebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &targetFramebuffer);
+    width = std::max(width, _atlasWidth);
+    height = std::max(height, _atlasHeight);
+
+    if (!_atlasFramebuffer)
+    {
+        gl::GenFramebuffers(1, &_atlasFramebuffer);
+        gl::GenRenderbuffers(1, &_atlasColorbuffer);
+        gl::GenRenderbuffers(1, &_atlasDepthbuffer);
+    }
+    gl::BindRenderbuffer(GL_RENDERBUFFER, _atlasColorbuffer);
+    gl::RenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    gl::BindRenderbuffer(GL_RENDERBUFFER, _atlasDepthbuffer);
+    gl::RenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    gl::BindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    gl::BindFramebuffer(GL_FRAMEBUFFER, _atlasFramebuffer);
+    gl::FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _atlasColorbuffer);
+    gl::FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _atlasDepthbuffer);
+    bool isComplete = (gl::CheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+    gl::BindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+
+    _atlasWidth = isComplete ? width : 0;
+    _atlasHeight = isComplete ? height : 0;
+    return isComplete;
+}
+
+bool
+OVShaderRenderer::setupAuxTarget(int width, int height)
+{
+    if (_auxFramebuffer && width == _auxWidth && height == _auxHeight)
+        return true;
+
+    GLint targetFramebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &targetFramebuffer);
+    if (!_auxFramebuffer)
+    {
+        gl::GenFramebuffers(1, &_auxFramebuffer);
+        gl::GenRenderbuffers(4, _auxRenderbuffers);
+    }
+
+    // Color, shape and material indices, normals and depth
+    const GLenum formats[4] = { GL_RGBA8, GL_RG16UI, GL_RGBA32F, GL_DEPTH_COMPONENT32F };
+    const GLenum attachments[4] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_DEPTH_ATTACHMENT };
+    gl::BindFramebuffer(GL_FRAMEBUFFER, _auxFramebuffer);
+    for (int i = 0; i < 4; ++i)
+    {
+        gl::BindRenderbuffer(GL_RENDERBUFFER, _auxRenderbuffers[i]);
+        gl::RenderbufferStorage(GL_RENDERBUFFER, formats[i], width, height);
+        gl::FramebufferRenderbuffer(GL_FRAMEBUFFER, attachments[i], GL_RENDERBUFFER, _auxRenderbuffers[i]);
+    }
+    gl::BindRenderbuffer(GL_RENDERBUFFER, 0);
+    bool isComplete = (gl::CheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+    gl::BindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+
+    _auxWidth = isComplete ? width : 0;
+    _auxHeight = isComplete ? height : 0;
+    return isComplete;
+}
+
+void
+OVShaderRenderer::drawQuad(GLuint textureId, float x0, float y0, float x1, float y1)
+{
+    // (x0, y0) is the corner showing the first texel of the first row
+    gl::UseProgram(_quadProgram);
+    gl::Uniform4f(_quadRectLocation, x0, y1, x1, y0);
+    gl::ActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, textureId);
+    gl::BindVertexArray(_emptyVertexArray);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    gl::BindVertexArray(0);
+    gl::UseProgram(0);
+}
+
+} // namespace ov
@@ -0,0 +1,705 @@
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include "OVSoftRenderer.h"
+#include "OVTexture.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OV_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace ov
+{
+
+namespace
+{
+
+// Triangles set up per parallel work item
+const int ChunkSize = 4096;
+
+// Floats in OVSoftRenderer::ClipVertex
+const int ClipVertexSize = 13;
+
+// The fixed-function state set by OVGLRenderer
+const float GlobalAmbient = 0.2f;
+const float LightAmbient = 0.1f;
+const float LightDiffuse = 0.5f;
+const float LightSpecular = 0.1f;
+const float LightPositions[4][3] =
+{
+    { 7.0f, 0.0f, 0.0f },
+    { -7.0f, 0.0f, 0.0f },
+    { 0.0f, 7.0f, 0.0f },
+    { 0.0f, -7.0f, 0.0f },
+};
+
+inline float
+Clamp01(float x)
+{
+    return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+}
+
+// Bilinear lookup with GL_REPEAT wrapping; texture rows are in OpenGL order
+inline void
+SampleTexture(const cv::Mat& texture, float u, float v, float rgba[4])
+{
+    int w = texture.cols;
+    int h = texture.rows;
+    int cn = texture.channels();
+    float x = u * w - 0.5f;
+    float y = v * h - 0.5f;
+    float fx = std::floor(x);
+    float fy = std::floor(y);
+    float ax = x - fx;
+    float ay = y - fy;
+    int x0 = (int)fx % w;
+    int y0 = (int)fy % h;
+    if (x0 < 0) x0 += w;
+    if (y0 < 0) y0 += h;
+    int x1 = (x0 + 1 == w) ? 0 : x0 + 1;
+    int y1 = (y0 + 1 == h) ? 0 : y0 + 1;
+
+    const uchar* row0 = texture.ptr<uchar>(y0);
+    const uchar* row1 = texture.ptr<uchar>(y1);
+    const uchar* p00 = row0 + x0 * cn;
+    const uchar* p01 = row0 + x1 * cn;
+    const uchar* p10 = row1 + x0 * cn;
+    const uchar* p11 = row1 + x1 * cn;
+    float w00 = (1 - ax) * (1 - ay), w01 = ax * (1 - ay), w10 = (1 - ax) * ay, w11 = ax * ay;
+
+    // BGR(A) texels to RGBA
+    const float inv255 = 1.0f / 255.0f;
+    for (int c = 0; c < 3; ++c)
+        rgba[2 - c] = (p00[c] * w00 + p01[c] * w01 + p10[c] * w10 + p11[c] * w11) * inv255;
+    if (cn == 4)
+        rgba[3] = (p00[3] * w00 + p01[3] * w01 + p10[3] * w10 + p11[3] * w11) * inv255;
+    else
+        rgba[3] = 1.0f;
+}
+
+// Vertex of a polygon being clipped, with the flag of the edge to the next vertex
+struct PolyVertex
+{
+    float v[ClipVertexSize];
+    bool  isEdge;
+};
+
+// Clip a polygon against the plane dot(plane, (x, y, z, w)) >= 0 (Sutherland-Hodgman)
+int
+ClipPolygon(const PolyVertex* in, int n, const float plane[4], PolyVertex* out)
+{
+    int m = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        const PolyVertex& a = in[i];
+        const PolyVertex& b = in[(i + 1) % n];
+        float da = plane[0] * a.v[0] + plane[1] * a.v[1] + plane[2] * a.v[2] + plane[3] * a.v[3];
+        float db = plane[0] * b.v[0] + plane[1] * b.v[1] + plane[2] * b.v[2] + plane[3] * b.v[3];
+        if (da >= 0)
+            out[m++] = a;
+        if ((da >= 0) != (db >= 0))
+        {
+            float t = da / (da - db);
+            PolyVertex& p = out[m++];
+            for (int k = 0; k < ClipVertexSize; ++k)
+                p.v[k] = a.v[k] + t * (b.v[k] - a.v[k]);
+            // Entering the half space continues the original edge; leaving starts the clip edge
+            p.isEdge = (da < 0) ? a.isEdge : false;
+        }
+    }
+    return m;
+}
+
+} // namespace
+
+OVSoftRenderer::OVSoftRenderer(int numThreads)
+{
+    if (numThreads > 0)
+    {
+        _threadPool = new OVThreadPool(numThreads);
+        _ownsThreadPool = true;
+    }
+    else
+    {
+        _threadPool = &OVThreadPool::Global();
+        _ownsThreadPool = false;
+    }
+    _nextTextureId = 1;
+    _tilesX = 0;
+    _tilesY = 0;
+    _projection.setIdentity();
+}
+
+OVSoftRenderer::~OVSoftRenderer()
+{
+    if (_ownsThreadPool)
+        delete _threadPool;
+}
+
+bool
+OVSoftRenderer::init()
+{
+    return true;
+}
+
+void
+OVSoftRenderer::render()
+{
+    int w = _viewportWidth;
+    int h = _viewportHeight;
+    if (w <= 0 || h <= 0)
+        return;
+
+    bool isTimed = _frameStats && _frameStats->isEnabled();
+    if (isTimed)
+        _frameStats->beginPhase(PHASE_BACKGROUND);
+
+    // The background quad is drawn with linear filtering over the whole viewport
+    if (_backgroundImage.empty())
+        _colorBuffer = cv::Mat::zeros(h, w, CV_8UC3);
+    else if (_backgroundImage.cols == w && _backgroundImage.rows == h)
+        _backgroundImage.copyTo(_colorBuffer);
+    else
+        cv::resize(_backgroundImage, _colorBuffer, cv::Size(w, h), 0, 0, cv::INTER_LINEAR);
+    _depthBuffer.assign((size_t)w * h, 1.0f);
+    if (_auxOutputs & AUX_IDS)
+    {
+        _shapeIdBuffer = cv::Mat::zeros(h, w, CV_16U);
+        _materialIdBuffer = cv::Mat::zeros(h, w, CV_16U);
+    }
+    else
+    {
+        _shapeIdBuffer.release();
+        _materialIdBuffer.release();
+    }
+    if (_auxOutputs & AUX_NORMALS)
+        _normalBuffer = cv::Mat::zeros(h, w, CV_32FC3);
+    else
+        _normalBuffer.release();
+
+    if (isTimed)
+    {
+        _frameStats->endPhase(PHASE_BACKGROUND);
+        _frameStats->beginPhase(PHASE_FOREGROUND);
+    }
+    renderForeground();
+    if (isTimed)
+        _frameStats->endPhase(PHASE_FOREGROUND);
+}
+
+void
+OVSoftRenderer::renderForeground()
+{
+    int w = _viewportWidth;
+    int h = _viewportHeight;
+    const std::vector<DrawBatch>& batches = _drawList.batches();
+    if (batches.empty())
+        return;
+
+    // Per-batch material state
+    std::vector<BatchMaterial> materials(batches.size());
+    for (int b = 0; b < batches.size(); ++b)
+    {
+        BatchMaterial& m = materials[b];
+        float ambient[4] = { 0.2f, 0.2f, 0.2f, 1.0f };
+        float diffuse[4] = { 0.8f, 0.8f, 0.8f, 1.0f };
+        float specular[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+        float shininess = 0.0f;
+        if (batches[b].materialId >= 0)
+        {
+            const tinyobj::material_t& material = _materials[batches[b].materialId];
+            for (int c = 0; c < 3; ++c)
+            {
+                ambient[c] = material.ambient[c];
+                diffuse[c] = material.diffuse[c];
+                specular[c] = material.specular[c];
+            }
+            ambient[3] = diffuse[3] = specular[3] = material.dissolve;
+            shininess = material.shininess;
+        }
+        std::copy(ambient, ambient + 4, m.ambient);
+        std::copy(diffuse, diffuse + 4, m.diffuse);
+        std::copy(specular, specular + 4, m.specular);
+        m.shininess = shininess;
+        m.id = (unsigned short)(batches[b].materialId + 1);
+        auto got = _textures.find(batches[b].textureId);
+        m.texture = (got == _textures.end()) ? NULL : &got->second;
+    }
+
+    // Vertex stage
+    Eigen::Matrix4f modelView = getModelViewMatrix().cast<float>();
+    _projection = getProjectionMatrix().cast<float>();
+    int numVertices = _drawList.stats().vertexCount;
+    _eyePositions.resize(numVertices);
+    _eyeNormals.resize(numVertices);
+    int numVertexChunks = (numVertices + ChunkSize - 1) / ChunkSize;
+    _threadPool->parallelFor(numVertexChunks, [this, &modelView, numVertices](int chunk)
+    {
+        transformVertices(chunk * ChunkSize, std::min((chunk + 1) * ChunkSize, numVertices), modelView);
+    });
+
+    // Triangle setup and clipping, kept in draw order per chunk
+    int numTriangles = _drawList.stats().triangleCount;
+    int numChunks = (numTriangles + ChunkSize - 1) / ChunkSize;
+    _chunkTriangles.resize(numChunks);
+    _threadPool->parallelFor(numChunks, [this, &materials](int chunk)
+    {
+        setupTriangles(chunk, materials);
+    });
+
+    // Binning preserves the draw order inside every tile
+    _tilesX = (w + TileSize - 1) / TileSize;
+    _tilesY = (h + TileSize - 1) / TileSize;
+    _tileBins.resize(_tilesX * _tilesY);
+    for (int i = 0; i < _tileBins.size(); ++i)
+        _tileBins[i].clear();
+    for (int c = 0; c < numChunks; ++c)
+    {
+        const std::vector<Triangle>& triangles = _chunkTriangles[c];
+        for (int i = 0; i < triangles.size(); ++i)
+        {
+            const Triangle& tri = triangles[i];
+            for (int ty = tri.minTileY; ty <= tri.maxTileY; ++ty)
+                for (int tx = tri.minTileX; tx <= tri.maxTileX; ++tx)
+                    _tileBins[ty * _tilesX + tx].push_back(&tri);
+        }
+    }
+
+    _threadPool->parallelFor(_tilesX * _tilesY, [this](int tile)
+    {
+        rasterizeTile(tile);
+    });
+}
+
+void
+OVSoftRenderer::readPixels(cv::Mat& image)
+{
+    _colorBuffer(getReadRegion()).copyTo(image);
+}
+
+bool
+OVSoftRenderer::readAuxPixels(AuxImages& images)
+{
+    if (!_auxOutputs || _colorBuffer.empty())
+        return false;
+
+    cv::Rect region = getReadRegion();
+    if (_auxOutputs & AUX_DEPTH)
+    {
+        cv::Mat(_colorBuffer.rows, _colorBuffer.cols, CV_32F, &_depthBuffer[0])(region).copyTo(images.depth);
+        linearizeDepth(images.depth);
+    }
+    if (_auxOutputs & AUX_IDS)
+    {
+        _shapeIdBuffer(region).copyTo(images.shapeIds);
+        _materialIdBuffer(region).copyTo(images.materialIds);
+    }
+    if (_auxOutputs & AUX_NORMALS)
+        _normalBuffer(region).copyTo(images.normals);
+    return true;
+}
+
+bool
+OVSoftRenderer::loadTextures(std::vector<tinyobj::material_t>& materials,
+                             std::unordered_map<std::string, unsigned int>& textureIds,
+                             const std::string& dir)
+{
+    std::unordered_map<std::string, cv::Mat> textures;
+    if (!LoadTextureImages(materials, textures, dir))
+        return false;
+
+    for (auto it = textures.begin(); it != textures.end(); ++it)
+    {
+        _textures[_nextTextureId] = it->second;
+        textureIds[it->first] = _nextTextureId++;
+    }
+
+    return true;
+}
+
+void
+OVSoftRenderer::releaseTextures(const std::unordered_map<std::string, unsigned int>& textureIds)
+{
+    for (auto it = textureIds.begin(); it != textureIds.end(); ++it)
+        _textures.erase(it->second);
+}
+
+void
+OVSoftRenderer::uploadBackground()
+{
+    // The background is read directly from _backgroundImage
+}
+
+void
+OVSoftRenderer::transformVertices(int first, int last, const Eigen::Matrix4f& modelView)
+{
+    // Normals use the inverse transpose without renormalization, as GL_NORMALIZE is off
+    Eigen::Matrix3f normalMatrix = modelView.block<3, 3>(0, 0).inverse().transpose();
+    const float* positions = &_drawList.positions()[0];
+    const float* normals = &_drawList.normals()[0];
+    for (int i = first; i < last; ++i)
+    {
+        Eigen::Vector4f p(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2], 1.0f);
+        _eyePositions[i] = (modelView * p).head<3>();
+        _eyeNormals[i] = normalMatrix * Eigen::Map<const Eigen::Vector3f>(normals + 3 * i);
+    }
+}
+
+void
+OVSoftRenderer::shadeVertex(int index, const BatchMaterial& material, const Eigen::Matrix4f& projection, ClipVertex& out) const
+{
+    const Eigen::Vector3f& P = _eyePositions[index];
+    Eigen::Vector4f clip = projection * Eigen::Vector4f(P[0], P[1], P[2], 1.0f);
+    out.x = clip[0];
+    out.y = clip[1];
+    out.z = clip[2];
+    out.w = clip[3];
+    out.u = _drawList.texcoords()[2 * index];
+    out.v = _drawList.texcoords()[2 * index + 1];
+    out.nx = _eyeNormals[index][0];
+    out.ny = _eyeNormals[index][1];
+    out.nz = _eyeNormals[index][2];
+
+    if (!_lightingOn)
+    {
+        out.r = out.g = out.b = out.a = 1.0f;
+        return;
+    }
+
+    // OpenGL 1.x lighting with an infinite viewer and no attenuation
+    const Eigen::Vector3f& N = _eyeNormals[index];
+    float color[3];
+    for (int c = 0; c < 3; ++c)
+        color[c] = material.ambient[c] * GlobalAmbient;
+    for (int l = 0; l < 4; ++l)
+    {
+        Eigen::Vector3f L = (Eigen::Vector3f(LightPositions[l][0], LightPositions[l][1], LightPositions[l][2]) - P).normalized();
+        float NdotL = N.dot(L);
+        float diffuse = std::max(NdotL, 0.0f);
+        float specular = 0.0f;
+        if (NdotL > 0)
+        {
+            Eigen::Vector3f H = (L + Eigen::Vector3f(0, 0, 1)).normalized();
+            specular = std::pow(std::max(N.dot(H), 0.0f), material.shininess);
+        }
+        for (int c = 0; c < 3; ++c)
+            color[c] += material.ambient[c] * LightAmbient
+                      + diffuse * material.diffuse[c] * LightDiffuse
+                      + specular * material.specular[c] * LightSpecular;
+    }
+    out.r = Clamp01(color[0]);
+    out.g = Clamp01(color[1]);
+    out.b = Clamp01(color[2]);
+    out.a = Clamp01(material.diffuse[3]);
+}
+
+void
+OVSoftRenderer::setupTriangles(int chunk, const std::vector<BatchMaterial>& materials)
+{
+    const std::vector<DrawBatch>& batches = _drawList.batches();
+    const std::vector<unsigned int>& indices = _drawList.indices();
+    const std::vector<unsigned int>& shapeIds = _drawList.shapeIds();
+    std::vector<Triangle>& out = _chunkTriangles[chunk];
+    static_assert(sizeof(ClipVertex) == ClipVertexSize * sizeof(float), "ClipVertex is copied as floats");
+    out.clear();
+
+    int first = chunk * ChunkSize;
+    int last = std::min(first + ChunkSize, (int)(indices.size() / 3));
+
+    // The batch holding the first triangle of the chunk
+    int b = (int)(std::upper_bound(batches.begin(), batches.end(), (unsigned int)(3 * first),
+                                   [](unsigned int index, const DrawBatch& batch) { return index < batch.firstIndex; })
+                  - batches.begin()) - 1;
+
+    const float planes[2][4] =
+    {
+        { 0, 0, 1, 1 },     // Near: z + w >= 0
+        { 0, 0, -1, 1 },    // Far: w - z >= 0
+    };
+    for (int t = first; t < last; ++t)
+    {
+        while (3 * t >= batches[b].firstIndex + batches[b].indexCount)
+            ++b;
+        const BatchMaterial& material = materials[b];
+        unsigned short shapeId = (unsigned short)(shapeIds[indices[3 * t]] + 1);
+
+        ClipVertex v[3];
+        for (int j = 0; j < 3; ++j)
+            shadeVertex(indices[3 * t + j], material, _projection, v[j]);
+
+        bool isInside = true;
+        for (int j = 0; j < 3; ++j)
+            isInside = isInside && (v[j].z >= -v[j].w) && (v[j].z <= v[j].w);
+        if (isInside)
+        {
+            emitTriangle(v, 7, material, shapeId, out);
+            continue;
+        }
+
+        // Clip against the near and far planes and fan the polygon back into triangles
+        PolyVertex poly[2][8];
+        int n = 3;
+        for (int j = 0; j < 3; ++j)
+        {
+            memcpy(poly[0][j].v, &v[j], sizeof(ClipVertex));
+            poly[0][j].isEdge = true;
+        }
+        n = ClipPolygon(poly[0], n, planes[0], poly[1]);
+        n = ClipPolygon(poly[1], n, planes[1], poly[0]);
+        for (int i = 1; i + 1 < n; ++i)
+        {
+            ClipVertex fan[3];
+            memcpy(&fan[0], poly[0][0].v, sizeof(ClipVertex));
+            memcpy(&fan[1], poly[0][i].v, sizeof(ClipVertex));
+            memcpy(&fan[2], poly[0][i + 1].v, sizeof(ClipVertex));
+            int edgeFlags = ((i == 1 && poly[0][0].isEdge) ? 1 : 0)
+                          | (poly[0][i].isEdge ? 2 : 0)
+                          | ((i + 2 == n && poly[0][n - 1].isEdge) ? 4 : 0);
+            emitTriangle(fan, edgeFlags, material, shapeId, out);
+        }
+    }
+}
+
+void
+OVSoftRenderer::emitTriangle(const ClipVertex* v, int edgeFlags, const BatchMaterial& material, unsigned short shapeId,
+                             std::vector<Triangle>& out) const
+{
+    int w = _viewportWidth;
+    int h = _viewportHeight;
+
+    Triangle tri;
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+    for (int j = 0; j < 3; ++j)
+    {
+        if (v[j].w <= 0)
+            return;
+        float invW = 1.0f / v[j].w;
+        tri.invW[j] = invW;
+        tri.sx[j] = (v[j].x * invW + 1.0f) * 0.5f * w;
+        tri.sy[j] = (1.0f - v[j].y * invW) * 0.5f * h;
+        tri.sz[j] = (v[j].z * invW + 1.0f) * 0.5f;
+        tri.attr[j][0] = v[j].r * invW;
+        tri.attr[j][1] = v[j].g * invW;
+        tri.attr[j][2] = v[j].b * invW;
+        tri.attr[j][3] = v[j].a * invW;
+        tri.attr[j][4] = v[j].u * invW;
+        tri.attr[j][5] = v[j].v * invW;
+        tri.attr[j][6] = v[j].nx * invW;
+        tri.attr[j][7] = v[j].ny * invW;
+        tri.attr[j][8] = v[j].nz * invW;
+        minX = std::min(minX, tri.sx[j]);
+        maxX = std::max(maxX, tri.sx[j]);
+        minY = std::min(minY, tri.sy[j]);
+        maxY = std::max(maxY, tri.sy[j]);
+    }
+    if (maxX < 0 || maxY < 0 || minX >= w || minY >= h)
+        return;
+
+    bool isWireframe = (_renderMode == RENDER_WIREFRAME);
+    float area = (tri.sx[1] - tri.sx[0]) * (tri.sy[2] - tri.sy[0]) - (tri.sx[2] - tri.sx[0]) * (tri.sy[1] - tri.sy[0]);
+    if ((area == 0 && !isWireframe) || (isWireframe && edgeFlags == 0))
+        return;
+
+    tri.texture = material.texture;
+    tri.shapeId = shapeId;
+    tri.materialId = material.id;
+    tri.edgeFlags = edgeFlags;
+    tri.minTileX = std::max((int)std::floor(minX), 0) / TileSize;
+    tri.minTileY = std::max((int)std::floor(minY), 0) / TileSize;
+    tri.maxTileX = std::min((int)std::floor(maxX), w - 1) / TileSize;
+    tri.maxTileY = std::min((int)std::floor(maxY), h - 1) / TileSize;
+    out.push_back(tri);
+}
+
+void
+OVSoftRenderer::rasterizeTile(int tile)
+{
+    int x0 = (tile % _tilesX) * TileSize;
+    int y0 = (tile / _tilesX) * TileSize;
+    int x1 = std::min(x0 + TileSize, _viewportWidth) - 1;
+    int y1 = std::min(y0 + TileSize, _viewportHeight) - 1;
+
+    const std::vector<const Triangle*>& bin = _tileBins[tile];
+    for (int i = 0; i < bin.size(); ++i)
+    {
+        if (_renderMode == RENDER_WIREFRAME)
+            drawTriangleEdges(*bin[i], x0, y0, x1, y1);
+        else
+            fillTriangle(*bin[i], x0, y0, x1, y1);
+    }
+}
+
+void
+OVSoftRenderer::fillTriangle(const Triangle& tri, int x0, int y0, int x1, int y1)
+{
+    // Edge functions e_i(p) = A_i (p.x - ax) + B_i (p.y - ay) of the edge
+    // opposite to vertex i, oriented to be positive inside
+    float A[3], B[3], ax[3], ay[3];
+    bool isTopLeft[3];
+    float area = (tri.sx[1] - tri.sx[0]) * (tri.sy[2] - tri.sy[0]) - (tri.sx[2] - tri.sx[0]) * (tri.sy[1] - tri.sy[0]);
+    float sign = (area > 0) ? 1.0f : -1.0f;
+    for (int i = 0; i < 3; ++i)
+    {
+        int a = (i + 1) % 3;
+        int b = (i + 2) % 3;
+        A[i] = sign * (tri.sy[a] - tri.sy[b]);
+        B[i] = sign * (tri.sx[b] - tri.sx[a]);
+        ax[i] = tri.sx[a];
+        ay[i] = tri.sy[a];
+        isTopLeft[i] = (A[i] > 0) || (A[i] == 0 && B[i] > 0);
+    }
+    float invArea = 1.0f / std::fabs(area);
+
+    // Clamp the bounding box to the tile
+    int bx0 = std::max(x0, (int)std::floor(std::min(tri.sx[0], std::min(tri.sx[1], tri.sx[2]))));
+    int by0 = std::max(y0, (int)std::floor(std::min(tri.sy[0], std::min(tri.sy[1], tri.sy[2]))));
+    int bx1 = std::min(x1, (int)std::ceil(std::max(tri.sx[0], std::max(tri.sx[1], tri.sx[2]))));
+    int by1 = std::min(y1, (int)std::ceil(std::max(tri.sy[0], std::max(tri.sy[1], tri.sy[2]))));
+
+#ifdef OV_USE_SSE2
+    const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 vA[3], topLeftMask[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        vA[i] = _mm_set1_ps(A[i]);
+        topLeftMask[i] = _mm_castsi128_ps(_mm_set1_epi32(isTopLeft[i] ? -1 : 0));
+    }
+    for (int y = by0; y <= by1; ++y)
+    {
+        float py = y + 0.5f;
+        __m128 rowTerm[3];
+        for (int i = 0; i < 3; ++i)
+            rowTerm[i] = _mm_set1_ps(B[i] * (py - ay[i]) - A[i] * ax[i]);
+        for (int x = bx0; x <= bx1; x += 4)
+        {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+            __m128 e[3];
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int i = 0; i < 3; ++i)
+            {
+                e[i] = _mm_add_ps(_mm_mul_ps(vA[i], px), rowTerm[i]);
+                // Pixels on an edge belong to the triangle only if the edge is a top or left one
+                __m128 edgeInside = _mm_and_ps(_mm_cmpge_ps(e[i], zero),
+                                               _mm_or_ps(_mm_cmpgt_ps(e[i], zero), topLeftMask[i]));
+                inside = _mm_and_ps(inside, edgeInside);
+            }
+            int mask = _mm_movemask_ps(inside);
+            if (bx1 - x < 3)
+                mask &= (1 << (bx1 - x + 1)) - 1;
+            if (mask == 0)
+                continue;
+
+            float e0[4], e1[4], e2[4];
+            _mm_storeu_ps(e0, e[0]);
+            _mm_storeu_ps(e1, e[1]);
+            _mm_storeu_ps(e2, e[2]);
+            for (int k = 0; k < 4; ++k)
+            {
+                if (mask & (1 << k))
+                    shadeFragment(tri, x + k, y, e0[k] * invArea, e1[k] * invArea, e2[k] * invArea);
+            }
+        }
+    }
+#else
+    for (int y = by0; y <= by1; ++y)
+    {
+        float py = y + 0.5f;
+        for (int x = bx0; x <= bx1; ++x)
+        {
+            float px = x + 0.5f;
+            float e[3];
+            bool isInside = true;
+            for (int i = 0; i < 3; ++i)
+            {
+                e[i] = A[i] * (px - ax[i]) + B[i] * (py - ay[i]);
+                isInside = isInside && (e[i] > 0 || (e[i] == 0 && isTopLeft[i]));
+            }
+            if (isInside)
+                shadeFragment(tri, x, y, e[0] * invArea, e[1] * invArea, e[2] * invArea);
+        }
+    }
+#endif
+}
+
+void
+OVSoftRenderer::drawTriangleEdges(const Triangle& tri, int x0, int y0, int x1, int y1)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        if (!(tri.edgeFlags & (1 << i)))
+            continue;
+
+        int j = (i + 1) % 3;
+        float dx = tri.sx[j] - tri.sx[i];
+        float dy = tri.sy[j] - tri.sy[i];
+        int steps = std::max(1, (int)std::ceil(std::max(std::fabs(dx), std::fabs(dy))));
+        for (int s = 0; s <= steps; ++s)
+        {
+            float t = (float)s / steps;
+            int x = (int)std::floor(tri.sx[i] + t * dx);
+            int y = (int)std::floor(tri.sy[i] + t * dy);
+            if (x < x0 || x > x1 || y < y0 || y > y1)
+                continue;
+
+            float b[3] = { 0, 0, 0 };
+            b[i] = 1 - t;
+            b[j] = t;
+            shadeFragment(tri, x, y, b[0], b[1], b[2]);
+        }
+    }
+}
+
+void
+OVSoftRenderer::shadeFragment(const Triangle& tri, int x, int y, float b0, float b1, float b2)
+{
+    size_t index = (size_t)y * _viewportWidth + x;
+    float z = b0 * tri.sz[0] + b1 * tri.sz[1] + b2 * tri.sz[2];
+    if (!(z < _depthBuffer[index]))
+        return;
+
+    // Perspective-correct attributes: attr/w and 1/w are linear in screen space
+    float invW = 1.0f / (b0 * tri.invW[0] + b1 * tri.invW[1] + b2 * tri.invW[2]);
+    float attr[9];
+    for (int k = 0; k < 9; ++k)
+        attr[k] = (b0 * tri.attr[0][k] + b1 * tri.attr[1][k] + b2 * tri.attr[2][k]) * invW;
+
+    // GL_MODULATE
+    if (tri.texture)
+    {
+        float texel[4];
+        SampleTexture(*tri.texture, attr[4], attr[5], texel);
+        for (int k = 0; k < 4; ++k)
+            attr[k] *= texel[k];
+    }
+
+    // Blend with GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+    float alpha = Clamp01(attr[3]);
+    uchar* dst = _colorBuffer.ptr<uchar>(y) + 3 * x;
+    for (int c = 0; c < 3; ++c)
+    {
+        float src = Clamp01(attr[2 - c]) * 255.0f;
+        dst[c] = (uchar)(src * alpha + dst[c] * (1.0f - alpha) + 0.5f);
+    }
+    _depthBuffer[index] = z;
+
+    // Auxiliary outputs keep the nearest surface, translucent or not
+    if (!_shapeIdBuffer.empty())
+    {
+        _shapeIdBuffer.ptr<unsigned short>(y)[x] = tri.shapeId;
+        _materialIdBuffer.ptr<unsigned short>(y)[x] = tri.materialId;
+    }
+    if (!_normalBuffer.empty())
+    {
+        float* normal = _normalBuffer.ptr<float>(y) + 3 * x;
+        float length2 = attr[6] * attr[6] + attr[7] * attr[7] + attr[8] * attr[8];
+        float scale = (length2 > 0) ? 1.0f / std::sqrt(length2) : 0.0f;
+        for (int k = 0; k < 3; ++k)
+            normal[k] = attr[6 + k] * scale;
+    }
+}
+
+} // namespace ov
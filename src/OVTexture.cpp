@@ -1,11 +1,10 @@
-#include <wx/msgdlg.h>
-#include <GL/gl.h>
+#include "OVGL.h"
 #include <GL/glu.h>
 #include <string>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include "OVTexture.h"
-#include "OVUtil.h"
+#include "OVFileUtil.h"
 #include "TinyObjLoader.h"
 
 namespace ov
@@ -18,7 +17,45 @@ bool
 LoadTextures(std::vector<tinyobj::material_t>& materials,
              std::unordered_map<std::string, GLuint>& textureIds,
              const std::string& dir)
-  {
+{
+    std::unordered_map<std::string, cv::Mat> textures;
+    if (!LoadTextureImages(materials, textures, dir))
+        return false;
+
+    for (auto it = textures.begin(); it != textures.end(); ++it)
+    {
+        const cv::Mat& texture = it->second;
+        GLuint textureId;
+        int width = texture.cols;
+        int height = texture.rows;
+
+        if ((width * 3) % 4 == 0)
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        else
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        glGenTextures(1, &textureId);
+        glBindTexture(GL_TEXTURE_2D, textureId);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+        int type = (texture.type() == CV_8UC3) ? GL_BGR : GL_BGRA;
+        gluBuild2DMipmaps(GL_TEXTURE_2D, GL_RGBA, width, height, type, GL_UNSIGNED_BYTE, texture.data);
+
+        textureIds[it->first] = textureId;
+    }
+
+    return true;
+}
+
+bool
+LoadTextureImages(std::vector<tinyobj::material_t>& materials,
+                  std::unordered_map<std::string, cv::Mat>& textures,
+                  const std::string& dir)
+{
     for (int i = 0; i < materials.size(); ++i)
     {
         std::string map_Kd = materials[i].diffuse_texname;
@@ -32,33 +69,12 @@ LoadTextures(std::vector<tinyobj::material_t>& materials,
             map_Kd = map_Kd.substr(strBegin, strRange);
         }
 
-        if (map_Kd != "" && textureIds.find(map_Kd) == textureIds.end())
+        if (map_Kd != "" && textures.find(map_Kd) == textures.end())
         {
             cv::Mat texture;
             if (!LoadTexture(texture, dir + map_Kd))
                 return false;
-
-            GLuint textureId;
-            int width = texture.cols;
-            int height = texture.rows;
-
-            if ((width * 3) % 4 == 0)
-                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-            else
-                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-            glGenTextures(1, &textureId);
-            glBindTexture(GL_TEXTURE_2D, textureId);
-
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST_MIPMAP_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-            int type = (texture.type() == CV_8UC3) ? GL_BGR : GL_BGRA;
-            gluBuild2DMipmaps(GL_TEXTURE_2D, GL_RGBA, width, height, type, GL_UNSIGNED_BYTE, texture.data);
-
-            textureIds[map_Kd] = textureId;
+            textures[map_Kd] = texture;
         }
     }
 
@@ -80,8 +96,7 @@ LoadTexture(cv::Mat& texture, const std::string& filename)
         cv::flip(cv::imread(filename, CV_LOAD_IMAGE_COLOR), texture, 0);
         if (texture.empty())
         {
-            wxString msg = "Cannot open \"" + filename + "\"";
-            wxMessageBox(msg, wxT("Error"), wxICON_ERROR);
+            ReportError("Cannot open \"" + filename + "\"");
             return false;
         }
     }
@@ -96,8 +111,7 @@ LoadTGA(cv::Mat& texture, const std::string& filename)
     fTGA = fopen(filename.c_str(), "rb");
     if (fTGA == NULL)
     {
-        wxString msg = "Cannot open \"" + filename + "\"";
-        wxMessageBox(msg, wxT("Error"), wxICON_ERROR);
+        ReportError("Cannot open \"" + filename + "\"");
         return false;
     }
 
@@ -106,8 +120,7 @@ LoadTGA(cv::Mat& texture, const std::string& filename)
     GLubyte headerUC[12];
     if (fread(&headerUC, sizeof(headerUC), 1, fTGA) == 0)
     {
-        wxString msg = "Cannot read header of \"" + filename + "\"";
-        wxMessageBox(msg, wxT("Error"), wxICON_ERROR);
+        ReportError("Cannot read header of \"" + filename + "\"");
         return false;
     }
 
@@ -117,8 +130,7 @@ LoadTGA(cv::Mat& texture, const std::string& filename)
         isCompressed = true;
     else
     {
-        wxString msg = "Cannot parse \"" + filename + "\"\n(TGA file should be type 2 or type 10)\n";
-        wxMessageBox(msg, wxT("Error"), wxICON_ERROR);
+        ReportError("Cannot parse \"" + filename + "\"\n(TGA file should be type 2 or type 10)\n");
         fclose(fTGA);
         return false;
     }
@@ -126,8 +138,7 @@ LoadTGA(cv::Mat& texture, const std::string& filename)
     GLubyte headerInfo[6];
     if (fread(headerInfo, sizeof(headerInfo), 1, fTGA) == 0)
     {
-        wxString msg = "Cannot read first part header of \"" + filename + "\"";
-        wxMessageBox(msg, wxT("Error"), wxICON_ERROR);
+        ReportError("Cannot read first part header of \"" + filename + "\"");
         return false;
     }
 
@@ -138,8 +149,7 @@ LoadTGA(cv::Mat& texture, const std::string& filename)
     bool flipH = (headerInfo[5] & 0x10) != 0;
     if ((width <= 0) || (height <= 0) || ((bpp != 24) && (bpp != 32)))
     {
-        wxString msg = "Invalid header of \"" + filename + "\"";
-        wxMessageBox(msg, wxT("Error"), wxICON_ERROR);
+        ReportError("Invalid header of \"" + filename + "\"");
         return false;
     }
 
@@ -158,8 +168,7 @@ LoadTGA(cv::Mat& texture, const std::string& filename)
             GLubyte chunkheader = 0;
             if (fread(&chunkheader, sizeof(GLubyte), 1, fTGA) == 0)
             {
-                wxString msg = "Invalid header of \"" + filename + "\"";
-                wxMessageBox(msg, wxT("Error"), wxICON_ERROR);
+                ReportError("Invalid header of \"" + filename + "\"");
                 fclose(fTGA);
                 delete[] colorbuffer;
                 return false;
@@ -172,8 +181,7 @@ LoadTGA(cv::Mat& texture, const std::string& filename)
                 {
                     if (fread(colorbuffer, 1, bytesPerPixel, fTGA) != bytesPerPixel)
                     {
-                        wxString msg = "Cannot read \"" + filename + "\"";
-                        wxMessageBox(msg, wxT("Error"), wxICON_ERROR);
+                        ReportError("Cannot read \"" + filename + "\"");
                         fclose(fTGA);
                         delete[] colorbuffer;
                         return false;
@@ -190,8 +198,7 @@ LoadTGA(cv::Mat& texture, const std::string& filename)
 
                     if (currentpixel > imageSize)
                     {
-                        wxString msg = "Too many pixels in \"" + filename + "\"";
-                        wxMessageBox(msg, wxT("Error"), wxICON_ERROR);
+                        ReportError("Too many pixels in \"" + filename + "\"");
                         fclose(fTGA);
                         delete[] colorbuffer;
                         return false;
@@ -203,8 +210,7 @@ LoadTGA(cv::Mat& texture, const std::string& filename)
                 chunkheader -= 127;
                 if (fread(colorbuffer, 1, bytesPerPixel, fTGA) != bytesPerPixel)
                 {
-                    wxString msg = "Cannot read \"" + filename + "\"";
-                    wxMessageBox(msg, wxT("Error"), wxICON_ERROR);
+                    ReportError("Cannot read \"" + filename + "\"");
                     fclose(fTGA);
                     delete[] colorbuffer;
                     return false;
@@ -222,8 +228,7 @@ LoadTGA(cv::Mat& texture, const std::string& filename)
 
                     if (currentpixel > imageSize)
                     {
-                        wxString msg = "Too many pixels in \"" + filename + "\"";
-                        wxMessageBox(msg, wxT("Error"), wxICON_ERROR);
+                        ReportError("Too many pixels in \"" + filename + "\"");
                         fclose(fTGA);
                         delete[] colorbuffer;
                         return false;
@@ -237,8 +242,7 @@ LoadTGA(cv::Mat& texture, const std::string& filename)
     {
         if (fread(texture.data, bytesPerPixel, imageSize, fTGA) != imageSize)
         {
-            wxString msg = "Cannot read the content of \"" + filename + "\"";
-            wxMessageBox(msg, wxT("Error"), wxICON_ERROR);
+            ReportError("Cannot read the content of \"" + filename + "\"");
             fclose(fTGA);
             return false;
         }
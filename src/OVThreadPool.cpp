@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include "OVThreadPool.h"
+
+namespace ov
+{
+
+int OVThreadPool::DefaultThreadCount = 0;
+
+OVThreadPool::OVThreadPool(int numThreads)
+{
+    if (numThreads <= 0)
+        numThreads = DefaultThreadCount;
+    if (numThreads <= 0)
+        numThreads = (int)std::thread::hardware_concurrency();
+    if (numThreads <= 0)
+        numThreads = 1;
+
+    _isStopping = false;
+    for (int i = 0; i < numThreads; ++i)
+        _workers.push_back(std::thread(&OVThreadPool::workerLoop, this));
+}
+
+OVThreadPool::~OVThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _isStopping = true;
+    }
+    _condition.notify_all();
+    for (int i = 0; i < _workers.size(); ++i)
+        _workers[i].join();
+}
+
+OVThreadPool&
+OVThreadPool::Global()
+{
+    static OVThreadPool pool;
+    return pool;
+}
+
+std::future<void>
+OVThreadPool::enqueue(const std::function<void()>& task)
+{
+    std::packaged_task<void()> packagedTask(task);
+    std::future<void> future = packagedTask.get_future();
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _tasks.push(std::move(packagedTask));
+    }
+    _condition.notify_one();
+    return future;
+}
+
+void
+OVThreadPool::parallelFor(int count, const std::function<void(int)>& body)
+{
+    if (count <= 0)
+        return;
+    if (count == 1)
+    {
+        body(0);
+        return;
+    }
+
+    // Indices are handed out dynamically, so uneven items balance themselves.
+    // The caller only waits for the items, not for the helpers: a helper that
+    // starts late finds nothing left and never touches the body.
+    struct Shared
+    {
+        std::atomic<int>                   next;
+        std::atomic<int>                   done;
+        const std::function<void(int)>*    body;
+        int                                count;
+        std::mutex                         mutex;
+        std::condition_variable            condition;
+    };
+    std::shared_ptr<Shared> shared = std::make_shared<Shared>();
+    shared->next = 0;
+    shared->done = 0;
+    shared->body = &body;
+    shared->count = count;
+
+    auto run = [shared]()
+    {
+        int numDone = 0;
+        for (int i = shared->next++; i < shared->count; i = shared->next++)
+        {
+            (*shared->body)(i);
+            ++numDone;
+        }
+        if (numDone > 0 && (shared->done += numDone) == shared->count)
+        {
+            std::unique_lock<std::mutex> lock(shared->mutex);
+            shared->condition.notify_all();
+        }
+    };
+
+    int numHelpers = std::min(getThreadCount(), count - 1);
+    for (int i = 0; i < numHelpers; ++i)
+        enqueue(run);
+    run();
+
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->condition.wait(lock, [&shared]() { return shared->done == shared->count; });
+}
+
+void
+OVThreadPool::workerLoop()
+{
+    while (true)
+    {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this]() { return _isStopping || !_tasks.empty(); });
+            if (_isStopping && _tasks.empty())
+                return;
+            task = std::move(_tasks.front());
+            _tasks.pop();
+        }
+        task();
+    }
+}
+
+} // namespace ov
@@ -3,9 +3,9 @@
 #include <opencv2/opencv.hpp>
 #include <vector>
 #include <cmath>
-#include <stack>
+#ifdef _WIN32
 #include <AtlBase.h>
-#include <iomanip>
+#endif
 #include "OVUtil.h"
 #include "OVCommon.h"
 
@@ -15,63 +15,6 @@ namespace ov
 const double PI = 3.1415927;
 const double ROT_EPS = 1e-15;
 
-std::string
-GetFileName(const std::string& s)
-{
-    char sep1 = '/', sep2 = '\\';
-
-    size_t i = s.rfind(sep1, s.length());
-    size_t j = s.rfind(sep2, s.length());
-
-    if (i != std::string::npos)
-        return(s.substr(i + 1, s.length() - i));
-    else if (j != std::string::npos)
-        return(s.substr(j + 1, s.length() - j));
-    else
-        return("");
-}
-
-std::string
-GetBaseName(const std::string& s)
-{
-    char sep = '.';
-    size_t i = s.rfind(sep, s.length());
-
-    if (i != std::string::npos)
-        return(s.substr(0, i));
-    else
-        return("");
-}
-
-std::string
-GetExt(const std::string& s)
-{
-    char sep = '.';
-
-    size_t i = s.rfind(sep, s.length());
-
-    if (i != std::string::npos)
-        return(s.substr(i + 1, s.length() - i));
-    else
-        return("");
-}
-
-std::string
-GetDir(const std::string& s)
-{
-    char sep1 = '/', sep2 = '\\';
-
-    size_t i = s.rfind(sep1, s.length());
-    size_t j = s.rfind(sep2, s.length());
-
-    if (i != std::string::npos)
-        return(s.substr(0, i + 1));
-    else if (j != std::string::npos)
-        return(s.substr(0, j + 1));
-    else
-        return("");
-}
-
 // Simulate a trackball by projecting the previous and current points onto
 // a virtual sphere, and then compute the related rotation matrix.
 // August '88 issue of Siggraph's "Computer Graphics," pp. 121-129
@@ -226,40 +169,10 @@ LoadMatrix(std::string fileName)
     return mat;
 }
 
-std::string
-ZeroPadNumber(int num, int width)
-{
-    std::ostringstream ss;
-    ss << std::setw(width) << std::setfill('0') << num;
-    return ss.str();
-}
-
-bool
-IsDirectoryExists(std::string dirName)
-{
-    DWORD attribs = ::GetFileAttributes(std::wstring(dirName.begin(), dirName.end()).c_str());
-    if (attribs == INVALID_FILE_ATTRIBUTES)
-        return false;
-    return (attribs & FILE_ATTRIBUTE_DIRECTORY) != 0;
-}
-
 void
-CreateDirectorys(std::string path)
+ShowErrorMessageBox(const std::string& msg)
 {
-    std::string dir = GetDir(path);
-    std::stack<std::string> dirQueue;
-    while (!IsDirectoryExists(dir)&& !dir.empty())
-    {
-        dirQueue.push(dir);
-        dir.resize(dir.size() - 1);
-        dir = GetDir(dir);
-    }
-    while (!dirQueue.empty())
-    {
-        dir = dirQueue.top();
-        dirQueue.pop();
-        CreateDirectory(std::wstring(dir.begin(), dir.end()).c_str(), NULL);
-    }
+    wxMessageBox(msg, wxT("Error"), wxICON_ERROR);
 }
 
 } // namespace ov
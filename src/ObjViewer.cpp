@@ -20,6 +20,7 @@
 #include <wx/wfstream.h>
 #include "ObjViewer.h"
 #include "OVCanvas.h"
+#include "OVSoftRenderer.h"
 #include "OVUtil.h"
 
 namespace ov
@@ -43,6 +44,9 @@ ObjViewer::ObjViewer(const wxString& title)
     fileMenu->Append(ID_MENU_OPEN_BACKGROUND_IMAGE, wxT("Open &Background Image"), "Open background image file");
     fileMenu->Append(ID_MENU_SAVE_IMAGE, wxT("S&ave Image"), "Save current frame to image file");
     fileMenu->Append(ID_MENU_GEN_SEQ, wxT("G&enerate Sequences"), "Generate Image Sequences with Poses");
+    fileMenu->Append(ID_MENU_GEN_SEQ_SOFTWARE, wxT("Generate Sequences (&Software)"), "Generate Image Sequences with the CPU renderer");
+    fileMenu->Append(ID_MENU_GEN_SEQ_MULTI_POSE, wxT("Generate Sequences (M&ulti-Pose)"), "Generate Image Sequences rendering many poses per pass");
+    fileMenu->Append(ID_MENU_EXPORT_FRAME_STATS, wxT("Export Frame &Statistics"), "Save the frame timings of this session as CSV");
     fileMenu->AppendSeparator();
     fileMenu->Append(ID_MENU_EXIT, wxT("E&xit\tEsc"), "Quit this program");
     // Make the "Help" menu
@@ -93,6 +97,10 @@ ObjViewer::ObjViewer(const wxString& title)
                                                     wxT("Lighting"),
                                                     ID_LIGHTING);
     _lightingCheckBox->SetValue(true);
+    _frameStatsCheckBox = CreateCheckBoxAndAddToSizer(this,
+                                                      _controllerSizer,
+                                                      wxT("Frame statistics"),
+                                                      ID_FRAME_STATS);
     _resetButton = new wxButton(this, ID_RESET, "Reset");
     _controllerSizer->Add(_resetButton, 0, wxEXPAND | wxALL, 5);
 
@@ -103,10 +111,14 @@ ObjViewer::ObjViewer(const wxString& title)
     Connect(ID_MENU_OPEN_BACKGROUND_IMAGE, wxEVT_MENU, wxCommandEventHandler(ObjViewer::onMenuFileOpenBackgroundImage));
     Connect(ID_MENU_SAVE_IMAGE, wxEVT_MENU, wxCommandEventHandler(ObjViewer::onMenuFileSaveImage));
     Connect(ID_MENU_GEN_SEQ, wxEVT_MENU, wxCommandEventHandler(ObjViewer::onMenuGenerateSequence));
+    Connect(ID_MENU_GEN_SEQ_SOFTWARE, wxEVT_MENU, wxCommandEventHandler(ObjViewer::onMenuGenerateSequenceSoftware));
+    Connect(ID_MENU_GEN_SEQ_MULTI_POSE, wxEVT_MENU, wxCommandEventHandler(ObjViewer::onMenuGenerateSequenceMultiPose));
+    Connect(ID_MENU_EXPORT_FRAME_STATS, wxEVT_MENU, wxCommandEventHandler(ObjViewer::onMenuExportFrameStats));
     Connect(ID_MENU_EXIT, wxEVT_MENU, wxCommandEventHandler(ObjViewer::onMenuFileExit));
     Connect(ID_MENU_HELP, wxEVT_MENU, wxCommandEventHandler(ObjViewer::onMenuHelpAbout));
     Connect(ID_RENDER_MODE_RADIO, wxEVT_RADIOBOX, wxCommandEventHandler(ObjViewer::onRenderModeRadio));
     Connect(ID_LIGHTING, wxEVT_CHECKBOX, wxCommandEventHandler(ObjViewer::onLightingCheck));
+    Connect(ID_FRAME_STATS, wxEVT_CHECKBOX, wxCommandEventHandler(ObjViewer::onFrameStatsCheck));
     Connect(ID_RESET, wxEVT_BUTTON, wxCommandEventHandler(ObjViewer::onReset));
 }
 
@@ -131,7 +143,13 @@ ObjViewer::onMenuFileOpenObjModel(wxCommandEvent& WXUNUSED(evt))
             _ovCanvas->resetMatrix();
             _objModelFile = objModelFile;
         }
-        SetStatusText(GetFileName(_objModelFile));
+        const DrawListStats& stats = _ovCanvas->getDrawListStats();
+        std::string statusTxt =   GetFileName(_objModelFile)
+                                + ", Triangles: " + std::to_string(stats.triangleCount)
+                                + ", Draw batches: " + std::to_string(stats.batchCount)
+                                + ", State changes: " + std::to_string(stats.stateChangeCount)
+                                + " (unsorted: " + std::to_string(stats.unsortedStateChangeCount) + ")";
+        SetStatusText(statusTxt);
     }
 }
 
@@ -183,6 +201,24 @@ ObjViewer::onMenuFileSaveImage(wxCommandEvent& WXUNUSED(evt))
 
 void
 ObjViewer::onMenuGenerateSequence(wxCommandEvent& WXUNUSED(evt))
+{
+    generateSequences(false, false);
+}
+
+void
+ObjViewer::onMenuGenerateSequenceSoftware(wxCommandEvent& WXUNUSED(evt))
+{
+    generateSequences(true, false);
+}
+
+void
+ObjViewer::onMenuGenerateSequenceMultiPose(wxCommandEvent& WXUNUSED(evt))
+{
+    generateSequences(false, true);
+}
+
+void
+ObjViewer::generateSequences(bool isSoftware, bool isMultiPose)
 {
     std::string generativeFile = wxFileSelector(wxT("Choose Generative File"), _dataFolder + "batch", wxT(""), wxT(""),
         wxT("Generative Files (*.txt)|*.txt|All files (*.*)|*.*"),
@@ -191,101 +227,50 @@ ObjViewer::onMenuGenerateSequence(wxCommandEvent& WXUNUSED(evt))
     if (generativeFile == "")
         return;
 
-    Vec3 r, t;
-    double s;
-    _ovCanvas->getOffsetPose(r, t, s);
-    _ovCanvas->setOffsetPose(Vec3(0, 0, 0), Vec3(0, 0, 0), 1);
-    double planeNear = OVCanvas::PlaneNear;
-    double planeFar = OVCanvas::PlaneFar;
-    OVCanvas::PlaneNear = 1;
-    OVCanvas::PlaneFar = 10000;
-
-    std::string batchDir = GetDir(generativeFile);
-    std::ifstream genIStream(generativeFile);
-    std::string line;
-    std::string modelFile;
-    while (std::getline(genIStream, line))
+    OVSoftRenderer softRenderer;
+    softRenderer.setRenderMode(_renderMode);
+    softRenderer.setLightingOn(_lightingOn);
+    OVBatchGenerator generator(isSoftware ? (OVRenderer*)&softRenderer : _ovCanvas->getRenderer(),
+                               isSoftware ? NULL : _ovCanvas);
+    generator.setFrameSizeCallback([this](int, int) { reLayout(); });
+    if (isMultiPose)
+        generator.setPosesPerPass(_ovCanvas->getRenderer()->getMaxPosesPerPass());
+    generator.setProgressCallback([this](const BatchProgress& progress)
     {
-        std::stringstream lineStream(line);
-        std::string token, posesFile;
-        // 1. .OBJ model file
-        lineStream >> modelFile;
-        if (!_ovCanvas->setForegroundObject(modelFile, false))
-            break;
-
-        // 2. Background image file
-        lineStream >> token;
-        if (!_ovCanvas->setBackgroundImamge(token))
-            break;
-
-        // 3. Camera parameter file
-        lineStream >> token;
-        if (!_ovCanvas->readCameraParameters(token))
-            break;
-
-        reLayout();
-
-        // 4. Poses file
-        lineStream >> posesFile;
-        Mat poses = LoadMatrix(posesFile);
-
-        // 5. Sigma of Gaussian blur kernal
-        lineStream >> token;
-        double blurSigma = std::stod(token);
-
-        // 6. Variance of Gaussian noise
-        lineStream >> token;
-        double noiseVariance = std::stod(token);
-
-        // 7. Output directory
-        lineStream >> token;
-        std::string imageDir = batchDir + token;
-        if (!IsDirectoryExists(imageDir))
-            CreateDirectorys(imageDir);
-
-        int num = poses.rows();
-        for (int i = 0; i < num; ++i)
-        {
-            Mat3 R;
-            Vec3 t;
-            R << poses(i, 0), poses(i, 3), poses(i, 6),
-                 poses(i, 1), poses(i, 4), poses(i, 7),
-                 poses(i, 2), poses(i, 5), poses(i, 8);
-            t << poses(i, 9), poses(i, 10), poses(i, 11);
-            _ovCanvas->forceRender(R, t);
-            cv::Mat image;
-            _ovCanvas->printScreen(image);
-
-            // Image processing
-            if (blurSigma != 0)
-                cv::GaussianBlur(image, image, cv::Size(0, 0), blurSigma, blurSigma);
-            if (noiseVariance != 0)
-            {
-                cv::Mat gaussianNoise = cv::Mat(image.size(), CV_8UC3);
-
-                cv::randn(gaussianNoise, 0, noiseVariance);
-                image += gaussianNoise;
-                normalize(image, image, 0, 255, CV_MINMAX, CV_8UC3);
-            }
-
-            std::string imageFile = imageDir + ZeroPadNumber(i, 6) + ".png";
-            cv::imwrite(imageFile, image);
-            std::string statusTxt =   "Now processing: " + posesFile
-                                    + ", Sigma of Gaussian blur kernal: " + std::to_string(blurSigma)
-                                    + ", Variance of Gaussian noise: " + std::to_string(noiseVariance)
-                                    + ", Frame index: " + std::to_string(i + 1) + "/" + std::to_string(num);
-            SetStatusText(statusTxt);
-        }
-    }
+        const std::vector<BatchVariant>& variants = progress.job->variants;
+        std::string variantTxt = variants.size() == 1
+                                 ? ", Sigma of Gaussian blur kernal: " + std::to_string(variants[0].blurSigma)
+                                   + ", Variance of Gaussian noise: " + std::to_string(variants[0].noiseVariance)
+                                 : ", Blur and noise variants: " + std::to_string(variants.size());
+        std::string statusTxt =   "Now processing: " + progress.job->posesFile
+                                + variantTxt
+                                + ", Frame index: " + std::to_string(progress.frameIndex + 1) + "/" + std::to_string(progress.frameCount);
+        SetStatusText(statusTxt);
+        return true;
+    });
+    if (!generator.run(generativeFile))
+        ReportError(generator.getError());
 
-    _ovCanvas->setForegroundObject(modelFile, true);
-    _ovCanvas->setOffsetPose(r, t, s);
-    OVCanvas::PlaneNear = planeNear;
-    OVCanvas::PlaneFar = planeFar;
+    _ovCanvas->setForegroundObject(_objModelFile, true);
     _ovCanvas->forceRender(Mat3::Identity(), Vec3::Zero());
     SetStatusText("OBJ Viewer");
 }
 
+void
+ObjViewer::onMenuExportFrameStats(wxCommandEvent& WXUNUSED(evt))
+{
+    wxFileDialog saveFileDialog(this, wxT("Export Frame Statistics"), _dataFolder, "frame_stats.csv",
+        wxT("CSV Files (*.csv)|*.csv|All files (*.*)|*.*"),
+        wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+
+    if (saveFileDialog.ShowModal() == wxID_CANCEL)
+        return;
+
+    std::string filename = saveFileDialog.GetPath();
+    if (!_ovCanvas->getFrameStats().writeCsv(filename))
+        ReportError("Cannot write \"" + filename + "\"");
+}
+
 void 
 ObjViewer::onMenuFileExit(wxCommandEvent& WXUNUSED(evt))
 {
@@ -300,14 +285,37 @@ ObjViewer::onMenuHelpAbout(wxCommandEvent& WXUNUSED(evt))
         + std::string("Mouse right button: Move up, down, left, and right\n")
         + std::string("Mouse mouse scroll wheel: Move forward and backward\n\n\n")
         + std::string("For image sequence generation, the batch file text content should be\n")
-        + std::string("  <model> <image> <camera> <poses> <blur> <noise> <output>\n")
+        + std::string("  <model> <image> <camera> <poses> <blur> <noise> <output> [options]\n")
         + std::string("    <model> : OBJ model file\n")
-        + std::string("    <image> : Background image file\n")
+        + std::string("    <image> : Background image file, or a directory of images or a\n")
+        + std::string("              video file with one frame per pose\n")
         + std::string("    <camera>: Camera parameter file\n")
-        + std::string("    <poses> : Poses file\n")
+        + std::string("    <poses> : Poses file, text with 12 values per line or binary, or\n")
+        + std::string("              generated views or paths such as fibonacci:count=500,\n")
+        + std::string("              radius=400, icosphere:subdivisions=3,radius=400,\n")
+        + std::string("              random:count=500,radius=300/500,seed=1,jitter=5,roll=10\n")
+        + std::string("              or keyframes:file=<poses>,count=500,interpolation=spline\n")
         + std::string("    <blur>  : Sigma of Gaussian blur kernel\n")
         + std::string("    <noise> : Variance of Gaussian noise\n")
-        + std::string("    <output>: Output directory");
+        + std::string("              Both may be lists and ranges such as 0,0.5,1 or 0:2:0.5,\n")
+        + std::string("              rendering once for every pair into <output>/blur<b>_noise<n>\n")
+        + std::string("    <output>: Output directory\n")
+        + std::string("    options : outputs=depth,ids,normals for depth (EXR), shape and\n")
+        + std::string("              material index (16-bit PNG) and normal (EXR) images\n")
+        + std::string("              background=random seed=<n> cache=<MB> for a random image\n")
+        + std::string("              of the <image> directory behind every frame\n")
+        + std::string("              format=png|jpg|ppm|raw|qoi quality=<n> for the frame images,\n")
+        + std::string("              with the PNG level (0-9) or JPEG quality (0-100)\n")
+        + std::string("              container=archive for one frames.ovf file per directory,\n")
+        + std::string("              container=video codec=ffv1|mjpg|mp4v|avc1 fps=<n>, or\n")
+        + std::string("              container=ring ring=<name> slots=<n> to hand the frames to\n")
+        + std::string("              another process through shared memory (ov_frame_ring.h)\n")
+        + std::string("              crop=<margin> to keep only the model's bounding box and a\n")
+        + std::string("              margin of every frame, listed in the manifest\n")
+        + std::string("              annotate=boxes keypoints=<file> for the model's 2D box and\n")
+        + std::string("              its x y z keypoints' pixels in <output>/annotations.jsonl\n\n")
+        + std::string("Every output directory lists its finished frames in manifest.txt, so\n")
+        + std::string("running an interrupted batch file again skips them.");
     wxMessageBox(msg);
 }
 
@@ -329,6 +337,12 @@ ObjViewer::onLightingCheck(wxCommandEvent& WXUNUSED(evt))
     _ovCanvas->setLightingOn(_lightingOn);
 }
 
+void
+ObjViewer::onFrameStatsCheck(wxCommandEvent& WXUNUSED(evt))
+{
+    _ovCanvas->setFrameStatsEnabled(_frameStatsCheckBox->GetValue());
+}
+
 void
 ObjViewer::onReset(wxCommandEvent& WXUNUSED(evt))
 {
@@ -1,14 +1,19 @@
 #include "main.h"
 #include "ObjViewer.h"
+#include "OVHeadless.h"
+#include "OVUtil.h"
 #include <iostream>
 namespace ov
 {
 
-IMPLEMENT_APP(MyApp)
+// The entry point is defined below, so that --batch runs never initialize
+// the GUI toolkit
+IMPLEMENT_APP_NO_MAIN(MyApp)
 
 // The program execution starts here
 bool MyApp::OnInit()
 {
+    SetErrorHandler(ShowErrorMessageBox);
     ObjViewer *viewer = new ObjViewer(wxT("OBJ Viewer"));
 
     return true;
@@ -16,3 +21,25 @@ bool MyApp::OnInit()
 
 } // namespace ov
 
+#ifdef _WIN32
+int WINAPI
+WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR WXUNUSED(lpCmdLine), int nCmdShow)
+{
+    if (ov::IsHeadlessCommand(__argc, __argv))
+    {
+        // A GUI-subsystem program has no console of its own; report to the caller's
+        if (AttachConsole(ATTACH_PARENT_PROCESS))
+            freopen("CONOUT$", "w", stderr);
+        return ov::RunHeadless(__argc, __argv);
+    }
+    return wxEntry(hInstance, hPrevInstance, NULL, nCmdShow);
+}
+#else
+int
+main(int argc, char** argv)
+{
+    if (ov::IsHeadlessCommand(argc, argv))
+        return ov::RunHeadless(argc, argv);
+    return wxEntry(argc, argv);
+}
+#endif